@@ -0,0 +1,117 @@
+#include "AstraFrameSource.h"
+
+template<typename TFrame, typename T>
+static void setView(const TFrame& frame, FrameView<T>& view, uint32_t stream, FrameSet& frames)
+{
+	if (!frame.is_valid())
+		return;
+
+	view.data = frame.data();
+	view.width = frame.width();
+	view.height = frame.height();
+	view.frameIndex = frame.frame_index();
+
+	frames.streams |= stream;
+}
+
+AstraFrameSource::AstraFrameSource(const std::string& uri)
+{
+	streamSet = astra::StreamSet(uri.c_str());
+
+	reader = streamSet.create_reader();
+
+	auto depthStream = configure_depth(reader);
+	depthStream.start();
+
+	depthHFov = depthStream.hFov();
+	depthVFov = depthStream.vFov();
+
+	auto colorStream = configure_color(reader);
+	colorStream.start();
+
+	configure_ir(reader, false);
+
+	reader.add_listener(*this);
+}
+
+AstraFrameSource::~AstraFrameSource()
+{
+	reader.remove_listener(*this);
+}
+
+void AstraFrameSource::update()
+{
+	astra_update();
+}
+
+void AstraFrameSource::getFieldOfView(float& hFov, float& vFov) const
+{
+	hFov = depthHFov;
+	vFov = depthVFov;
+}
+
+void AstraFrameSource::on_frame_ready(astra::StreamReader& reader, astra::Frame& frame)
+{
+	if (!listener)
+		return;
+
+	FrameSet frames;
+
+	setView(frame.get<astra::DepthFrame>(), frames.depth, STREAM_DEPTH, frames);
+	setView(frame.get<astra::ColorFrame>(), frames.color, STREAM_COLOR, frames);
+	setView(frame.get<astra::InfraredFrame16>(), frames.ir16, STREAM_IR_16, frames);
+	setView(frame.get<astra::InfraredFrameRgb>(), frames.irRgb, STREAM_IR_RGB, frames);
+
+	listener->on_frame_ready(frames);
+}
+
+astra::DepthStream AstraFrameSource::configure_depth(astra::StreamReader & reader)
+{
+	auto depthStream = reader.stream<astra::DepthStream>();
+
+	//We don't have to set the mode to start the stream, but if you want to here is how:
+	astra::ImageStreamMode depthMode;
+
+	depthMode.set_width(640);
+	depthMode.set_height(480);
+	depthMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_DEPTH_MM);
+	depthMode.set_fps(30);
+
+	depthStream.set_mode(depthMode);
+
+	return depthStream;
+}
+
+astra::InfraredStream AstraFrameSource::configure_ir(astra::StreamReader & reader, bool useRGB)
+{
+	auto irStream = reader.stream<astra::InfraredStream>();
+
+	astra::ImageStreamMode irMode;
+	irMode.set_width(640);
+	irMode.set_height(480);
+
+	if (useRGB)
+		irMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_RGB888);
+	else
+		irMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_GRAY16);
+
+	irMode.set_fps(30);
+	irStream.set_mode(irMode);
+
+	return irStream;
+}
+
+astra::ColorStream AstraFrameSource::configure_color(astra::StreamReader & reader)
+{
+	auto colorStream = reader.stream<astra::ColorStream>();
+
+	astra::ImageStreamMode colorMode;
+	colorMode.set_width(640);
+	colorMode.set_height(480);
+	colorMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_RGB888);
+	colorMode.set_fps(30);
+
+	colorStream.set_mode(colorMode);
+
+	return colorStream;
+}
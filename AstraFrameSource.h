@@ -0,0 +1,36 @@
+#ifndef ASTRAFRAMESOURCE_H
+#define ASTRAFRAMESOURCE_H
+
+#include "FrameSource.h"
+
+#include <astra/astra.hpp>
+#include <string>
+
+// Delivers the frames of an Astra sensor, opened by its URI (e.g. "device/sensor0").
+// update() pumps the Astra SDK with astra_update(). The SDK's PointStream isn't used, points
+// are made from the depth by a DepthReprojector where they're wanted.
+class AstraFrameSource : public FrameSource, public astra::FrameListener
+{
+public:
+	AstraFrameSource(const std::string& uri);
+	~AstraFrameSource();
+
+	virtual void update() override;
+	virtual void getFieldOfView(float& hFov, float& vFov) const override;
+
+	virtual void on_frame_ready(astra::StreamReader& reader,
+								astra::Frame& frame) override;
+
+protected:
+	astra::DepthStream configure_depth(astra::StreamReader& reader);
+	astra::InfraredStream configure_ir(astra::StreamReader& reader, bool useRGB);
+	astra::ColorStream configure_color(astra::StreamReader& reader);
+
+	astra::StreamSet streamSet;
+	astra::StreamReader reader;
+
+	float depthHFov{ 0.0f };
+	float depthVFov{ 0.0f };
+};
+
+#endif // ASTRAFRAMESOURCE_H
@@ -0,0 +1,38 @@
+#include "AstraPollingFrameSource.h"
+
+AstraPollingFrameSource::AstraPollingFrameSource(const std::string& uri) :
+	streams(STREAM_DEPTH | STREAM_COLOR)
+{
+	poller.connectSensor(uri);
+}
+
+void AstraPollingFrameSource::setStreams(uint32_t s)
+{
+	streams.store(s);
+}
+
+void AstraPollingFrameSource::setWaitTimeout(unsigned int milliseconds)
+{
+	waitTimeout.store(milliseconds);
+}
+
+void AstraPollingFrameSource::getFieldOfView(float& hFov, float& vFov) const
+{
+	poller.getFieldOfView(hFov, vFov);
+}
+
+void AstraPollingFrameSource::update()
+{
+	// The depth is recorded and exported whatever the listener wants, like AstraFrameSource
+	const uint32_t wanted = streams.load() | STREAM_DEPTH;
+	if (wanted != pollerStreams){
+		poller.setStreams(wanted);
+		pollerStreams = wanted;
+	}
+
+	AstraFramePoller::FrameLease lease = poller.pollFrame(waitTimeout.load());
+	if (!lease.isValid() || !listener)
+		return;
+
+	listener->on_frame_ready(lease.getFrames());
+}
@@ -0,0 +1,39 @@
+#ifndef ASTRAPOLLINGFRAMESOURCE_H
+#define ASTRAPOLLINGFRAMESOURCE_H
+
+#include "FrameSource.h"
+#include "astraframepoller.h"
+
+#include <atomic>
+#include <string>
+
+// Delivers the frames of an Astra sensor by pulling them with AstraFramePoller, rather than
+// waiting for the SDK to call back from astra_update() like AstraFrameSource does.
+//
+// update() blocks in astra_reader_open_frame() until the next frame arrives or the wait
+// timeout passes, so a frame is picked up as soon as the SDK has it instead of on the next
+// pump of the caller's loop. The frames are handed to the listener straight from the SDK's
+// memory, the lease on them ends when on_frame_ready() returns.
+class AstraPollingFrameSource : public FrameSource
+{
+public:
+	AstraPollingFrameSource(const std::string& uri);
+
+	virtual void setStreams(uint32_t streams) override;
+	virtual void setWaitTimeout(unsigned int milliseconds) override;
+	virtual bool waitsForFrames() const override { return true; }
+
+	virtual void update() override;
+	virtual void getFieldOfView(float& hFov, float& vFov) const override;
+
+private:
+	AstraFramePoller poller;
+
+	// Applied to the poller on the thread that calls update()
+	std::atomic<uint32_t> streams;
+	uint32_t pollerStreams{ 0 };
+
+	std::atomic<unsigned int> waitTimeout{ 0 };
+};
+
+#endif // ASTRAPOLLINGFRAMESOURCE_H
@@ -0,0 +1,153 @@
+#include "DepthCodec.h"
+
+#include <algorithm>
+
+static const uint32_t OneByteLimit = 0x80;
+static const uint32_t TwoByteLimit = OneByteLimit + (0x7F << 8);
+
+// Shifting a negative signed value left is undefined, so the difference is zigzagged as unsigned
+static inline uint16_t zigzag(uint16_t difference)
+{
+	const uint32_t d = difference;
+	return uint16_t((d << 1) ^ (0u - (d >> 15)));
+}
+
+static inline uint16_t unzigzag(uint16_t value)
+{
+	return uint16_t((value >> 1) ^ (0 - (value & 1)));
+}
+
+static inline uint8_t* writeRun(uint8_t* out, uint32_t length)
+{
+	*out++ = 0;
+	while (length >= 0x80){
+		*out++ = uint8_t(length | 0x80);
+		length >>= 7;
+	}
+	*out++ = uint8_t(length);
+	return out;
+}
+
+static inline uint8_t* writeValue(uint8_t* out, uint16_t value)
+{
+	if (value < OneByteLimit){
+		*out++ = uint8_t(value);
+	}
+	else if (value < TwoByteLimit){
+		const uint32_t v = value - OneByteLimit;
+		*out++ = uint8_t(0x80 | (v >> 8));
+		*out++ = uint8_t(v);
+	}
+	else{
+		*out++ = 0xFF;
+		*out++ = uint8_t(value);
+		*out++ = uint8_t(value >> 8);
+	}
+	return out;
+}
+
+size_t DepthCodec::maxEncodedSize(int width, int height)
+{
+	// Every pixel as three bytes, the worst case for a run is two bytes for one pixel
+	return size_t(width) * height * 3 + 8;
+}
+
+size_t DepthCodec::encode(const int16_t* depth, int width, int height, uint8_t* out)
+{
+	// Differences wrap around in 16 bits, so any pair of values can be stored
+	const uint16_t* in = (const uint16_t*)depth;
+	uint8_t* o = out;
+	uint32_t zeros = 0;
+
+	for (int y = 0; y < height; y++){
+		const uint16_t* row = in + size_t(y) * width;
+		uint16_t previous = y > 0 ? row[-width] : 0;
+
+		for (int x = 0; x < width; x++){
+			const uint16_t value = row[x];
+			const uint16_t residual = zigzag(uint16_t(value - previous));
+			previous = value;
+
+			if (residual == 0){
+				zeros++;
+				continue;
+			}
+
+			if (zeros){
+				o = writeRun(o, zeros);
+				zeros = 0;
+			}
+			o = writeValue(o, residual);
+		}
+	}
+
+	if (zeros)
+		o = writeRun(o, zeros);
+
+	return size_t(o - out);
+}
+
+bool DepthCodec::decode(const uint8_t* data, size_t size, int16_t* depth, int width, int height)
+{
+	const uint8_t* in = data;
+	const uint8_t* end = data + size;
+	uint16_t* out = (uint16_t*)depth;
+	uint32_t zeros = 0;
+
+	for (int y = 0; y < height; y++){
+		uint16_t* row = out + size_t(y) * width;
+		uint16_t previous = y > 0 ? row[-width] : 0;
+
+		int x = 0;
+		while (x < width){
+			if (zeros){
+				const int count = int(std::min<uint32_t>(zeros, uint32_t(width - x)));
+				std::fill(row + x, row + x + count, previous);
+				x += count;
+				zeros -= count;
+				continue;
+			}
+
+			if (in == end)
+				return false;
+
+			const uint8_t token = *in++;
+			uint16_t residual;
+
+			if (token == 0){
+				for (int shift = 0; ; shift += 7){
+					if (in == end || shift > 28)
+						return false;
+
+					const uint8_t b = *in++;
+					zeros |= uint32_t(b & 0x7F) << shift;
+					if (!(b & 0x80))
+						break;
+				}
+
+				if (zeros == 0)
+					return false;
+				continue;
+			}
+			else if (token < 0x80){
+				residual = token;
+			}
+			else if (token < 0xFF){
+				if (in == end)
+					return false;
+				residual = uint16_t(OneByteLimit + (uint32_t(token & 0x7F) << 8) + *in++);
+			}
+			else{
+				if (end - in < 2)
+					return false;
+				residual = uint16_t(in[0] | (in[1] << 8));
+				in += 2;
+			}
+
+			previous = uint16_t(previous + unzigzag(residual));
+			row[x++] = previous;
+		}
+	}
+
+	return zeros == 0 && in == end;
+}
@@ -0,0 +1,33 @@
+#ifndef DEPTHCODEC_H
+#define DEPTHCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless compression for 16-bit depth images, RECORDING_ENCODING_DEPTH_DELTA in a recording.
+//
+// Each pixel is predicted from the one to its left (the first pixel of a row from the first
+// pixel of the row above), and the difference is zigzag encoded so small steps either way
+// become small numbers. Those are written as byte tokens:
+//
+//   0x00            a run of zero differences, the length follows as a LEB128 varint
+//   0x01 - 0x7F     the difference itself
+//   0x80 - 0xFE     two bytes, 128 plus a 15 bit value
+//   0xFF            three bytes, the difference follows as 16 bits little endian
+//
+// Depth maps are mostly smooth surfaces and large areas of 0 where there's no reading, so
+// nearly every pixel ends up in a run or a single byte.
+class DepthCodec
+{
+public:
+	// Largest number of bytes encode() can write for an image of this size
+	static size_t maxEncodedSize(int width, int height);
+
+	// Returns the number of bytes written to 'out', which must hold maxEncodedSize()
+	static size_t encode(const int16_t* depth, int width, int height, uint8_t* out);
+
+	// Returns false if 'data' isn't exactly one encoded image of this size
+	static bool decode(const uint8_t* data, size_t size, int16_t* depth, int width, int height);
+};
+
+#endif // DEPTHCODEC_H
@@ -0,0 +1,176 @@
+#include "DepthReprojector.h"
+#include "LitDepthVisualizer.h"
+#include "SimdTarget.h"
+
+#include <algorithm>
+
+DepthReprojector::DepthReprojector()
+{
+}
+
+void DepthReprojector::setArena(FrameArena* a)
+{
+	arena = a ? a : &ownArena;
+	rays = nullptr;
+	points = nullptr;
+}
+
+void DepthReprojector::setRegion(int x, int y, int width, int height)
+{
+	region = Region{ std::max(0, x), std::max(0, y), std::max(0, width), std::max(0, height) };
+}
+
+void DepthReprojector::setDecimation(int step)
+{
+	decimation = std::max(1, step);
+}
+
+void DepthReprojector::setSimd(bool s)
+{
+	simd = s;
+}
+
+bool DepthReprojector::usesAvx2() const
+{
+#ifdef SIMD_AVX2
+	return simd && LitDepthVisualizer::has_avx2();
+#else
+	return false;
+#endif
+}
+
+DepthReprojector::Region DepthReprojector::clampRegion(int depthWidth, int depthHeight) const
+{
+	Region r;
+	r.x = std::min(region.x, depthWidth);
+	r.y = std::min(region.y, depthHeight);
+	r.width = region.width > 0 ? std::min(region.width, depthWidth - r.x) : depthWidth - r.x;
+	r.height = region.height > 0 ? std::min(region.height, depthHeight - r.y) : depthHeight - r.y;
+	return r;
+}
+
+void DepthReprojector::getOutputSize(int depthWidth, int depthHeight, int& width, int& height) const
+{
+	const Region r = clampRegion(depthWidth, depthHeight);
+	width = (r.width + decimation - 1) / decimation;
+	height = (r.height + decimation - 1) / decimation;
+}
+
+size_t DepthReprojector::scratchSize(int width, int height)
+{
+	const size_t bytes = size_t(width) * height * sizeof(astra::Vector3f);
+	return FrameArena::align(bytes) * 2;
+}
+
+void DepthReprojector::prepare(int depthWidth, int depthHeight, float hFov, float vFov)
+{
+	const Region r = clampRegion(depthWidth, depthHeight);
+
+	const bool carved = rays != nullptr && arenaGeneration == arena->getGeneration() && !arena->isStale();
+	if (carved && depthWidth == tableDepthWidth && depthHeight == tableDepthHeight &&
+		hFov == tableHFov && vFov == tableVFov && decimation == tableDecimation &&
+		r.x == tableRegion.x && r.y == tableRegion.y && r.width == tableRegion.width && r.height == tableRegion.height)
+		return;
+
+	int width = 0;
+	int height = 0;
+	getOutputSize(depthWidth, depthHeight, width, height);
+
+	// Moving the region only builds the table again, in the buffers it already has
+	if (!carved || width != outputWidth || height != outputHeight){
+		// A shared arena already has room for them, see setArena()
+		if (arena == &ownArena)
+			ownArena.reset(scratchSize(width, height));
+
+		const size_t numPixels = size_t(width) * height;
+		rays = arena->allocate<astra::Vector3f>(numPixels);
+		points = arena->allocate<astra::Vector3f>(numPixels);
+
+		outputWidth = width;
+		outputHeight = height;
+	}
+
+	// The rays are separable, so the table is picked out of the whole frame's columns and rows
+	columnRays.resize(size_t(depthWidth));
+	rowRays.resize(size_t(depthHeight));
+	LitDepthVisualizer::make_rays(size_t(depthWidth), size_t(depthHeight), hFov, vFov, columnRays.data(), rowRays.data());
+
+	astra::Vector3f* ray = rays;
+	for (int y = 0; y < outputHeight; y++){
+		const float rayY = rowRays[size_t(r.y + y * decimation)];
+
+		for (int x = 0; x < outputWidth; x++, ray++)
+			*ray = astra::Vector3f(columnRays[size_t(r.x + x * decimation)], rayY, 1.0f);
+	}
+
+	tableDepthWidth = depthWidth;
+	tableDepthHeight = depthHeight;
+	tableHFov = hFov;
+	tableVFov = vFov;
+	tableRegion = r;
+	tableDecimation = decimation;
+	arenaGeneration = arena->getGeneration();
+}
+
+#ifdef SIMD_AVX2
+
+// 8 contiguous depths at a time. The points are 24 floats, the rays times the depths each
+// repeated three times, which are permuted into place rather than shuffled out of planes.
+AVX2_TARGET
+static int reproject_row_avx2(const int16_t* in, const astra::Vector3f* rays, astra::Vector3f* out, int width)
+{
+	const __m256i first = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+	const __m256i second = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+	const __m256i third = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8){
+		const __m128i depth = _mm_loadu_si128((const __m128i*)(in + x));
+		const __m256 z = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(depth));
+
+		const float* ray = (const float*)(rays + x);
+		float* point = (float*)(out + x);
+
+		_mm256_storeu_ps(point, _mm256_mul_ps(_mm256_loadu_ps(ray), _mm256_permutevar8x32_ps(z, first)));
+		_mm256_storeu_ps(point + 8, _mm256_mul_ps(_mm256_loadu_ps(ray + 8), _mm256_permutevar8x32_ps(z, second)));
+		_mm256_storeu_ps(point + 16, _mm256_mul_ps(_mm256_loadu_ps(ray + 16), _mm256_permutevar8x32_ps(z, third)));
+	}
+
+	return x;
+}
+
+#endif
+
+FrameView<astra::Vector3f> DepthReprojector::reproject(const FrameView<int16_t>& depth, float hFov, float vFov)
+{
+	FrameView<astra::Vector3f> view;
+	if (!depth.is_valid())
+		return view;
+
+	prepare(depth.width, depth.height, hFov, vFov);
+
+	const bool avx2 = usesAvx2() && decimation == 1;
+	const size_t depthWidth = size_t(depth.width);
+
+	for (int y = 0; y < outputHeight; y++){
+		const int16_t* in = depth.data + size_t(tableRegion.y + y * decimation) * depthWidth + tableRegion.x;
+		const astra::Vector3f* ray = rays + size_t(y) * outputWidth;
+		astra::Vector3f* out = points + size_t(y) * outputWidth;
+
+		int x = 0;
+#ifdef SIMD_AVX2
+		if (avx2)
+			x = reproject_row_avx2(in, ray, out, outputWidth);
+#endif
+		for (; x < outputWidth; x++){
+			const float z = float(in[x * decimation]);
+			out[x] = astra::Vector3f(ray[x].x * z, ray[x].y * z, z);
+		}
+	}
+
+	view.data = points;
+	view.width = outputWidth;
+	view.height = outputHeight;
+	view.frameIndex = depth.frameIndex;
+	return view;
+}
@@ -0,0 +1,95 @@
+#ifndef DEPTHREPROJECTOR_H
+#define DEPTHREPROJECTOR_H
+
+#include "FrameSource.h"
+#include "FrameArena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Turns depth frames into world space points, the same as the Astra SDK's PointStream but
+// without running a third stream alongside the depth and copying its frames out.
+//
+// The ray through every pixel is worked out once for the field of view and kept in a table,
+// so each point is just its depth times its ray, 8 pixels at a time with AVX2. The table is
+// only built again when the mode changes: the size of the depth, the field of view, the
+// region or the decimation.
+//
+// A region of the frame can be picked out and decimated, taking every n'th pixel of every
+// n'th row, which makes a smaller grid of points.
+class DepthReprojector
+{
+public:
+	DepthReprojector();
+
+	DepthReprojector(const DepthReprojector&) = delete;
+	DepthReprojector& operator=(const DepthReprojector&) = delete;
+
+	// Carves the table and the points from 'arena' rather than the reprojector's own, its
+	// owner resets it and should leave scratchSize() of room for them
+	void setArena(FrameArena* arena);
+
+	// The part of the depth frame to reproject, clamped to the frame. A width or height of 0
+	// runs to the edge of the frame.
+	void setRegion(int x, int y, int width, int height);
+	// Every 'step' pixels across and down, 1 for all of them
+	void setDecimation(int step);
+	int getDecimation() const { return decimation; }
+
+	// Whether the AVX2 kernel is used, on CPUs that have it. It gives the same points as the
+	// scalar loop.
+	void setSimd(bool simd);
+	bool usesAvx2() const;
+
+	// Size of the grid of points reproject() makes from a depth frame of this size
+	void getOutputSize(int depthWidth, int depthHeight, int& width, int& height) const;
+	// Bytes of arena reproject() needs to make a grid of points of this size
+	static size_t scratchSize(int width, int height);
+
+	// World space millimetres, y up, for depth in millimetres and the field of view of the
+	// depth camera in radians. Pixels with no depth become the origin, like the SDK's points.
+	// The points are valid until the next call, or until the arena is reset.
+	FrameView<astra::Vector3f> reproject(const FrameView<int16_t>& depth, float hFov, float vFov);
+
+private:
+	struct Region
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	Region clampRegion(int depthWidth, int depthHeight) const;
+	void prepare(int depthWidth, int depthHeight, float hFov, float vFov);
+
+	FrameArena ownArena;
+	FrameArena* arena{ &ownArena };
+
+	Region region{ 0, 0, 0, 0 };
+	int decimation{ 1 };
+	bool simd{ true };
+
+	// The mode the table was built for, and the arena generation it was carved in
+	int tableDepthWidth{ 0 };
+	int tableDepthHeight{ 0 };
+	float tableHFov{ 0.0f };
+	float tableVFov{ 0.0f };
+	Region tableRegion{ 0, 0, 0, 0 };
+	int tableDecimation{ 0 };
+	uint32_t arenaGeneration{ 0 };
+
+	int outputWidth{ 0 };
+	int outputHeight{ 0 };
+
+	// LitDepthVisualizer::make_rays() for the whole depth frame, the table is built from them
+	std::vector<float> columnRays;
+	std::vector<float> rowRays;
+
+	// The ray through each output pixel as (x, y, 1), so a point is the ray times its depth
+	astra::Vector3f* rays{ nullptr };
+	astra::Vector3f* points{ nullptr };
+};
+
+#endif // DEPTHREPROJECTOR_H
@@ -0,0 +1,148 @@
+#include "FrameArena.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else // macOS
+#include <sys/mman.h>
+#ifdef __APPLE__
+#include <mach/vm_statistics.h>
+#endif
+#endif
+
+FrameArena::FrameArena()
+{
+}
+
+FrameArena::~FrameArena()
+{
+	for (Block& b : overflow)
+		freeBlock(b);
+
+	freeBlock(block);
+}
+
+void FrameArena::reset(size_t bytes)
+{
+	// Big enough for everything carved since the last reset, so the same layout fits next time
+	size_t required = align(bytes);
+	if (used + overflowBytes > required)
+		required = used + overflowBytes;
+
+	for (Block& b : overflow)
+		freeBlock(b);
+	overflow.clear();
+	overflowBytes = 0;
+
+	const bool wantHuge = hugePages.load();
+	if (wantHuge != blockWantedHuge && block.size > required)
+		required = block.size;
+
+	if (required > block.size || wantHuge != blockWantedHuge){
+		freeBlock(block);
+		if (required > 0)
+			block = allocateBlock(required, wantHuge);
+
+		blockWantedHuge = wantHuge;
+		blockHuge.store(block.huge);
+		capacity.store(block.size);
+	}
+
+	used = 0;
+	generation++;
+}
+
+void* FrameArena::allocate(size_t bytes)
+{
+	bytes = align(bytes == 0 ? 1 : bytes);
+
+	if (block.data && bytes <= block.size - used){
+		uint8_t* region = block.data + used;
+		used += bytes;
+		return region;
+	}
+
+	Block b = allocateBlock(bytes, false);
+	if (!b.data)
+		return nullptr;
+
+	overflow.push_back(b);
+	overflowBytes += bytes;
+	return b.data;
+}
+
+void FrameArena::setHugePages(bool h)
+{
+	hugePages.store(h);
+}
+
+bool FrameArena::isStale() const
+{
+	return hugePages.load() != blockWantedHuge;
+}
+
+#ifdef _WIN32
+
+FrameArena::Block FrameArena::allocateBlock(size_t bytes, bool huge)
+{
+	// Large pages have to be committed in whole pages, and fail without SeLockMemoryPrivilege
+	const size_t largePage = GetLargePageMinimum();
+	if (huge && largePage > 0){
+		const size_t size = (bytes + largePage - 1) / largePage * largePage;
+		void* data = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (data)
+			return Block{ (uint8_t*)data, size, true };
+	}
+
+	void* data = VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	return Block{ (uint8_t*)data, data ? bytes : 0, false };
+}
+
+void FrameArena::freeBlock(Block& b)
+{
+	if (b.data)
+		VirtualFree(b.data, 0, MEM_RELEASE);
+
+	b = Block{ nullptr, 0, false };
+}
+
+#else // macOS
+
+const size_t HugePageSize = 2 * 1024 * 1024;
+
+FrameArena::Block FrameArena::allocateBlock(size_t bytes, bool huge)
+{
+	if (huge){
+		const size_t size = (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+
+#ifdef VM_FLAGS_SUPERPAGE_SIZE_2MB
+		// Superpages are only on Intel Macs, Apple silicon fails this and gets regular pages
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+		if (data != MAP_FAILED)
+			return Block{ (uint8_t*)data, size, true };
+#elif defined(MADV_HUGEPAGE)
+		// Linux, only a hint for transparent huge pages
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (data != MAP_FAILED){
+			if (madvise(data, size, MADV_HUGEPAGE) == 0)
+				return Block{ (uint8_t*)data, size, true };
+			munmap(data, size);
+		}
+#endif
+	}
+
+	void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (data == MAP_FAILED)
+		return Block{ nullptr, 0, false };
+
+	return Block{ (uint8_t*)data, bytes, false };
+}
+
+void FrameArena::freeBlock(Block& b)
+{
+	if (b.data)
+		munmap(b.data, b.size);
+
+	b = Block{ nullptr, 0, false };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One block of memory that a pipeline's per-frame scratch buffers are carved from.
+//
+// Every region is 64-byte aligned, so kernels can use aligned SIMD loads and no two buffers
+// share a cache line. Regions live until the next reset(), which is meant for when the mode
+// changes; the block itself is only reallocated when it's too small for the new mode or the
+// huge pages setting changed.
+//
+// A region that doesn't fit in the block is allocated on its own, and the next reset() grows
+// the block so that it would have fitted.
+class FrameArena
+{
+public:
+	static const size_t Alignment = 64;
+
+	static size_t align(size_t bytes) { return (bytes + Alignment - 1) & ~(Alignment - 1); }
+
+	FrameArena();
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// Drops every region and makes sure the block has room for at least 'bytes' of new ones
+	void reset(size_t bytes = 0);
+
+	// An uninitialised region, valid until the next reset()
+	void* allocate(size_t bytes);
+
+	template<typename T>
+	T* allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T))); }
+
+	// Incremented by every reset(), regions carved in an older generation are gone
+	uint32_t getGeneration() const { return generation; }
+
+	// Whether to back the block with huge pages, which can be called from any thread.
+	// Takes effect on the next reset(), isStale() is true until then.
+	void setHugePages(bool hugePages);
+	bool isStale() const;
+
+	// Whether the block really is in huge pages, they aren't always available. On Windows
+	// the process needs the privilege to lock pages in memory. Can be called from any thread.
+	bool usesHugePages() const { return blockHuge.load(); }
+	size_t getCapacity() const { return capacity.load(); }
+
+private:
+	struct Block
+	{
+		uint8_t* data;
+		size_t size;
+		bool huge;
+	};
+
+	// Page aligned, so aligned for any region
+	static Block allocateBlock(size_t bytes, bool huge);
+	static void freeBlock(Block& block);
+
+	Block block{ nullptr, 0, false };
+	// The setting the block was allocated with, whether or not huge pages could be had
+	bool blockWantedHuge{ false };
+	size_t used{ 0 };
+
+	std::vector<Block> overflow;
+	size_t overflowBytes{ 0 };
+
+	uint32_t generation{ 0 };
+
+	std::atomic<bool> hugePages{ false };
+	std::atomic<bool> blockHuge{ false };
+	std::atomic<size_t> capacity{ 0 };
+};
+
+#endif // FRAMEARENA_H
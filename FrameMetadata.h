@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Describes the sensor frame a buffer was filled from. It's fixed size so it can be
+// copied along with the buffer through the FrameQueue without allocating on the
+// producer thread; anything human readable is only built when the Info DAT asks.
+class FrameMetadata
+{
+public:
+	// Pipeline sequence number, see AstraFrameListener::getFramesReceived()
+	uint32_t	frameId = 0;
+
+	// Frame index reported by the Astra SDK for the stream, -1 when unknown
+	int32_t		frameIndex = -1;
+
+	// Microseconds, 0 when the frame source doesn't report one
+	uint64_t	deviceTimestamp = 0;
+
+	// PipelineStats::now() when the frame arrived in on_frame_ready
+	uint64_t	arrivalTime = 0;
+
+	int32_t		width = 0;
+	int32_t		height = 0;
+
+	// astra_pixel_format_t of the stream the frame came from
+	uint32_t	pixelFormat = 0;
+
+	// AstraFrameListener::StreamType the frame was converted for
+	int32_t		streamType = 0;
+};
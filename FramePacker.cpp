@@ -0,0 +1,248 @@
+#include "FramePacker.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+// A pixel on its way from a source to a destination
+struct Texel
+{
+	float r;
+	float g;
+	float b;
+	float a;
+};
+
+// The sources, each loads pixel i. The colours are in [0, 1], everything else as it is.
+
+struct LoadRGB888
+{
+	static inline Texel
+	load(const uint8_t* src, size_t i)
+	{
+		const uint8_t* p = src + i * 3;
+		return Texel{ p[0] * (1.0f / 255.0f), p[1] * (1.0f / 255.0f), p[2] * (1.0f / 255.0f), 1.0f };
+	}
+};
+
+struct LoadIR16
+{
+	static inline Texel
+	load(const uint8_t* src, size_t i)
+	{
+		uint16_t value;
+		memcpy(&value, src + i * sizeof(value), sizeof(value));
+
+		// Red and blue wrap around in a byte, as they always have
+		const uint8_t red = uint8_t(value >> 2);
+		const uint8_t blue = uint8_t(0x66 - red / 2);
+		return Texel{ red * (1.0f / 255.0f), 0.0f, blue * (1.0f / 255.0f), 1.0f };
+	}
+};
+
+// Millimetres in every colour, and an alpha of 1 where there's depth
+struct LoadDepth16
+{
+	static inline Texel
+	load(const uint8_t* src, size_t i)
+	{
+		int16_t value;
+		memcpy(&value, src + i * sizeof(value), sizeof(value));
+
+		const float depth = float(value);
+		return Texel{ depth, depth, depth, float(value != 0) };
+	}
+};
+
+// The same for the points, the origin where there's no depth
+struct LoadPoints
+{
+	static inline Texel
+	load(const uint8_t* src, size_t i)
+	{
+		float p[3];
+		memcpy(p, src + i * sizeof(p), sizeof(p));
+
+		return Texel{ p[0], p[1], p[2], float(p[2] != 0.0f) };
+	}
+};
+
+struct LoadHalf4
+{
+	static inline Texel
+	load(const uint8_t* src, size_t i)
+	{
+		uint16_t h[4];
+		memcpy(h, src + i * sizeof(h), sizeof(h));
+
+		return Texel{ FramePacker::fromHalf(h[0]), FramePacker::fromHalf(h[1]), FramePacker::fromHalf(h[2]), FramePacker::fromHalf(h[3]) };
+	}
+};
+
+// The destinations, each stores pixel i
+
+struct StoreRGBA8
+{
+	static inline uint8_t
+	unorm(float v)
+	{
+		return uint8_t(std::min(1.0f, std::max(0.0f, v)) * 255.0f + 0.5f);
+	}
+
+	static inline void
+	store(uint8_t* dst, size_t i, const Texel& t)
+	{
+		uint8_t* p = dst + i * 4;
+		p[0] = unorm(t.r);
+		p[1] = unorm(t.g);
+		p[2] = unorm(t.b);
+		p[3] = unorm(t.a);
+	}
+};
+
+struct StoreRGBA16F
+{
+	static inline void
+	store(uint8_t* dst, size_t i, const Texel& t)
+	{
+		const uint16_t h[4] = { FramePacker::toHalf(t.r), FramePacker::toHalf(t.g), FramePacker::toHalf(t.b), FramePacker::toHalf(t.a) };
+		memcpy(dst + i * sizeof(h), h, sizeof(h));
+	}
+};
+
+struct StoreRGBA32F
+{
+	static inline void
+	store(uint8_t* dst, size_t i, const Texel& t)
+	{
+		const float f[4] = { t.r, t.g, t.b, t.a };
+		memcpy(dst + i * sizeof(f), f, sizeof(f));
+	}
+};
+
+template<typename Load, typename Store>
+static void
+packPixels(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		Store::store(dst, i, Load::load(src, i));
+}
+
+// The colours are already bytes, they only need an alpha
+template<>
+void
+packPixels<LoadRGB888, StoreRGBA8>(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[i * 4 + 0] = src[i * 3 + 0];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3 + 2];
+		dst[i * 4 + 3] = 0xff;
+	}
+}
+
+// Where the source is already in the destination's layout
+template<size_t Bytes>
+static void
+copyPixels(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	memcpy(dst, src, count * Bytes);
+}
+
+static const FramePacker::Kernel Kernels[FramePacker::NUM_SOURCES][FramePacker::NUM_DESTINATIONS] =
+{
+	// SOURCE_RGB888
+	{ packPixels<LoadRGB888, StoreRGBA8>, packPixels<LoadRGB888, StoreRGBA16F>, packPixels<LoadRGB888, StoreRGBA32F>, nullptr },
+	// SOURCE_IR16
+	{ packPixels<LoadIR16, StoreRGBA8>, packPixels<LoadIR16, StoreRGBA16F>, packPixels<LoadIR16, StoreRGBA32F>, nullptr },
+	// SOURCE_DEPTH16
+	{ nullptr, packPixels<LoadDepth16, StoreRGBA16F>, packPixels<LoadDepth16, StoreRGBA32F>, nullptr },
+	// SOURCE_POINTS
+	{ nullptr, packPixels<LoadPoints, StoreRGBA16F>, packPixels<LoadPoints, StoreRGBA32F>, nullptr },
+	// SOURCE_NORMALS_RGBA16F
+	{ nullptr, copyPixels<8>, packPixels<LoadHalf4, StoreRGBA32F>, nullptr },
+	// SOURCE_NORMALS_RG16F
+	{ nullptr, nullptr, nullptr, copyPixels<4> },
+	// SOURCE_DEPTH16_LIT
+	{ nullptr, nullptr, nullptr, nullptr },
+};
+
+// Where each source goes when it can't go where it was asked to
+static const FramePacker::Destination OwnDestinations[FramePacker::NUM_SOURCES] =
+{
+	FramePacker::DEST_RGBA32_FLOAT,
+	FramePacker::DEST_RGBA32_FLOAT,
+	FramePacker::DEST_RGBA32_FLOAT,
+	FramePacker::DEST_RGBA32_FLOAT,
+	FramePacker::DEST_RGBA16_FLOAT,
+	FramePacker::DEST_RG16_FLOAT,
+	FramePacker::DEST_RGBA32_FLOAT,
+};
+
+size_t
+FramePacker::sourceBytesPerPixel(Source source)
+{
+	static const size_t bytes[NUM_SOURCES] = { 3, 2, 2, 3 * sizeof(float), 4 * sizeof(uint16_t), 2 * sizeof(uint16_t), 2 };
+	return bytes[source];
+}
+
+size_t
+FramePacker::destinationBytesPerPixel(Destination destination)
+{
+	static const size_t bytes[NUM_DESTINATIONS] = { 4, 4 * sizeof(uint16_t), 4 * sizeof(float), 2 * sizeof(uint16_t) };
+	return bytes[destination];
+}
+
+FramePacker::Destination
+FramePacker::resolve(Source source, Destination requested)
+{
+	// Lit into the same colours as the visualizer's output
+	if (source == SOURCE_DEPTH16_LIT)
+		source = SOURCE_RGB888;
+
+	return Kernels[source][requested] ? requested : OwnDestinations[source];
+}
+
+FramePacker::Kernel
+FramePacker::select(Source source, Destination destination)
+{
+	return Kernels[source][destination];
+}
+
+void
+FramePacker::pack(Source source, Destination destination, const uint8_t* src, uint8_t* dst, int width, int height)
+{
+	const Kernel kernel = select(source, destination);
+	if (kernel)
+		kernel(src, dst, size_t(width) * height);
+}
+
+// Half of a typical 512 KB L2, the rest is left for everything else the core is doing
+static const size_t BandBytes = 256 * 1024;
+
+int
+FramePacker::rowsPerBand(Source source, Destination destination, int width)
+{
+	const size_t rowBytes = size_t(std::max(1, width)) * (sourceBytesPerPixel(source) + destinationBytesPerPixel(destination));
+	return int(std::max<size_t>(1, BandBytes / rowBytes));
+}
+
+void
+FramePacker::pack(Source source, Destination destination, const uint8_t* src, uint8_t* dst, int width, int height, WorkerPool& pool)
+{
+	const Kernel kernel = select(source, destination);
+	if (!kernel || width <= 0 || height <= 0)
+		return;
+
+	const int rows = rowsPerBand(source, destination, width);
+	const int numBands = (height + rows - 1) / rows;
+
+	const size_t srcBytes = sourceBytesPerPixel(source);
+	const size_t dstBytes = destinationBytesPerPixel(destination);
+
+	pool.run(numBands, [=](int band, int) {
+		const size_t first = size_t(band) * rows * width;
+		const size_t count = size_t(std::min(rows, height - band * rows)) * width;
+		kernel(src + first * srcBytes, dst + first * dstBytes, count);
+	});
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class WorkerPool;
+
+// Converts the listener's stream buffers into the pixel layout uploaded to the TOP.
+// Kept free of TouchDesigner types so it can be benchmarked on its own.
+//
+// There is a kernel for each pair of source and destination format, instantiated from one
+// template with the source's load and the destination's store, so the inner loop of each is
+// straight line code. The kernel is picked once a frame with select().
+class FramePacker
+{
+public:
+	// What the listener leaves in a stream's buffer
+	enum Source
+	{
+		SOURCE_RGB888,			// astra::RgbPixel, the lit depth, the color and IR RGB streams
+		SOURCE_IR16,			// the IR's uint16_t, shown in false colour
+		SOURCE_DEPTH16,			// int16_t depth in millimetres
+		SOURCE_POINTS,			// astra::Vector3f world space points in millimetres
+		SOURCE_NORMALS_RGBA16F,	// halves, see LitDepthVisualizer::OUTPUT_NORMALS_RGBA16F
+		SOURCE_NORMALS_RG16F,	// halves, see LitDepthVisualizer::OUTPUT_NORMALS_RG16F
+		SOURCE_DEPTH16_LIT,		// int16_t depth lit a tile at a time as it's packed, see TiledDepthRenderer
+		NUM_SOURCES
+	};
+
+	// What's uploaded, each the OP_PixelFormat of the same name
+	enum Destination
+	{
+		DEST_RGBA8_FIXED,
+		DEST_RGBA16_FLOAT,
+		DEST_RGBA32_FLOAT,
+		DEST_RG16_FLOAT,
+		NUM_DESTINATIONS
+	};
+
+	// Packs 'count' pixels
+	typedef void		(*Kernel)(const uint8_t* src, uint8_t* dst, size_t count);
+
+	static size_t		sourceBytesPerPixel(Source source);
+	static size_t		destinationBytesPerPixel(Destination destination);
+
+	// The destination 'source' is packed into when 'requested' is asked for. The colours go
+	// into any of the RGBA formats, the depth, points and normals don't fit in 8 bits and the
+	// octahedral normals only fit in RG16 Float, so those go into their own format instead.
+	static Destination	resolve(Source source, Destination requested);
+
+	// The kernel for a pair resolve() returns, there's none for SOURCE_DEPTH16_LIT
+	static Kernel		select(Source source, Destination destination);
+
+	static void			pack(Source source, Destination destination, const uint8_t* src, uint8_t* dst, int width, int height);
+	// The same, in bands of rows spread over the pool's threads. Each band's source and
+	// destination fit in a core's L2 together, so the stores don't evict the loads.
+	static void			pack(Source source, Destination destination, const uint8_t* src, uint8_t* dst, int width, int height, WorkerPool& pool);
+	static int			rowsPerBand(Source source, Destination destination, int width);
+
+	// An IEEE half, rounded to the nearest even. Too big rounds to infinity and NaN stays NaN.
+	static inline uint16_t
+	toHalf(float value)
+	{
+		uint32_t f;
+		memcpy(&f, &value, sizeof(f));
+
+		const uint32_t sign = f & 0x80000000u;
+		f ^= sign;
+
+		uint16_t half;
+		if (f >= (127u + 16u) << 23)
+		{
+			half = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+		}
+		else if (f < (127u - 14u) << 23)
+		{
+			// Denormal, adding this lines the mantissa up where the half's goes and rounds it
+			const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+			float magic;
+			memcpy(&magic, &magicBits, sizeof(magic));
+
+			float shifted;
+			memcpy(&shifted, &f, sizeof(shifted));
+			shifted += magic;
+
+			uint32_t bits;
+			memcpy(&bits, &shifted, sizeof(bits));
+			half = uint16_t(bits - magicBits);
+		}
+		else
+		{
+			// Rebias the exponent and round the mantissa, odd ones up on a tie
+			const uint32_t odd = (f >> 13) & 1;
+			f += ((15u - 127u) << 23) + 0xfff + odd;
+			half = uint16_t(f >> 13);
+		}
+
+		return half | uint16_t(sign >> 16);
+	}
+
+	static inline float
+	fromHalf(uint16_t half)
+	{
+		const uint32_t sign = uint32_t(half & 0x8000) << 16;
+		const uint32_t exponent = (half >> 10) & 0x1f;
+		const uint32_t mantissa = half & 0x3ff;
+
+		uint32_t bits;
+		if (exponent == 31)
+		{
+			bits = sign | 0x7f800000u | (mantissa << 13);
+		}
+		else if (exponent == 0)
+		{
+			// Denormal or zero, scaled by 2^-24 exactly
+			const float value = float(mantissa) * (1.0f / 16777216.0f);
+			memcpy(&bits, &value, sizeof(bits));
+			bits |= sign;
+		}
+		else
+		{
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+};
@@ -0,0 +1,316 @@
+#include "FrameRecorder.h"
+#include "DepthCodec.h"
+
+#include <string.h>
+
+FrameRecorder::FrameRecorder()
+{
+	memset(&header, 0, sizeof(header));
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	stop();
+}
+
+bool FrameRecorder::start(const std::string& path, float hFov, float vFov, bool compress)
+{
+	stop();
+
+#ifdef _WIN32
+	if (fopen_s(&file, path.c_str(), "wb") != 0)
+		file = nullptr;
+#else // macOS
+	file = fopen(path.c_str(), "wb");
+#endif
+	if (!file)
+		return false;
+
+	framesWritten.store(0);
+	framesDropped.store(0);
+	writeError.store(false);
+	depthCompressionRatio.store(1.0);
+
+	compressDepth = compress;
+	fileOffset = 0;
+	index.clear();
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RecordingMagic, sizeof(header.magic));
+	header.version = RecordingVersion;
+	header.headerSize = sizeof(RecordingHeader);
+	header.hFov = hFov;
+	header.vFov = vFov;
+
+	// Rewritten with the index offset and stream modes when the recording stops
+	write(&header, sizeof(header));
+
+	if (slots.empty()){
+		for (int i = 0; i < QueueCapacity; i++)
+			slots.push_back(std::unique_ptr<PendingFrame>(new PendingFrame()));
+	}
+
+	freeSlots.clear();
+	for (auto& slot : slots)
+		freeSlots.push_back(slot.get());
+	queuedFrames.clear();
+	framesInFlight = 0;
+	stopRequested = false;
+
+	writer = new std::thread([this]() { this->writerLoop(); });
+
+	recording.store(true);
+	return true;
+}
+
+void FrameRecorder::stop()
+{
+	if (!writer)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		recording.store(false);
+		stopRequested = true;
+	}
+	condition.notify_all();
+
+	writer->join();
+	delete writer;
+	writer = nullptr;
+}
+
+void FrameRecorder::record(const FrameSet& frames, uint64_t arrivalTime)
+{
+	PendingFrame* frame = nullptr;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!recording.load() || stopRequested)
+			return;
+
+		if (freeSlots.empty()){
+			framesDropped++;
+			return;
+		}
+
+		frame = freeSlots.back();
+		freeSlots.pop_back();
+		framesInFlight++;
+	}
+
+	frame->streams = 0;
+	frame->timestamp = frames.timestamp;
+	frame->arrivalTime = arrivalTime;
+	frame->numChunks = 0;
+
+	copyChunk(frames.depth, FrameSource::STREAM_DEPTH, ASTRA_PIXEL_FORMAT_DEPTH_MM, *frame);
+	copyChunk(frames.color, FrameSource::STREAM_COLOR, ASTRA_PIXEL_FORMAT_RGB888, *frame);
+	copyChunk(frames.ir16, FrameSource::STREAM_IR_16, ASTRA_PIXEL_FORMAT_GRAY16, *frame);
+	copyChunk(frames.irRgb, FrameSource::STREAM_IR_RGB, ASTRA_PIXEL_FORMAT_RGB888, *frame);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queuedFrames.push_back(frame);
+		framesInFlight--;
+	}
+	condition.notify_one();
+}
+
+uint64_t FrameRecorder::getFramesWritten() const
+{
+	return framesWritten.load();
+}
+
+uint64_t FrameRecorder::getFramesDropped() const
+{
+	return framesDropped.load();
+}
+
+bool FrameRecorder::hasWriteError() const
+{
+	return writeError.load();
+}
+
+double FrameRecorder::getDepthCompressionRatio() const
+{
+	return depthCompressionRatio.load();
+}
+
+template<typename T>
+void FrameRecorder::copyChunk(const FrameView<T>& view, uint32_t stream, uint32_t pixelFormat, PendingFrame& frame)
+{
+	if (!view.is_valid() || frame.numChunks == MaxChunks)
+		return;
+
+	const size_t byteLength = size_t(view.width) * view.height * sizeof(T);
+
+	PendingChunk& chunk = frame.chunks[frame.numChunks++];
+
+	memset(&chunk.header, 0, sizeof(chunk.header));
+	chunk.header.magic = RecordingChunkMagic;
+	chunk.header.stream = stream;
+	chunk.header.frameIndex = view.frameIndex;
+	chunk.header.width = view.width;
+	chunk.header.height = view.height;
+	chunk.header.pixelFormat = pixelFormat;
+	chunk.header.encoding = RECORDING_ENCODING_RAW;
+	chunk.header.rawSize = byteLength;
+	chunk.header.dataSize = byteLength;
+
+	// Only grows, so after the first few frames this doesn't allocate
+	if (chunk.data.size() < byteLength)
+		chunk.data.resize(byteLength);
+	memcpy(chunk.data.data(), view.data, byteLength);
+
+	frame.streams |= stream;
+}
+
+void FrameRecorder::writerLoop()
+{
+	for (;;){
+		PendingFrame* frame = nullptr;
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			condition.wait(guard, [this]() {
+				return !queuedFrames.empty() || (stopRequested && framesInFlight == 0);
+			});
+
+			if (queuedFrames.empty())
+				break;
+
+			frame = queuedFrames.front();
+			queuedFrames.pop_front();
+		}
+
+		writeFrame(*frame);
+
+		std::lock_guard<std::mutex> guard(lock);
+		freeSlots.push_back(frame);
+	}
+
+	finish();
+}
+
+void FrameRecorder::encodeChunk(PendingChunk& chunk)
+{
+	if (!compressDepth || chunk.header.stream != FrameSource::STREAM_DEPTH)
+		return;
+
+	const int width = chunk.header.width;
+	const int height = chunk.header.height;
+
+	// Only grows, like the chunk's data
+	const size_t maxSize = DepthCodec::maxEncodedSize(width, height);
+	if (chunk.encoded.size() < maxSize)
+		chunk.encoded.resize(maxSize);
+
+	const size_t size = DepthCodec::encode((const int16_t*)chunk.data.data(), width, height, chunk.encoded.data());
+
+	// Noise can make an image bigger, it's kept raw then
+	if (size < chunk.header.rawSize){
+		chunk.header.encoding = RECORDING_ENCODING_DEPTH_DELTA;
+		chunk.header.dataSize = size;
+	}
+
+	depthCompressionRatio.store(double(chunk.header.rawSize) / double(chunk.header.dataSize));
+}
+
+void FrameRecorder::writeFrame(PendingFrame& frame)
+{
+	if (writeError.load()){
+		framesDropped++;
+		return;
+	}
+
+	for (int i = 0; i < frame.numChunks; i++)
+		encodeChunk(frame.chunks[i]);
+
+	RecordingFrameHeader frameHeader;
+	memset(&frameHeader, 0, sizeof(frameHeader));
+	frameHeader.magic = RecordingFrameMagic;
+	frameHeader.frameNumber = uint32_t(index.size());
+	frameHeader.streams = frame.streams;
+	frameHeader.numChunks = frame.numChunks;
+	frameHeader.timestamp = frame.timestamp;
+	frameHeader.arrivalTime = frame.arrivalTime;
+	frameHeader.frameSize = sizeof(RecordingFrameHeader);
+	for (int i = 0; i < frame.numChunks; i++)
+		frameHeader.frameSize += sizeof(RecordingChunkHeader) + recordingAlign(frame.chunks[i].header.dataSize);
+
+	RecordingIndexEntry entry;
+	entry.offset = fileOffset;
+	entry.timestamp = frame.timestamp;
+	entry.arrivalTime = frame.arrivalTime;
+	entry.frameNumber = frameHeader.frameNumber;
+	entry.streams = frame.streams;
+
+	write(&frameHeader, sizeof(frameHeader));
+
+	for (int i = 0; i < frame.numChunks; i++){
+		const PendingChunk& chunk = frame.chunks[i];
+
+		write(&chunk.header, sizeof(chunk.header));
+		if (chunk.header.encoding == RECORDING_ENCODING_RAW)
+			write(chunk.data.data(), chunk.header.dataSize);
+		else
+			write(chunk.encoded.data(), chunk.header.dataSize);
+		writePadding(recordingAlign(chunk.header.dataSize) - chunk.header.dataSize);
+
+		bool known = false;
+		for (uint32_t s = 0; s < header.numStreams; s++)
+			known |= header.streams[s].stream == chunk.header.stream;
+
+		if (!known && header.numStreams < RecordingMaxStreams){
+			RecordingStreamMode& mode = header.streams[header.numStreams++];
+			mode.stream = chunk.header.stream;
+			mode.width = chunk.header.width;
+			mode.height = chunk.header.height;
+			mode.pixelFormat = chunk.header.pixelFormat;
+		}
+	}
+
+	if (writeError.load()){
+		framesDropped++;
+		return;
+	}
+
+	index.push_back(entry);
+	framesWritten++;
+}
+
+void FrameRecorder::write(const void* data, uint64_t size)
+{
+	if (size == 0 || writeError.load())
+		return;
+
+	if (fwrite(data, 1, size_t(size), file) != size)
+		writeError.store(true);
+
+	fileOffset += size;
+}
+
+void FrameRecorder::writePadding(uint64_t size)
+{
+	static const uint8_t zeros[RecordingAlignment] = {};
+	write(zeros, size);
+}
+
+void FrameRecorder::finish()
+{
+	if (!writeError.load()){
+		header.indexOffset = fileOffset;
+		header.numFrames = index.size();
+
+		write(index.data(), index.size() * sizeof(RecordingIndexEntry));
+
+		if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)
+			writeError.store(true);
+	}
+
+	if (fclose(file) != 0)
+		writeError.store(true);
+	file = nullptr;
+	index.clear();
+}
@@ -0,0 +1,106 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include "FrameSource.h"
+#include "RecordingFormat.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the raw frames delivered by a FrameSource to a recording, see RecordingFormat.h.
+//
+// record() only copies the frames into one of a fixed number of slots and hands them to a
+// writer thread, so the thread pumping the sensor never waits on the disk. When the writer
+// falls behind and every slot is full, the frame is dropped and counted instead.
+//
+// Depth, color and both IR streams are recorded. Points aren't, they can be rebuilt from
+// the depth using the field of view stored in the header. The depth can be compressed
+// losslessly with DepthCodec, that's done on the writer thread too.
+class FrameRecorder
+{
+public:
+	FrameRecorder();
+	~FrameRecorder();
+
+	// Returns false if the file can't be created
+	bool start(const std::string& path, float hFov, float vFov, bool compressDepth);
+	// Waits for the queued frames to be written, then writes the index and closes the file
+	void stop();
+
+	bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+	// Can be called from any one thread while recording
+	void record(const FrameSet& frames, uint64_t arrivalTime);
+
+	// Counts for the current or last recording
+	uint64_t getFramesWritten() const;
+	uint64_t getFramesDropped() const;
+	bool hasWriteError() const;
+	// Raw size over stored size of the depth in the last frame written, 1 when it's not compressed
+	double getDepthCompressionRatio() const;
+
+private:
+	static const int QueueCapacity = 8;
+	static const int MaxChunks = 4;
+
+	struct PendingChunk
+	{
+		RecordingChunkHeader header;
+		std::vector<uint8_t> data;
+		// The data after compression on the writer thread
+		std::vector<uint8_t> encoded;
+	};
+
+	struct PendingFrame
+	{
+		uint32_t streams{ 0 };
+		uint64_t timestamp{ 0 };
+		uint64_t arrivalTime{ 0 };
+
+		int numChunks{ 0 };
+		PendingChunk chunks[MaxChunks];
+	};
+
+	template<typename T>
+	void copyChunk(const FrameView<T>& view, uint32_t stream, uint32_t pixelFormat, PendingFrame& frame);
+
+	void writerLoop();
+	void encodeChunk(PendingChunk& chunk);
+	void writeFrame(PendingFrame& frame);
+	void write(const void* data, uint64_t size);
+	void writePadding(uint64_t size);
+	void finish();
+
+	std::atomic<bool> recording{ false };
+
+	std::mutex lock;
+	std::condition_variable condition;
+	bool stopRequested{ false };
+	int framesInFlight{ 0 };
+	std::vector<std::unique_ptr<PendingFrame>> slots;
+	std::vector<PendingFrame*> freeSlots;
+	std::deque<PendingFrame*> queuedFrames;
+
+	std::thread* writer{ nullptr };
+
+	// Only touched by the writer thread while recording
+	FILE* file{ nullptr };
+	uint64_t fileOffset{ 0 };
+	RecordingHeader header;
+	std::vector<RecordingIndexEntry> index;
+	bool compressDepth{ false };
+
+	std::atomic<uint64_t> framesWritten{ 0 };
+	std::atomic<uint64_t> framesDropped{ 0 };
+	std::atomic<bool> writeError{ false };
+	std::atomic<double> depthCompressionRatio{ 1.0 };
+};
+
+#endif // FRAMERECORDER_H
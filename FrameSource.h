@@ -0,0 +1,84 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <astra/astra.hpp>
+
+#include <cstdint>
+
+// One image of a frameset. The data is owned by the FrameSource and is only valid for
+// the duration of the on_frame_ready() call it was delivered in.
+template<typename T>
+struct FrameView
+{
+	const T* data{ nullptr };
+	int width{ 0 };
+	int height{ 0 };
+
+	// Frame index reported by the source for this stream, -1 when unknown
+	int32_t frameIndex{ -1 };
+
+	bool is_valid() const { return data != nullptr; }
+};
+
+// The frames a source delivered at one instant. Streams that weren't captured are left
+// as invalid views, 'streams' holds the FrameSource::StreamFlags of the valid ones.
+struct FrameSet
+{
+	FrameView<int16_t> depth;				// Millimetres, 0 where there's no reading
+	FrameView<astra::RgbPixel> color;
+	FrameView<uint16_t> ir16;
+	FrameView<astra::RgbPixel> irRgb;
+
+	uint32_t streams{ 0 };
+
+	// Microseconds on the device clock, 0 when the source doesn't provide one
+	uint64_t timestamp{ 0 };
+};
+
+// Something that produces framesets, either a sensor or a stand-in for one.
+//
+// update() is pumped regularly from a single thread and delivers any frameset that is
+// ready to the listener synchronously, on that same thread.
+class FrameSource
+{
+public:
+	enum StreamFlags
+	{
+		STREAM_DEPTH	= 1 << 0,
+		STREAM_COLOR	= 1 << 1,
+		STREAM_IR_16	= 1 << 2,
+		STREAM_IR_RGB	= 1 << 3,
+	};
+
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+		virtual void on_frame_ready(const FrameSet& frames) = 0;
+	};
+
+	virtual ~FrameSource() {}
+
+	void setListener(Listener* l) { listener = l; }
+
+	// The streams the listener is currently interested in. Sources may deliver more than
+	// these, but can skip producing anything outside of them. Can be called from any thread.
+	virtual void setStreams(uint32_t streams) {}
+
+	virtual void update() = 0;
+
+	// How long update() may block waiting for a frame, in milliseconds, for sources that can
+	// wait for one rather than be polled. Can be called from any thread.
+	virtual void setWaitTimeout(unsigned int milliseconds) {}
+	// True if update() waits for the next frame, or always has one ready, so it needn't be
+	// called on a timer
+	virtual bool waitsForFrames() const { return false; }
+
+	// Field of view of the depth camera in radians, relating depth pixels to points
+	virtual void getFieldOfView(float& hFov, float& vFov) const = 0;
+
+protected:
+	Listener* listener{ nullptr };
+};
+
+#endif // FRAMESOURCE_H
@@ -1,277 +1,1929 @@
-#include "LitDepthVisualizer.h"
-
-void LitDepthVisualizer::box_blur(const astra::Vector3f* in, astra::Vector3f * out, const size_t width, const size_t height, const int blurRadius)
-{
-	const size_t maxY = height - blurRadius;
-	const size_t maxX = width - blurRadius;
-
-	out += blurRadius * width;
-
-	for (size_t y = blurRadius; y < maxY; ++y){
-		out += blurRadius;
-		for (size_t x = blurRadius; x < maxX; ++x, ++out){
-			astra::Vector3f normAvg;
-
-			size_t index = x - blurRadius + (y - blurRadius) * width;
-			const astra::Vector3f* in_row = in + index;
-
-			for (int dy = -blurRadius; dy <= blurRadius; ++dy, in_row += width)
-			{
-				const astra::Vector3f* in_kernel = in_row;
-				for (int dx = -blurRadius; dx <= blurRadius; ++dx, ++in_kernel)
-				{
-					normAvg += *in_kernel;
-				}
-			}
-
-			*out = astra::Vector3f::normalize(normAvg);
-		}
-		out += blurRadius;
-	}
-}
-
-void LitDepthVisualizer::box_blur_fast(const astra::Vector3f* in, astra::Vector3f * out, const size_t width, const size_t height)
-{
-	const size_t maxY = height;
-	const size_t maxX = width;
-
-	const astra::Vector3f* in_row = in + width;
-	astra::Vector3f* out_row = out;
-
-	memset(out, 0, width * height * sizeof(astra::Vector3f));
-
-	for (size_t y = 1; y < maxY; ++y, in_row += width, out_row += width){
-		const astra::Vector3f* in_left = in_row - 1;
-		const astra::Vector3f* in_mid = in_row + 1;
-
-		astra::Vector3f* out_up = out_row;
-		astra::Vector3f* out_mid = out_row + width;
-
-		astra::Vector3f xKernelTotal = *in_left + *in_row;
-
-		for (size_t x = 1; x < maxX; ++x){
-			xKernelTotal += *in_mid;
-
-			*out_up += xKernelTotal;
-			*out_mid += xKernelTotal;
-
-			xKernelTotal -= *in_left;
-
-			++in_left;
-			++in_mid;
-			++out_up;
-			++out_mid;
-		}
-	}
-}
-
-LitDepthVisualizer::LitDepthVisualizer() :
-	lightVector(0.44022f, -0.17609f, 0.88045f)
-{
-	lightColor = { 210, 210, 210 };
-	ambientColor = { 30, 30, 30 };
-}
-
-void LitDepthVisualizer::set_light_color(const astra::RgbPixel& color)
-{
-	lightColor = color;
-}
-
-void LitDepthVisualizer::set_light_direction(const astra::Vector3f& direction)
-{
-	lightVector = direction;
-}
-
-void LitDepthVisualizer::set_ambient_color(const astra::RgbPixel& color)
-{
-	ambientColor = color;
-}
-
-void LitDepthVisualizer::set_blur_radius(unsigned int radius)
-{
-	blurRadius = radius;
-}
-
-void LitDepthVisualizer::update(const astra::PointFrame& pointFrame)
-{
-	calculate_normals(pointFrame);
-
-	const size_t width = pointFrame.width();
-	const size_t height = pointFrame.height();
-
-	prepare_buffer(width, height);
-
-	const astra::Vector3f* pointData = pointFrame.data();
-
-	astra_rgb_pixel_t* texturePtr = outputBuffer.get();
-
-	const astra::Vector3f* normMap = blurNormalMap.get();
-	const bool useNormalMap = normMap != nullptr;
-
-	for (unsigned y = 0; y < height; ++y)
-	{
-		for (unsigned x = 0; x < width; ++x, ++pointData, ++normMap, ++texturePtr)
-		{
-			float depth = (*pointData).z;
-
-			astra::Vector3f norm(1, 0, 0);
-
-			if (useNormalMap)
-			{
-				norm = astra::Vector3f::normalize(*normMap);
-			}
-
-			if (depth != 0)
-			{
-				const float fadeFactor = static_cast<float>(
-					1.0f - 0.6f * std::max(0.0f, std::min(1.0f, ((depth - 400.0f) / 3200.0f))));
-
-				const float diffuseFactor = norm.dot(lightVector);
-
-				astra_rgb_pixel_t diffuseColor;
-
-				if (diffuseFactor > 0)
-				{
-					//only add diffuse when mesh is facing the light
-					diffuseColor.r = static_cast<uint8_t>(lightColor.r * diffuseFactor);
-					diffuseColor.g = static_cast<uint8_t>(lightColor.g * diffuseFactor);
-					diffuseColor.b = static_cast<uint8_t>(lightColor.b * diffuseFactor);
-				}
-				else
-				{
-					diffuseColor.r = 0;
-					diffuseColor.g = 0;
-					diffuseColor.b = 0;
-				}
-
-				texturePtr->r = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.r + diffuseColor.r))));
-				texturePtr->g = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.g + diffuseColor.g))));
-				texturePtr->b = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.b + diffuseColor.b))));
-			}
-			else
-			{
-				texturePtr->r = 0;
-				texturePtr->g = 0;
-				texturePtr->b = 0;
-			}
-		}
-	}
-}
-
-astra::RgbPixel* LitDepthVisualizer::get_output() const { 
-	return outputBuffer.get(); 
-}
-
-void LitDepthVisualizer::prepare_buffer(size_t width, size_t height)
-{
-	if (outputBuffer == nullptr || width != outputWidth || height != outputHeight)
-	{
-		outputWidth = width;
-		outputHeight = height;
-		outputBuffer = astra::make_unique<astra::RgbPixel[]>(outputWidth * outputHeight);
-	}
-
-	std::fill(outputBuffer.get(), outputBuffer.get() + outputWidth * outputHeight, astra::RgbPixel(0, 0, 0));
-}
-
-void LitDepthVisualizer::calculate_normals(const astra::PointFrame& pointFrame)
-{
-	const astra::Vector3f* positionMap = pointFrame.data();
-
-	const int width = pointFrame.width();
-	const int height = pointFrame.height();
-
-	const size_t numPixels = width * height;
-
-	if (normalMap == nullptr || normalMapLength != numPixels)
-	{
-		normalMap = astra::make_unique<astra::Vector3f[]>(numPixels);
-		blurNormalMap = astra::make_unique<astra::Vector3f[]>(numPixels);
-
-		std::fill(blurNormalMap.get(), blurNormalMap.get() + numPixels, astra::Vector3f::zero());
-
-		normalMapLength = numPixels;
-	}
-
-	astra::Vector3f* normMap = normalMap.get();
-
-	//top row
-	for (int x = 0; x < width; ++x)
-	{
-		*normMap = astra::Vector3f::zero();
-		++normMap;
-	}
-
-	const int maxY = height - 1;
-	const int maxX = width - 1;
-
-	for (int y = 1; y < maxY; ++y)
-	{
-		//first pixel at start of row
-		*normMap = astra::Vector3f::zero();
-		++normMap;
-
-		//Initialize pointer arithmetic for the x=0 position
-		const astra::Vector3f* p_point = positionMap + y * width;
-		const astra::Vector3f* p_pointLeft = p_point - 1;
-		const astra::Vector3f* p_pointRight = p_point + 1;
-		const astra::Vector3f* p_pointUp = p_point - width;
-		const astra::Vector3f* p_pointDown = p_point + width;
-
-		for (int x = 1; x < maxX; ++x)
-		{
-			++p_pointLeft;
-			++p_point;
-			++p_pointRight;
-			++p_pointUp;
-			++p_pointDown;
-
-			const astra::Vector3f& point = *p_point;
-			const astra::Vector3f& pointLeft = *p_pointLeft;
-			const astra::Vector3f& pointRight = *p_pointRight;
-			const astra::Vector3f& pointUp = *p_pointUp;
-			const astra::Vector3f& pointDown = *p_pointDown;
-
-			if (point.z != 0 &&
-				pointRight.z != 0 &&
-				pointDown.z != 0 &&
-				pointLeft.z != 0 &&
-				pointUp.z != 0
-				)
-			{
-				astra::Vector3f vr = pointRight - point;
-				astra::Vector3f vd = pointDown - point;
-				astra::Vector3f vl = pointLeft - point;
-				astra::Vector3f vu = pointUp - point;
-
-				astra::Vector3f normAvg = vd.cross(vr);
-				normAvg += vl.cross(vd);
-				normAvg += vu.cross(vl);
-				normAvg += vr.cross(vu);
-
-				*normMap = astra::Vector3f::normalize(normAvg);
-
-			}
-			else
-			{
-				*normMap = astra::Vector3f::zero();
-			}
-
-			++normMap;
-		}
-
-		//last pixel at end of row
-		*normMap = astra::Vector3f::zero();
-		++normMap;
-	}
-
-	//bottom row
-	for (int x = 0; x < width; ++x)
-	{
-		*normMap = astra::Vector3f::zero();
-		++normMap;
-	}
-
-	//box_blur(normalMap_.get(), blurNormalMap_.get(), width, height, blurRadius_);
-	LitDepthVisualizer::box_blur_fast(normalMap.get(), blurNormalMap.get(), width, height);
+#include "LitDepthVisualizer.h"
+#include "FramePacker.h"
+#include "SimdTarget.h"
+
+#include <cmath>
+
+#ifdef SIMD_AVX2
+#ifdef _WIN32
+#include <intrin.h>
+#else // macOS
+#include <cpuid.h>
+#endif
+#endif
+
+const float LitDepthVisualizer::OctTexelNone = -2.0f;
+const unsigned int LitDepthVisualizer::MaxBlurRadius;
+
+// The encoding is written without data dependent branches, a map of normals pointing every
+// which way would mispredict them constantly
+
+static inline float sign_not_zero(float v)
+{
+	return std::copysign(1.0f, v);
+}
+
+static inline int16_t to_snorm16(float v)
+{
+	return int16_t(v * 32767.0f + std::copysign(0.5f, v));
+}
+
+// The float maps hold unit normals, the octahedral encoding doesn't need them normalized
+static inline void store_normal(astra::Vector3f& out, const astra::Vector3f& normal)
+{
+	out = astra::Vector3f::normalize(normal);
+}
+
+static inline void store_normal(LitDepthVisualizer::OctNormal& out, const astra::Vector3f& normal)
+{
+	out = LitDepthVisualizer::encode_normal(normal);
+}
+
+// The blurred normals as the shading uses them
+static inline astra::Vector3f shading_normal(const astra::Vector3f& normal)
+{
+	return astra::Vector3f::normalize(normal);
+}
+
+static inline astra::Vector3f shading_normal(const LitDepthVisualizer::OctNormal& normal)
+{
+	return LitDepthVisualizer::decode_normal(normal);
+}
+
+// The float maps blur to plain sums that shade() normalizes, the octahedral ones re-encode them
+static inline void store_sum(astra::Vector3f& out, const astra::Vector3f& sum)
+{
+	out = sum;
+}
+
+static inline void store_sum(LitDepthVisualizer::OctNormal& out, const astra::Vector3f& sum)
+{
+	out = LitDepthVisualizer::encode_normal(sum);
+}
+
+// A plane of LAYOUT_SOA
+static inline void store_sum(float& out, float sum)
+{
+	out = sum;
+}
+
+// Where 'normal' is on the octahedron, in [-1, 1], false for the zero vector
+static inline bool fold_octahedral(const astra::Vector3f& normal, float& outX, float& outY)
+{
+	const float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (l1 < 1e-9f)
+		return false;
+
+	const float scale = 1.0f / l1;
+	const float x = normal.x * scale;
+	const float y = normal.y * scale;
+
+	// The lower half of the octahedron is folded out over the diagonals
+	const bool fold = normal.z < 0.0f;
+	const float foldedX = (1.0f - std::fabs(y)) * sign_not_zero(x);
+	const float foldedY = (1.0f - std::fabs(x)) * sign_not_zero(y);
+
+	outX = fold ? foldedX : x;
+	outY = fold ? foldedY : y;
+	return true;
+}
+
+LitDepthVisualizer::OctNormal LitDepthVisualizer::encode_normal(const astra::Vector3f& normal)
+{
+	float x = 0.0f;
+	float y = 0.0f;
+	if (!fold_octahedral(normal, x, y))
+		return OctNormal{ OctNormalNone, 0 };
+
+	return OctNormal{ to_snorm16(x), to_snorm16(y) };
+}
+
+astra::Vector3f LitDepthVisualizer::decode_normal(OctNormal normal)
+{
+	const float foldedX = normal.x * (1.0f / 32767.0f);
+	const float foldedY = normal.y * (1.0f / 32767.0f);
+	const float z = 1.0f - std::fabs(foldedX) - std::fabs(foldedY);
+
+	const bool unfold = z < 0.0f;
+	const float unfoldedX = (1.0f - std::fabs(foldedY)) * sign_not_zero(foldedX);
+	const float unfoldedY = (1.0f - std::fabs(foldedX)) * sign_not_zero(foldedY);
+	const float x = unfold ? unfoldedX : foldedX;
+	const float y = unfold ? unfoldedY : foldedY;
+
+	// OctNormalNone decodes to something finite, which is scaled away
+	const float scale = normal.x == OctNormalNone ? 0.0f : 1.0f / std::sqrt(x * x + y * y + z * z);
+	return astra::Vector3f(x * scale, y * scale, z * scale);
+}
+
+void LitDepthVisualizer::box_blur(const astra::Vector3f* in, astra::Vector3f * out, const size_t width, const size_t height, const int blurRadius)
+{
+	const size_t maxY = height - blurRadius;
+	const size_t maxX = width - blurRadius;
+
+	out += blurRadius * width;
+
+	for (size_t y = blurRadius; y < maxY; ++y){
+		out += blurRadius;
+		for (size_t x = blurRadius; x < maxX; ++x, ++out){
+			astra::Vector3f normAvg;
+
+			size_t index = x - blurRadius + (y - blurRadius) * width;
+			const astra::Vector3f* in_row = in + index;
+
+			for (int dy = -blurRadius; dy <= blurRadius; ++dy, in_row += width)
+			{
+				const astra::Vector3f* in_kernel = in_row;
+				for (int dx = -blurRadius; dx <= blurRadius; ++dx, ++in_kernel)
+				{
+					normAvg += *in_kernel;
+				}
+			}
+
+			*out = astra::Vector3f::normalize(normAvg);
+		}
+		out += blurRadius;
+	}
+}
+
+void LitDepthVisualizer::box_blur_fast(const astra::Vector3f* in, astra::Vector3f * out, const size_t width, const size_t height)
+{
+	const size_t maxY = height;
+	const size_t maxX = width;
+
+	const astra::Vector3f* in_row = in + width;
+	astra::Vector3f* out_row = out;
+
+	std::fill(out, out + width * height, astra::Vector3f());
+
+	for (size_t y = 1; y < maxY; ++y, in_row += width, out_row += width){
+		const astra::Vector3f* in_left = in_row - 1;
+		const astra::Vector3f* in_mid = in_row + 1;
+
+		astra::Vector3f* out_up = out_row;
+		astra::Vector3f* out_mid = out_row + width;
+
+		astra::Vector3f xKernelTotal = *in_left + *in_row;
+
+		for (size_t x = 1; x < maxX; ++x){
+			xKernelTotal += *in_mid;
+
+			*out_up += xKernelTotal;
+			*out_mid += xKernelTotal;
+
+			xKernelTotal -= *in_left;
+
+			++in_left;
+			++in_mid;
+			++out_up;
+			++out_mid;
+		}
+	}
+}
+
+void LitDepthVisualizer::box_blur_octahedral(const OctNormal* in, OctNormal* out, const size_t width, const size_t height, astra::Vector3f* rows)
+{
+	const OctNormal none{ OctNormalNone, 0 };
+
+	if (width < 2){
+		std::fill(out, out + width * height, none);
+		return;
+	}
+
+	// The same kernel as box_blur_fast(): output row y is the sum of the three across sums of
+	// input rows y and y + 1, leaving out row 0. The sum for column x is of x - 1, x and x + 1,
+	// and the last column is left empty.
+	const size_t sumsWidth = width - 1;
+	astra::Vector3f* sums = rows;
+	astra::Vector3f* sumsBelow = rows + width;
+
+	auto sumRow = [&](size_t y, astra::Vector3f* rowSums){
+		if (y == 0 || y >= height){
+			std::fill(rowSums, rowSums + sumsWidth, astra::Vector3f::zero());
+			return;
+		}
+
+		const OctNormal* in_row = in + y * width;
+		astra::Vector3f left = decode_normal(in_row[-1]);
+		astra::Vector3f mid = decode_normal(in_row[0]);
+
+		for (size_t x = 0; x < sumsWidth; ++x){
+			const astra::Vector3f right = decode_normal(in_row[x + 1]);
+			rowSums[x] = left + mid + right;
+			left = mid;
+			mid = right;
+		}
+	};
+
+	sumRow(0, sums);
+
+	for (size_t y = 0; y < height; ++y){
+		sumRow(y + 1, sumsBelow);
+
+		OctNormal* out_row = out + y * width;
+		for (size_t x = 0; x < sumsWidth; ++x)
+			out_row[x] = encode_normal(sums[x] + sumsBelow[x]);
+		out_row[sumsWidth] = none;
+
+		std::swap(sums, sumsBelow);
+	}
+}
+
+// The float maps, and the planes of LAYOUT_SOA
+template<typename T>
+static inline void add_row(const T* row, T* columns, const size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+		columns[x] += row[x];
+}
+
+static inline void add_row(const LitDepthVisualizer::OctNormal* row, astra::Vector3f* columns, const size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+		columns[x] += shading_normal(row[x]);
+}
+
+template<typename T>
+static inline void subtract_row(const T* row, T* columns, const size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+		columns[x] -= row[x];
+}
+
+static inline void subtract_row(const LitDepthVisualizer::OctNormal* row, astra::Vector3f* columns, const size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+		columns[x] -= shading_normal(row[x]);
+}
+
+// The sums of the columns from x - radius to x + radius, leaving out the ones past the edges
+template<typename Sum>
+static void sum_box_across(const Sum* columns, Sum* sums, const size_t width, const size_t radius)
+{
+	Sum total = Sum();
+	for (size_t x = 0; x < width && x < radius; ++x)
+		total += columns[x];
+
+	for (size_t x = 0; x < width; ++x){
+		if (x + radius < width)
+			total += columns[x + radius];
+
+		sums[x] = total;
+
+		if (x >= radius)
+			total -= columns[x - radius];
+	}
+}
+
+// The rows leaving the box are taken off the column sums before the row entering it is added,
+// update_fused_box() does the same so the two come out exactly the same
+template<typename Normal, typename Sum>
+static void box_blur_columns(const Normal* in, Normal* out, const size_t width, const size_t height, const int radius, Sum* rows)
+{
+	const size_t r = size_t(std::max(radius, 0));
+	Sum* columns = rows;
+	Sum* sums = rows + width;
+
+	std::fill(columns, columns + width, Sum());
+
+	for (size_t y = 0; y < r && y < height; ++y)
+		add_row(in + y * width, columns, width);
+
+	for (size_t y = 0; y < height; ++y){
+		if (y > r)
+			subtract_row(in + (y - r - 1) * width, columns, width);
+		if (y + r < height)
+			add_row(in + (y + r) * width, columns, width);
+
+		sum_box_across(columns, sums, width, r);
+
+		Normal* out_row = out + y * width;
+		for (size_t x = 0; x < width; ++x)
+			store_sum(out_row[x], sums[x]);
+	}
+}
+
+void LitDepthVisualizer::box_blur_separable(const astra::Vector3f* in, astra::Vector3f* out, const size_t width, const size_t height, const int radius, astra::Vector3f* rows)
+{
+	box_blur_columns(in, out, width, height, radius, rows);
+}
+
+void LitDepthVisualizer::box_blur_separable(const OctNormal* in, OctNormal* out, const size_t width, const size_t height, const int radius, astra::Vector3f* rows)
+{
+	box_blur_columns(in, out, width, height, radius, rows);
+}
+
+LitDepthVisualizer::LitDepthVisualizer() :
+	lightVector(0.44022f, -0.17609f, 0.88045f)
+{
+	lightColor = { 210, 210, 210 };
+	ambientColor = { 30, 30, 30 };
+}
+
+void LitDepthVisualizer::set_light_color(const astra::RgbPixel& color)
+{
+	lightColor = color;
+}
+
+void LitDepthVisualizer::set_light_direction(const astra::Vector3f& direction)
+{
+	lightVector = direction;
+}
+
+void LitDepthVisualizer::set_ambient_color(const astra::RgbPixel& color)
+{
+	ambientColor = color;
+}
+
+void LitDepthVisualizer::set_blur_radius(unsigned int radius)
+{
+	blurRadius = std::min(radius, MaxBlurRadius);
+}
+
+void LitDepthVisualizer::set_normal_format(NormalFormat format)
+{
+	normalFormat = format;
+}
+
+void LitDepthVisualizer::set_blur_mode(BlurMode mode)
+{
+	blurMode = mode;
+}
+
+void LitDepthVisualizer::set_fused(bool f)
+{
+	fused = f;
+}
+
+void LitDepthVisualizer::set_layout(Layout l)
+{
+	layout = l;
+}
+
+void LitDepthVisualizer::set_normal_source(NormalSource source)
+{
+	normalSource = source;
+}
+
+void LitDepthVisualizer::set_normal_estimator(NormalEstimator e)
+{
+	estimator = e;
+}
+
+void LitDepthVisualizer::set_integral_window(unsigned int size)
+{
+	integralWindow = size;
+}
+
+void LitDepthVisualizer::set_depth_change_threshold(float threshold)
+{
+	depthChangeThreshold = threshold;
+}
+
+void LitDepthVisualizer::set_output(Output o)
+{
+	output = o;
+}
+
+void LitDepthVisualizer::update(const astra::PointFrame& pointFrame)
+{
+	update(pointFrame.data(), pointFrame.width(), pointFrame.height());
+}
+
+void LitDepthVisualizer::update_depth(const int16_t* depthData, size_t width, size_t height, float hFov, float vFov)
+{
+	if (!prepare_buffers(width, height, false, true))
+		return;
+	prepare_rays(hFov, vFov);
+
+	calculate_depth_normals(depthData, width, height);
+
+	// Every pixel is written, so the output isn't cleared first
+	if (output != OUTPUT_SHADED)
+		write_normals(nullptr, width * height);
+	else
+		shade_planes(outputBuffer, width * height);
+}
+
+// The same projection as the Astra SDK's depth to world conversion, a point is its depth
+// times the ray through its pixel
+void LitDepthVisualizer::make_rays(size_t width, size_t height, float hFov, float vFov, float* columnRays, float* rowRays)
+{
+	const float xzFactor = std::tan(hFov / 2.0f) * 2.0f;
+	const float yzFactor = std::tan(vFov / 2.0f) * 2.0f;
+
+	for (size_t x = 0; x < width; ++x)
+		columnRays[x] = (float(x) / float(width) - 0.5f) * xzFactor;
+
+	for (size_t y = 0; y < height; ++y)
+		rowRays[y] = (0.5f - float(y) / float(height)) * yzFactor;
+}
+
+void LitDepthVisualizer::prepare_rays(float hFov, float vFov)
+{
+	if (rayGeneration == arenaGeneration && hFov == rayHFov && vFov == rayVFov)
+		return;
+
+	make_rays(outputWidth, outputHeight, hFov, vFov, rayX, rayY);
+
+	rayGeneration = arenaGeneration;
+	rayHFov = hFov;
+	rayVFov = vFov;
+}
+
+void LitDepthVisualizer::update(const astra::Vector3f* pointData, size_t width, size_t height)
+{
+	if (fused_rows())
+	{
+		update_fused(pointData, width, height);
+		return;
+	}
+
+	if (!calculate_normals(pointData, int(width), int(height)))
+		return;
+
+	if (output != OUTPUT_SHADED)
+	{
+		write_normals(pointData, width * height);
+		return;
+	}
+
+	if (!prepare_buffer(width, height))
+		return;
+
+	if (bufferLayout == LAYOUT_SOA)
+		shade_planes(outputBuffer, width * height);
+	else if (bufferFormat == NORMAL_OCTAHEDRAL)
+		shade(pointData, blurNormalMapOct, outputBuffer, width, height);
+	else
+		shade(pointData, blurNormalMap, outputBuffer, width, height);
+}
+
+template<typename Normal>
+void LitDepthVisualizer::shade(const astra::Vector3f* pointData, const Normal* normMap, astra::RgbPixel* texturePtr, size_t width, size_t height)
+{
+	const bool useNormalMap = normMap != nullptr;
+	const size_t count = width * height;
+
+	// The vector kernel shades groups of 8 pixels, the rest are done here
+	const size_t vectorised = useNormalMap ? shade_simd(pointData, normMap, texturePtr, count) : 0;
+	pointData += vectorised;
+	texturePtr += vectorised;
+	if (useNormalMap)
+		normMap += vectorised;
+
+	for (size_t i = vectorised; i < count; ++i, ++pointData, ++normMap, ++texturePtr)
+	{
+		astra::Vector3f norm(1, 0, 0);
+
+		if (useNormalMap)
+		{
+			norm = shading_normal(*normMap);
+		}
+
+		shade_pixel((*pointData).z, norm, *texturePtr);
+	}
+}
+
+void LitDepthVisualizer::shade_pixel(float depth, const astra::Vector3f& norm, astra::RgbPixel& out) const
+{
+	astra::RgbPixel* texturePtr = &out;
+
+	if (depth != 0)
+	{
+		const float fadeFactor = static_cast<float>(
+			1.0f - 0.6f * std::max(0.0f, std::min(1.0f, ((depth - 400.0f) / 3200.0f))));
+
+		const float diffuseFactor = norm.dot(lightVector);
+
+		astra_rgb_pixel_t diffuseColor;
+
+		if (diffuseFactor > 0)
+		{
+			//only add diffuse when mesh is facing the light
+			diffuseColor.r = static_cast<uint8_t>(lightColor.r * diffuseFactor);
+			diffuseColor.g = static_cast<uint8_t>(lightColor.g * diffuseFactor);
+			diffuseColor.b = static_cast<uint8_t>(lightColor.b * diffuseFactor);
+		}
+		else
+		{
+			diffuseColor.r = 0;
+			diffuseColor.g = 0;
+			diffuseColor.b = 0;
+		}
+
+		texturePtr->r = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.r + diffuseColor.r))));
+		texturePtr->g = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.g + diffuseColor.g))));
+		texturePtr->b = std::max(0, std::min(255, (int)(fadeFactor*(ambientColor.b + diffuseColor.b))));
+	}
+	else
+	{
+		texturePtr->r = 0;
+		texturePtr->g = 0;
+		texturePtr->b = 0;
+	}
+}
+
+#ifdef SIMD_AVX2
+
+// The shading of 8 pixels, with the light set up in registers once. The light only adds
+// where the normal faces it, and the pixels without depth are masked out rather than
+// branched around. Truncates and clamps the same as shade_pixel().
+struct ShaderAvx2
+{
+	__m256 lightX, lightY, lightZ;
+	__m256 lightR, lightG, lightB;
+	__m256i ambientR, ambientG, ambientB;
+
+	AVX2_TARGET
+	ShaderAvx2(const astra::Vector3f& lightVector, const astra::RgbPixel& lightColor, const astra::RgbPixel& ambientColor) :
+		lightX(_mm256_set1_ps(lightVector.x)),
+		lightY(_mm256_set1_ps(lightVector.y)),
+		lightZ(_mm256_set1_ps(lightVector.z)),
+		lightR(_mm256_set1_ps(float(lightColor.r))),
+		lightG(_mm256_set1_ps(float(lightColor.g))),
+		lightB(_mm256_set1_ps(float(lightColor.b))),
+		ambientR(_mm256_set1_epi32(ambientColor.r)),
+		ambientG(_mm256_set1_epi32(ambientColor.g)),
+		ambientB(_mm256_set1_epi32(ambientColor.b))
+	{
+	}
+
+	AVX2_TARGET
+	static inline __m256i channel(__m256 light, __m256i ambient, __m256 diffuseFactor, __m256 fadeFactor)
+	{
+		const __m256i diffuse = _mm256_cvttps_epi32(_mm256_mul_ps(light, diffuseFactor));
+		const __m256 lit = _mm256_cvtepi32_ps(_mm256_add_epi32(ambient, diffuse));
+		const __m256i value = _mm256_cvttps_epi32(_mm256_mul_ps(fadeFactor, lit));
+		return _mm256_max_epi32(_mm256_setzero_si256(), _mm256_min_epi32(_mm256_set1_epi32(255), value));
+	}
+
+	// Scales the normals to unit length with the reciprocal square root and one
+	// Newton-Raphson step, like astra::Vector3f::normalize() the ones shorter than 1e-9
+	// become zero. 'mask' can zero some more.
+	AVX2_TARGET
+	static inline void normalize(__m256& x, __m256& y, __m256& z, __m256 mask)
+	{
+		const __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		__m256 scale = _mm256_rsqrt_ps(length2);
+		scale = _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_set1_ps(1.5f),
+			_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), length2), _mm256_mul_ps(scale, scale))));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(length2, _mm256_set1_ps(1e-18f), _CMP_GE_OQ));
+		scale = _mm256_and_ps(scale, mask);
+		x = _mm256_mul_ps(x, scale);
+		y = _mm256_mul_ps(y, scale);
+		z = _mm256_mul_ps(z, scale);
+	}
+
+	// Writes 8 packed pixels, 24 bytes, without writing past the last of them
+	AVX2_TARGET
+	inline void shade(__m256 depth, __m256 x, __m256 y, __m256 z, astra::RgbPixel* texturePtr) const
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		normalize(x, y, z, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+
+		const __m256 fadeFactor = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_set1_ps(0.6f),
+			_mm256_max_ps(zero, _mm256_min_ps(one, _mm256_div_ps(_mm256_sub_ps(depth, _mm256_set1_ps(400.0f)), _mm256_set1_ps(3200.0f))))));
+
+		__m256 diffuseFactor = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, lightX), _mm256_mul_ps(y, lightY)), _mm256_mul_ps(z, lightZ));
+		diffuseFactor = _mm256_and_ps(diffuseFactor, _mm256_cmp_ps(diffuseFactor, zero, _CMP_GT_OQ));
+
+		const __m256i r = channel(lightR, ambientR, diffuseFactor, fadeFactor);
+		const __m256i g = channel(lightG, ambientG, diffuseFactor, fadeFactor);
+		const __m256i b = channel(lightB, ambientB, diffuseFactor, fadeFactor);
+		__m256i pixels = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+
+		// Black where there's no depth, then the low three bytes of each pixel's 32 bits
+		pixels = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(depth, zero, _CMP_EQ_OQ)), pixels);
+		pixels = _mm256_shuffle_epi8(pixels, _mm256_setr_epi8(
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+
+		uint8_t* out = (uint8_t*)texturePtr;
+		const __m128i low = _mm256_castsi256_si128(pixels);
+		const __m128i high = _mm256_extracti128_si256(pixels, 1);
+		const int lowTail = _mm_extract_epi32(low, 2);
+		_mm_storel_epi64((__m128i*)out, low);
+		memcpy(out + 8, &lowTail, 4);
+		_mm_storel_epi64((__m128i*)(out + 12), high);
+		const int highTail = _mm_extract_epi32(high, 2);
+		memcpy(out + 20, &highTail, 4);
+	}
+};
+
+// shade() on 8 pixels at a time, read across from the array of structs with gathers
+AVX2_TARGET
+static size_t shade_avx2(
+	const astra::Vector3f* pointData,
+	const astra::Vector3f* normMap,
+	astra::RgbPixel* texturePtr,
+	size_t count,
+	const ShaderAvx2& shader)
+{
+	const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const float* points = &pointData[i].x;
+		const float* normals = &normMap[i].x;
+
+		const __m256 depth = _mm256_i32gather_ps(points + 2, stride, 4);
+		const __m256 x = _mm256_i32gather_ps(normals, stride, 4);
+		const __m256 y = _mm256_i32gather_ps(normals + 1, stride, 4);
+		const __m256 z = _mm256_i32gather_ps(normals + 2, stride, 4);
+
+		shader.shade(depth, x, y, z, texturePtr + i);
+	}
+
+	return i;
+}
+
+// The same on the planes, which are read straight in
+AVX2_TARGET
+static size_t shade_planes_avx2(
+	const float* depth,
+	const float* const normals[3],
+	astra::RgbPixel* texturePtr,
+	size_t count,
+	const ShaderAvx2& shader)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		shader.shade(_mm256_loadu_ps(depth + i), _mm256_loadu_ps(normals[0] + i),
+			_mm256_loadu_ps(normals[1] + i), _mm256_loadu_ps(normals[2] + i), texturePtr + i);
+	}
+
+	return i;
+}
+
+// One component of a x b
+AVX2_TARGET
+static inline __m256 cross_component(__m256 ay, __m256 az, __m256 by, __m256 bz)
+{
+	return _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+}
+
+// The points around 8 pixels, a plane at a time
+struct NeighboursAvx2
+{
+	__m256 point[3], right[3], down[3], left[3], up[3];
+};
+
+// calculate_normal_plane_pixel() on 8 pixels, stored at 'i'
+AVX2_TARGET
+static inline void store_normals_avx2(const NeighboursAvx2& p, float* const n[3], size_t i)
+{
+	const __m256 zero = _mm256_setzero_ps();
+
+	// Only where the point and all four around it have depth
+	__m256 valid = _mm256_cmp_ps(p.point[2], zero, _CMP_NEQ_UQ);
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(p.right[2], zero, _CMP_NEQ_UQ));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(p.down[2], zero, _CMP_NEQ_UQ));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(p.left[2], zero, _CMP_NEQ_UQ));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(p.up[2], zero, _CMP_NEQ_UQ));
+
+	__m256 right[3], down[3], left[3], up[3];
+	for (int c = 0; c < 3; c++)
+	{
+		right[c] = _mm256_sub_ps(p.right[c], p.point[c]);
+		down[c] = _mm256_sub_ps(p.down[c], p.point[c]);
+		left[c] = _mm256_sub_ps(p.left[c], p.point[c]);
+		up[c] = _mm256_sub_ps(p.up[c], p.point[c]);
+	}
+
+	// vd x vr + vl x vd + vu x vl + vr x vu, a component at a time
+	__m256 x = _mm256_add_ps(_mm256_add_ps(cross_component(down[1], down[2], right[1], right[2]), cross_component(left[1], left[2], down[1], down[2])),
+		_mm256_add_ps(cross_component(up[1], up[2], left[1], left[2]), cross_component(right[1], right[2], up[1], up[2])));
+	__m256 y = _mm256_add_ps(_mm256_add_ps(cross_component(down[2], down[0], right[2], right[0]), cross_component(left[2], left[0], down[2], down[0])),
+		_mm256_add_ps(cross_component(up[2], up[0], left[2], left[0]), cross_component(right[2], right[0], up[2], up[0])));
+	__m256 z = _mm256_add_ps(_mm256_add_ps(cross_component(down[0], down[1], right[0], right[1]), cross_component(left[0], left[1], down[0], down[1])),
+		_mm256_add_ps(cross_component(up[0], up[1], left[0], left[1]), cross_component(right[0], right[1], up[0], up[1])));
+
+	ShaderAvx2::normalize(x, y, z, valid);
+
+	_mm256_storeu_ps(n[0] + i, x);
+	_mm256_storeu_ps(n[1] + i, y);
+	_mm256_storeu_ps(n[2] + i, z);
+}
+
+// The normals of the point planes 8 pixels at a time from 'begin', returning where it stopped
+AVX2_TARGET
+static size_t calculate_normal_planes_avx2(const float* const p[3], float* const n[3], size_t begin, size_t end, size_t width)
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		NeighboursAvx2 neighbours;
+		for (int c = 0; c < 3; c++)
+		{
+			neighbours.point[c] = _mm256_loadu_ps(p[c] + i);
+			neighbours.right[c] = _mm256_loadu_ps(p[c] + i + 1);
+			neighbours.down[c] = _mm256_loadu_ps(p[c] + i + width);
+			neighbours.left[c] = _mm256_loadu_ps(p[c] + i - 1);
+			neighbours.up[c] = _mm256_loadu_ps(p[c] + i - width);
+		}
+
+		store_normals_avx2(neighbours, n, i);
+	}
+
+	return i;
+}
+
+// The same from the depth plane of row 'row', each point the depth along the ray through its
+// pixel. The rays are rayX[column] across and rayY[row] up, with a z of one.
+AVX2_TARGET
+static size_t calculate_depth_normals_avx2(const float* depth, const float* rayX, const float* rayY, float* const n[3],
+	size_t begin, size_t end, size_t width, size_t row)
+{
+	const __m256 rayUp = _mm256_set1_ps(rayY[row - 1]);
+	const __m256 rayMid = _mm256_set1_ps(rayY[row]);
+	const __m256 rayDown = _mm256_set1_ps(rayY[row + 1]);
+	const size_t rowStart = row * width;
+
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const float* across = rayX + (i - rowStart);
+		const __m256 rayLeft = _mm256_loadu_ps(across - 1);
+		const __m256 rayCentre = _mm256_loadu_ps(across);
+		const __m256 rayRight = _mm256_loadu_ps(across + 1);
+
+		NeighboursAvx2 neighbours;
+		neighbours.point[2] = _mm256_loadu_ps(depth + i);
+		neighbours.right[2] = _mm256_loadu_ps(depth + i + 1);
+		neighbours.down[2] = _mm256_loadu_ps(depth + i + width);
+		neighbours.left[2] = _mm256_loadu_ps(depth + i - 1);
+		neighbours.up[2] = _mm256_loadu_ps(depth + i - width);
+
+		neighbours.point[0] = _mm256_mul_ps(neighbours.point[2], rayCentre);
+		neighbours.point[1] = _mm256_mul_ps(neighbours.point[2], rayMid);
+		neighbours.right[0] = _mm256_mul_ps(neighbours.right[2], rayRight);
+		neighbours.right[1] = _mm256_mul_ps(neighbours.right[2], rayMid);
+		neighbours.down[0] = _mm256_mul_ps(neighbours.down[2], rayCentre);
+		neighbours.down[1] = _mm256_mul_ps(neighbours.down[2], rayDown);
+		neighbours.left[0] = _mm256_mul_ps(neighbours.left[2], rayLeft);
+		neighbours.left[1] = _mm256_mul_ps(neighbours.left[2], rayMid);
+		neighbours.up[0] = _mm256_mul_ps(neighbours.up[2], rayCentre);
+		neighbours.up[1] = _mm256_mul_ps(neighbours.up[2], rayUp);
+
+		store_normals_avx2(neighbours, n, i);
+	}
+
+	return i;
+}
+
+// Depth in millimetres to floats, returning where it stopped
+AVX2_TARGET
+static size_t depth_to_plane_avx2(const int16_t* depth, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i values = _mm_loadu_si128((const __m128i*)(depth + i));
+		_mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(values)));
+	}
+	return i;
+}
+
+// out = a + b, returning where it stopped
+AVX2_TARGET
+static size_t add_planes_avx2(const float* a, const float* b, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+	return i;
+}
+
+// out[i] = in[i - 1] + in[i] + in[i + 1] from 'begin', returning where it stopped
+AVX2_TARGET
+static size_t sum_three_across_avx2(const float* in, float* out, size_t begin, size_t end)
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(in + i - 1), _mm256_loadu_ps(in + i)), _mm256_loadu_ps(in + i + 1));
+		_mm256_storeu_ps(out + i, sum);
+	}
+	return i;
+}
+
+// The normal output of the planes, 8 pixels at a time, converted to halves with F16C. Only
+// where there's depth and a normal, like store_normal_texel(). Returns where it stopped.
+F16C_TARGET
+static size_t write_normal_texels_avx2(const float* const planes[3], const float* depths, uint16_t* out, size_t count)
+{
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, out += 32)
+	{
+		__m256 x = _mm256_loadu_ps(planes[0] + i);
+		__m256 y = _mm256_loadu_ps(planes[1] + i);
+		__m256 z = _mm256_loadu_ps(planes[2] + i);
+		const __m256 depth = _mm256_loadu_ps(depths + i);
+
+		const __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(depth, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(length2, _mm256_set1_ps(1e-18f), _CMP_GE_OQ));
+		ShaderAvx2::normalize(x, y, z, valid);
+
+		const __m128i hx = _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT);
+		const __m128i hy = _mm256_cvtps_ph(y, _MM_FROUND_TO_NEAREST_INT);
+		const __m128i hz = _mm256_cvtps_ph(z, _MM_FROUND_TO_NEAREST_INT);
+		const __m128i hw = _mm256_cvtps_ph(_mm256_and_ps(depth, valid), _MM_FROUND_TO_NEAREST_INT);
+
+		// xy and zw pairs, then the pairs of pairs
+		const __m128i xyLow = _mm_unpacklo_epi16(hx, hy);
+		const __m128i xyHigh = _mm_unpackhi_epi16(hx, hy);
+		const __m128i zwLow = _mm_unpacklo_epi16(hz, hw);
+		const __m128i zwHigh = _mm_unpackhi_epi16(hz, hw);
+
+		_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(xyLow, zwLow));
+		_mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi32(xyLow, zwLow));
+		_mm_storeu_si128((__m128i*)(out + 16), _mm_unpacklo_epi32(xyHigh, zwHigh));
+		_mm_storeu_si128((__m128i*)(out + 24), _mm_unpackhi_epi32(xyHigh, zwHigh));
+	}
+
+	return i;
+}
+
+// The same folded onto the octahedron like fold_octahedral(), without branches
+F16C_TARGET
+static size_t write_octahedral_texels_avx2(const float* const planes[3], const float* depths, uint16_t* out, size_t count)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, out += 16)
+	{
+		const __m256 x = _mm256_loadu_ps(planes[0] + i);
+		const __m256 y = _mm256_loadu_ps(planes[1] + i);
+		const __m256 z = _mm256_loadu_ps(planes[2] + i);
+		const __m256 depth = _mm256_loadu_ps(depths + i);
+
+		const __m256 l1 = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signBit, x), _mm256_andnot_ps(signBit, y)), _mm256_andnot_ps(signBit, z));
+		const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(depth, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(l1, _mm256_set1_ps(1e-9f), _CMP_GE_OQ));
+
+		const __m256 scale = _mm256_div_ps(one, l1);
+		const __m256 ox = _mm256_mul_ps(x, scale);
+		const __m256 oy = _mm256_mul_ps(y, scale);
+
+		const __m256 foldedX = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signBit, oy)), _mm256_or_ps(_mm256_and_ps(signBit, ox), one));
+		const __m256 foldedY = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signBit, ox)), _mm256_or_ps(_mm256_and_ps(signBit, oy), one));
+		const __m256 fold = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+
+		const __m256 outX = _mm256_blendv_ps(_mm256_set1_ps(LitDepthVisualizer::OctTexelNone), _mm256_blendv_ps(ox, foldedX, fold), valid);
+		const __m256 outY = _mm256_and_ps(_mm256_blendv_ps(oy, foldedY, fold), valid);
+
+		const __m128i hx = _mm256_cvtps_ph(outX, _MM_FROUND_TO_NEAREST_INT);
+		const __m128i hy = _mm256_cvtps_ph(outY, _MM_FROUND_TO_NEAREST_INT);
+
+		_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(hx, hy));
+		_mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi16(hx, hy));
+	}
+
+	return i;
+}
+
+#endif
+
+// Every CPU with AVX2 so far has F16C too, but it's its own feature
+static bool has_f16c()
+{
+#ifdef SIMD_AVX2
+#ifdef _WIN32
+	static const bool f16c = []() {
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 29)) != 0;
+	}();
+#else // macOS
+	static const bool f16c = []() {
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C) != 0;
+	}();
+#endif
+	return f16c;
+#else
+	return false;
+#endif
+}
+
+bool LitDepthVisualizer::has_avx2()
+{
+#ifdef SIMD_AVX2
+#ifdef _WIN32
+	static const bool avx2 = []() {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// The OS has to save the AVX registers too
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+#else // macOS
+	// Checks the OS saves the AVX registers as well
+	static const bool avx2 = []() {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+	}();
+#endif
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+void LitDepthVisualizer::set_simd(bool s)
+{
+	simd = s;
+}
+
+size_t LitDepthVisualizer::shade_simd(const astra::Vector3f* pointData, const astra::Vector3f* normMap, astra::RgbPixel* texturePtr, size_t count) const
+{
+#ifdef SIMD_AVX2
+	if (uses_avx2())
+		return shade_avx2(pointData, normMap, texturePtr, count, ShaderAvx2(lightVector, lightColor, ambientColor));
+#endif
+	return 0;
+}
+
+astra::RgbPixel* LitDepthVisualizer::get_output() const { 
+	return outputBuffer; 
+}
+
+size_t LitDepthVisualizer::scratch_size(size_t width, size_t height) const
+{
+	if (normalSource == NORMALS_DEPTH)
+		return buffers_size(width, height, false, true);
+
+	return buffers_size(width, height, fused_rows(), false);
+}
+
+// Has to match what prepare_buffers() carves
+size_t LitDepthVisualizer::buffers_size(size_t width, size_t height, bool rows, bool depth) const
+{
+	const size_t numPixels = width * height;
+	const size_t output = this->output == OUTPUT_SHADED ? FrameArena::align(numPixels * sizeof(astra::RgbPixel)) :
+		FrameArena::align(numPixels * output_channels(this->output) * sizeof(uint16_t));
+	const size_t plane = FrameArena::align(numPixels * sizeof(float));
+
+	// The integral images in place of the unblurred normals
+	const size_t normals = estimator == ESTIMATE_INTEGRAL ?
+		FrameArena::align(6 * (width + 1) * (height + 1) * sizeof(double)) + FrameArena::align(numPixels * sizeof(uint16_t)) :
+		3 * plane;
+
+	if (depth)
+		return 4 * plane + normals + FrameArena::align(2 * width * sizeof(float)) +
+			FrameArena::align(width * sizeof(float)) + FrameArena::align(height * sizeof(float)) + output;
+
+	if (rows && blurMode == BLUR_BOX)
+		return FrameArena::align((2 * blurRadius + 1) * width * sizeof(astra::Vector3f)) +
+			FrameArena::align(2 * width * sizeof(astra::Vector3f)) + output;
+
+	if (rows)
+		return FrameArena::align((width + 1) * sizeof(astra::Vector3f)) +
+			FrameArena::align(3 * width * sizeof(astra::Vector3f)) + output;
+
+	if (buffer_layout() == LAYOUT_SOA)
+		return 6 * plane + normals + FrameArena::align(2 * width * sizeof(float)) + output;
+
+	const size_t sums = FrameArena::align(2 * width * sizeof(astra::Vector3f));
+
+	if (normalFormat == NORMAL_OCTAHEDRAL)
+		return 2 * FrameArena::align(numPixels * sizeof(OctNormal)) + sums + output;
+
+	return 2 * FrameArena::align(numPixels * sizeof(astra::Vector3f)) + sums + output;
+}
+
+void LitDepthVisualizer::set_arena(FrameArena* a)
+{
+	arena = a ? a : &ownArena;
+	arenaGeneration = 0;
+	outputBuffer = nullptr;
+	normalOutput = nullptr;
+}
+
+// A region of 'arena', clearing 'carved' if there wasn't one
+template<typename T>
+static T* carve(FrameArena* arena, bool& carved, size_t count)
+{
+	T* region = arena->allocate<T>(count);
+	if (!region)
+		carved = false;
+	return region;
+}
+
+bool LitDepthVisualizer::prepare_buffers(size_t width, size_t height, bool rows, bool depth)
+{
+	const bool sameRows = rows && blurMode == bufferBlurMode && (blurMode != BLUR_BOX || blurRadius == bufferBlurRadius);
+	const bool sameMaps = !rows && normalFormat == bufferFormat && buffer_layout() == bufferLayout;
+
+	if ((outputBuffer != nullptr || normalOutput != nullptr) && output == bufferOutput &&
+		width == outputWidth && height == outputHeight && rows == bufferRows && depth == bufferDepth && (sameRows || ((sameMaps || depth) && estimator == bufferEstimator)) &&
+		arenaGeneration == arena->getGeneration() && !arena->isStale())
+		return true;
+
+	// A shared arena is reset by its owner when the mode changes
+	if (arena == &ownArena)
+		ownArena.reset(buffers_size(width, height, rows, depth));
+
+	const size_t numPixels = width * height;
+
+	normalMap = nullptr;
+	blurNormalMap = nullptr;
+	normalMapOct = nullptr;
+	blurNormalMapOct = nullptr;
+	blurRows = nullptr;
+	normalRow = nullptr;
+	planeRows = nullptr;
+	rayX = nullptr;
+	rayY = nullptr;
+	silhouetteDistance = nullptr;
+	for (int c = 0; c < 3; c++)
+	{
+		pointPlanes[c] = nullptr;
+		normalPlanes[c] = nullptr;
+		blurPlanes[c] = nullptr;
+	}
+	gradientSums = nullptr;
+
+	const bool integral = !rows && estimator == ESTIMATE_INTEGRAL;
+	bool carved = true;
+
+	if (depth){
+		// Only the depth of the points is kept, and the rays they're along
+		pointPlanes[2] = carve<float>(arena, carved, numPixels);
+		for (int c = 0; c < 3; c++)
+		{
+			if (!integral)
+				normalPlanes[c] = carve<float>(arena, carved, numPixels);
+			blurPlanes[c] = carve<float>(arena, carved, numPixels);
+		}
+		planeRows = carve<float>(arena, carved, 2 * width);
+		rayX = carve<float>(arena, carved, width);
+		rayY = carve<float>(arena, carved, height);
+	}
+	else if (rows && blurMode == BLUR_BOX){
+		// The rows of normals the box covers, and the column and box sums
+		normalRow = carve<astra::Vector3f>(arena, carved, (2 * blurRadius + 1) * width);
+		blurRows = carve<astra::Vector3f>(arena, carved, 2 * width);
+	}
+	else if (rows){
+		// A row of normals, after the last one of the row above, and three rows of sums
+		normalRow = carve<astra::Vector3f>(arena, carved, width + 1);
+		blurRows = carve<astra::Vector3f>(arena, carved, 3 * width);
+	}
+	else if (buffer_layout() == LAYOUT_SOA){
+		for (int c = 0; c < 3; c++)
+		{
+			pointPlanes[c] = carve<float>(arena, carved, numPixels);
+			if (!integral)
+				normalPlanes[c] = carve<float>(arena, carved, numPixels);
+			blurPlanes[c] = carve<float>(arena, carved, numPixels);
+		}
+		planeRows = carve<float>(arena, carved, 2 * width);
+	}
+	else if (normalFormat == NORMAL_OCTAHEDRAL){
+		normalMapOct = carve<OctNormal>(arena, carved, numPixels);
+		blurNormalMapOct = carve<OctNormal>(arena, carved, numPixels);
+		blurRows = carve<astra::Vector3f>(arena, carved, 2 * width);
+	}
+	else{
+		normalMap = carve<astra::Vector3f>(arena, carved, numPixels);
+		blurNormalMap = carve<astra::Vector3f>(arena, carved, numPixels);
+		blurRows = carve<astra::Vector3f>(arena, carved, 2 * width);
+
+		if (blurNormalMap)
+			std::fill(blurNormalMap, blurNormalMap + numPixels, astra::Vector3f::zero());
+	}
+
+	if (integral){
+		gradientSums = carve<double>(arena, carved, 6 * (width + 1) * (height + 1));
+		silhouetteDistance = carve<uint16_t>(arena, carved, numPixels);
+	}
+
+	outputBuffer = nullptr;
+	normalOutput = nullptr;
+	if (output == OUTPUT_SHADED)
+		outputBuffer = carve<astra::RgbPixel>(arena, carved, numPixels);
+	else
+		normalOutput = carve<uint16_t>(arena, carved, numPixels * output_channels(output));
+
+	// Nothing is written this frame, and the next one tries again
+	if (!carved){
+		outputBuffer = nullptr;
+		normalOutput = nullptr;
+		arenaGeneration = 0;
+		return false;
+	}
+
+	bufferOutput = output;
+	bufferFormat = normalFormat;
+	bufferLayout = rows ? layout : buffer_layout();
+	bufferEstimator = integral ? ESTIMATE_INTEGRAL : ESTIMATE_CROSS;
+	bufferRows = rows;
+	bufferDepth = depth;
+	bufferBlurMode = blurMode;
+	bufferBlurRadius = blurRadius;
+	arenaGeneration = arena->getGeneration();
+	outputWidth = width;
+	outputHeight = height;
+	return true;
+}
+
+bool LitDepthVisualizer::prepare_buffer(size_t width, size_t height)
+{
+	if (!prepare_buffers(width, height))
+		return false;
+
+	std::fill(outputBuffer, outputBuffer + outputWidth * outputHeight, astra::RgbPixel(0, 0, 0));
+	return true;
+}
+
+// The unblurred normals of row y, zero where a pixel or one of its neighbours has no depth
+// and all round the edge of the frame
+template<typename Normal>
+static void calculate_normal_row(const astra::Vector3f* positionMap, int width, int height, int y, Normal* normMap)
+{
+	const int maxY = height - 1;
+	const int maxX = width - 1;
+
+	//top and bottom rows
+	if (y == 0 || y >= maxY)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			store_normal(*normMap, astra::Vector3f::zero());
+			++normMap;
+		}
+		return;
+	}
+
+	//first pixel at start of row
+	store_normal(*normMap, astra::Vector3f::zero());
+	++normMap;
+
+	//Initialize pointer arithmetic for the x=0 position
+	const astra::Vector3f* p_point = positionMap + y * width;
+	const astra::Vector3f* p_pointLeft = p_point - 1;
+	const astra::Vector3f* p_pointRight = p_point + 1;
+	const astra::Vector3f* p_pointUp = p_point - width;
+	const astra::Vector3f* p_pointDown = p_point + width;
+
+	for (int x = 1; x < maxX; ++x)
+	{
+		++p_pointLeft;
+		++p_point;
+		++p_pointRight;
+		++p_pointUp;
+		++p_pointDown;
+
+		const astra::Vector3f& point = *p_point;
+		const astra::Vector3f& pointLeft = *p_pointLeft;
+		const astra::Vector3f& pointRight = *p_pointRight;
+		const astra::Vector3f& pointUp = *p_pointUp;
+		const astra::Vector3f& pointDown = *p_pointDown;
+
+		if (point.z != 0 &&
+			pointRight.z != 0 &&
+			pointDown.z != 0 &&
+			pointLeft.z != 0 &&
+			pointUp.z != 0
+			)
+		{
+			astra::Vector3f vr = pointRight - point;
+			astra::Vector3f vd = pointDown - point;
+			astra::Vector3f vl = pointLeft - point;
+			astra::Vector3f vu = pointUp - point;
+
+			astra::Vector3f normAvg = vd.cross(vr);
+			normAvg += vl.cross(vd);
+			normAvg += vu.cross(vl);
+			normAvg += vr.cross(vu);
+
+			store_normal(*normMap, normAvg);
+
+		}
+		else
+		{
+			store_normal(*normMap, astra::Vector3f::zero());
+		}
+
+		++normMap;
+	}
+
+	//last pixel at end of row
+	store_normal(*normMap, astra::Vector3f::zero());
+}
+
+template<typename Normal>
+static void calculate_normal_map(const astra::Vector3f* positionMap, int width, int height, Normal* normMap)
+{
+	for (int y = 0; y < height; ++y, normMap += width)
+		calculate_normal_row(positionMap, width, height, y, normMap);
+}
+
+// The sums of three normals across that box_blur_fast() makes of a row, added up in the same
+// order so they come out exactly the same. in_row[-1] is the last normal of the row above,
+// so the sum for column x is of x - 1, x and x + 1. The last column's is zero.
+static void sum_across(const astra::Vector3f* in_row, astra::Vector3f* sums, const size_t width)
+{
+	const astra::Vector3f* in_left = in_row - 1;
+	const astra::Vector3f* in_mid = in_row + 1;
+
+	astra::Vector3f xKernelTotal = *in_left + *in_row;
+
+	for (size_t x = 1; x < width; ++x){
+		xKernelTotal += *in_mid;
+
+		sums[x - 1] = xKernelTotal;
+
+		xKernelTotal -= *in_left;
+
+		++in_left;
+		++in_mid;
+	}
+
+	sums[width - 1] = astra::Vector3f::zero();
+}
+
+void LitDepthVisualizer::update_fused(const astra::Vector3f* pointData, size_t width, size_t height)
+{
+	if (!prepare_buffers(width, height, true) || width == 0)
+		return;
+
+	if (blurMode == BLUR_BOX)
+	{
+		update_fused_box(pointData, width, height);
+		return;
+	}
+
+	// Blurred row y is the sums across of normal rows y and y + 1, like box_blur_fast(). The
+	// top row of normals is all zero, as is the last normal of every row that normalRow[0]
+	// stands in for.
+	astra::Vector3f* normals = normalRow + 1;
+	astra::Vector3f* sums = blurRows;
+	astra::Vector3f* sumsBelow = blurRows + width;
+	astra::Vector3f* blurred = blurRows + 2 * width;
+
+	normalRow[0] = astra::Vector3f::zero();
+	std::fill(sums, sums + width, astra::Vector3f::zero());
+
+	for (size_t y = 0; y < height; ++y)
+	{
+		if (y + 1 < height)
+		{
+			calculate_normal_row(pointData, int(width), int(height), int(y + 1), normals);
+			sum_across(normals, sumsBelow, width);
+		}
+		else
+		{
+			std::fill(sumsBelow, sumsBelow + width, astra::Vector3f::zero());
+		}
+
+		for (size_t x = 0; x < width; ++x)
+			blurred[x] = sums[x] + sumsBelow[x];
+
+		const size_t offset = y * width;
+		shade(pointData + offset, blurred, outputBuffer + offset, width, 1);
+
+		std::swap(sums, sumsBelow);
+	}
+}
+
+// The same blur as box_blur_separable() on the float normals, keeping just the rows of normals
+// the box covers in a ring, row k in ring slot k % (2 * radius + 1)
+void LitDepthVisualizer::update_fused_box(const astra::Vector3f* pointData, size_t width, size_t height)
+{
+	const size_t r = blurRadius;
+	const size_t ringRows = 2 * r + 1;
+	astra::Vector3f* columns = blurRows;
+	astra::Vector3f* sums = blurRows + width;
+
+	auto ringRow = [&](size_t y){ return normalRow + (y % ringRows) * width; };
+
+	std::fill(columns, columns + width, astra::Vector3f::zero());
+
+	for (size_t y = 0; y < r && y < height; ++y)
+	{
+		calculate_normal_row(pointData, int(width), int(height), int(y), ringRow(y));
+		add_row(ringRow(y), columns, width);
+	}
+
+	for (size_t y = 0; y < height; ++y)
+	{
+		// Row y - r - 1 is in the slot row y + r goes in
+		if (y > r)
+			subtract_row(ringRow(y - r - 1), columns, width);
+
+		if (y + r < height)
+		{
+			calculate_normal_row(pointData, int(width), int(height), int(y + r), ringRow(y + r));
+			add_row(ringRow(y + r), columns, width);
+		}
+
+		sum_box_across(columns, sums, width, r);
+
+		const size_t offset = y * width;
+		shade(pointData + offset, sums, outputBuffer + offset, width, 1);
+	}
+}
+
+// calculate_normal_row() for one pixel of the planes, which isn't on the edge of the frame,
+// stored at 'i'
+static inline void store_normal_plane_pixel(
+	const astra::Vector3f& point,
+	const astra::Vector3f& pointRight,
+	const astra::Vector3f& pointDown,
+	const astra::Vector3f& pointLeft,
+	const astra::Vector3f& pointUp,
+	float* const n[3],
+	size_t i)
+{
+	astra::Vector3f normal = astra::Vector3f::zero();
+
+	if (point.z != 0 && pointRight.z != 0 && pointDown.z != 0 && pointLeft.z != 0 && pointUp.z != 0)
+	{
+		const astra::Vector3f vr = pointRight - point;
+		const astra::Vector3f vd = pointDown - point;
+		const astra::Vector3f vl = pointLeft - point;
+		const astra::Vector3f vu = pointUp - point;
+
+		normal = vd.cross(vr);
+		normal += vl.cross(vd);
+		normal += vu.cross(vl);
+		normal += vr.cross(vu);
+
+		const float length2 = normal.dot(normal);
+		normal = normal * (length2 >= 1e-18f ? 1.0f / std::sqrt(length2) : 0.0f);
+	}
+
+	n[0][i] = normal.x;
+	n[1][i] = normal.y;
+	n[2][i] = normal.z;
+}
+
+static inline void calculate_normal_plane_pixel(const float* const p[3], float* const n[3], size_t i, size_t width)
+{
+	store_normal_plane_pixel(
+		astra::Vector3f(p[0][i], p[1][i], p[2][i]),
+		astra::Vector3f(p[0][i + 1], p[1][i + 1], p[2][i + 1]),
+		astra::Vector3f(p[0][i + width], p[1][i + width], p[2][i + width]),
+		astra::Vector3f(p[0][i - 1], p[1][i - 1], p[2][i - 1]),
+		astra::Vector3f(p[0][i - width], p[1][i - width], p[2][i - width]),
+		n, i);
+}
+
+// The same from the depth plane, see calculate_depth_normals_avx2()
+static inline void calculate_depth_normal_pixel(const float* depth, const float* rayX, const float* rayY, float* const n[3],
+	size_t i, size_t width, size_t x, size_t y)
+{
+	const float d = depth[i];
+	const float right = depth[i + 1];
+	const float down = depth[i + width];
+	const float left = depth[i - 1];
+	const float up = depth[i - width];
+
+	store_normal_plane_pixel(
+		astra::Vector3f(d * rayX[x], d * rayY[y], d),
+		astra::Vector3f(right * rayX[x + 1], right * rayY[y], right),
+		astra::Vector3f(down * rayX[x], down * rayY[y + 1], down),
+		astra::Vector3f(left * rayX[x - 1], left * rayY[y], left),
+		astra::Vector3f(up * rayX[x], up * rayY[y - 1], up),
+		n, i);
+}
+
+// box_blur_fast() on one plane: output row y is the sums of three across of input rows y and
+// y + 1, with the last column left empty. The normals all round the edge of the frame are
+// zero, so the sums can be made down the columns first and don't have to leave row 0 out.
+static void blur_plane_fast(const float* in, float* out, size_t width, size_t height, float* rowSums, bool avx2)
+{
+	if (width < 3)
+	{
+		std::fill(out, out + width * height, 0.0f);
+		return;
+	}
+
+	for (size_t y = 0; y < height; ++y)
+	{
+		const float* in_row = in + y * width;
+		float* out_row = out + y * width;
+
+		size_t x = 0;
+		if (y + 1 < height)
+		{
+#ifdef SIMD_AVX2
+			if (avx2)
+				x = add_planes_avx2(in_row, in_row + width, rowSums, width);
+#endif
+			for (; x < width; ++x)
+				rowSums[x] = in_row[x] + in_row[x + width];
+		}
+		else
+		{
+			std::copy(in_row, in_row + width, rowSums);
+		}
+
+		out_row[0] = rowSums[0] + rowSums[1];
+
+		x = 1;
+#ifdef SIMD_AVX2
+		if (avx2)
+			x = sum_three_across_avx2(rowSums, out_row, 1, width - 1);
+#endif
+		for (; x < width - 1; ++x)
+			out_row[x] = rowSums[x - 1] + rowSums[x] + rowSums[x + 1];
+
+		out_row[width - 1] = 0.0f;
+	}
+}
+
+void LitDepthVisualizer::calculate_normal_planes(const astra::Vector3f* positionMap, size_t width, size_t height)
+{
+	const size_t numPixels = width * height;
+
+	// The only pass over the interleaved points
+	for (size_t i = 0; i < numPixels; ++i)
+	{
+		pointPlanes[0][i] = positionMap[i].x;
+		pointPlanes[1][i] = positionMap[i].y;
+		pointPlanes[2][i] = positionMap[i].z;
+	}
+
+	calculate_plane_normals(width, height, false);
+}
+
+void LitDepthVisualizer::calculate_depth_normals(const int16_t* depthData, size_t width, size_t height)
+{
+	const size_t numPixels = width * height;
+	float* depth = pointPlanes[2];
+
+	size_t i = 0;
+#ifdef SIMD_AVX2
+	if (uses_avx2())
+		i = depth_to_plane_avx2(depthData, depth, numPixels);
+#endif
+	for (; i < numPixels; ++i)
+		depth[i] = float(depthData[i]);
+
+	calculate_plane_normals(width, height, true);
+}
+
+// The cross product normals of the planes, zero all round their edge. From the depth plane
+// alone when 'fromDepth', with the rays through the planes' columns and rows.
+static void cross_normal_planes(const float* const points[3], const float* rayX, const float* rayY, float* const normalPlanes[3],
+	size_t width, size_t height, bool fromDepth, bool avx2)
+{
+	for (size_t y = 0; y < height; ++y)
+	{
+		const size_t row = y * width;
+
+		// Top and bottom rows
+		if (y == 0 || y + 1 >= height || width < 3)
+		{
+			for (int c = 0; c < 3; c++)
+				std::fill(normalPlanes[c] + row, normalPlanes[c] + row + width, 0.0f);
+			continue;
+		}
+
+		// First and last pixels of the row
+		for (int c = 0; c < 3; c++)
+		{
+			normalPlanes[c][row] = 0.0f;
+			normalPlanes[c][row + width - 1] = 0.0f;
+		}
+
+		size_t i = row + 1;
+		const size_t end = row + width - 1;
+
+		if (fromDepth)
+		{
+#ifdef SIMD_AVX2
+			if (avx2)
+				i = calculate_depth_normals_avx2(points[2], rayX, rayY, normalPlanes, i, end, width, y);
+#endif
+			for (; i < end; ++i)
+				calculate_depth_normal_pixel(points[2], rayX, rayY, normalPlanes, i, width, i - row, y);
+			continue;
+		}
+
+#ifdef SIMD_AVX2
+		if (avx2)
+			i = calculate_normal_planes_avx2(points, normalPlanes, i, end, width);
+#endif
+		for (; i < end; ++i)
+			calculate_normal_plane_pixel(points, normalPlanes, i, width);
+	}
+}
+
+static void blur_normal_planes(const float* const normalPlanes[3], float* const blurPlanes[3], size_t width, size_t height,
+	LitDepthVisualizer::BlurMode mode, unsigned int radius, float* rows, bool avx2)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		if (mode == LitDepthVisualizer::BLUR_BOX)
+			box_blur_columns(normalPlanes[c], blurPlanes[c], width, height, int(radius), rows);
+		else
+			blur_plane_fast(normalPlanes[c], blurPlanes[c], width, height, rows, avx2);
+	}
+}
+
+void LitDepthVisualizer::calculate_plane_normals(size_t width, size_t height, bool fromDepth)
+{
+	if (bufferEstimator == ESTIMATE_INTEGRAL)
+	{
+		calculate_integral_normals(width, height, fromDepth);
+		return;
+	}
+
+	const bool avx2 = uses_avx2();
+
+	cross_normal_planes(pointPlanes, rayX, rayY, normalPlanes, width, height, fromDepth, avx2);
+	blur_normal_planes(normalPlanes, blurPlanes, width, height, blurMode, blurRadius, planeRows, avx2);
+}
+
+// The points ESTIMATE_INTEGRAL works on, from the planes of LAYOUT_SOA
+struct PlanePoints
+{
+	const float* const* planes;
+	size_t width;
+
+	float depth(size_t x, size_t y) const { return planes[2][y * width + x]; }
+	astra::Vector3f point(size_t x, size_t y) const
+	{
+		const size_t i = y * width + x;
+		return astra::Vector3f(planes[0][i], planes[1][i], planes[2][i]);
+	}
+};
+
+// Or from the depth and the rays through each column and row, for update_depth()
+struct RayPoints
+{
+	const float* depths;
+	const float* rayX;
+	const float* rayY;
+	size_t width;
+
+	float depth(size_t x, size_t y) const { return depths[y * width + x]; }
+	astra::Vector3f point(size_t x, size_t y) const
+	{
+		const float d = depths[y * width + x];
+		return astra::Vector3f(d * rayX[x], d * rayY[y], d);
+	}
+};
+
+// Whether a pixel has no depth, is on the edge of the frame, or the depth of one of its
+// neighbours is too far from its own
+template<typename Points>
+static inline bool is_silhouette(const Points& points, size_t x, size_t y, size_t width, size_t height, float threshold)
+{
+	if (x == 0 || y == 0 || x + 1 >= width || y + 1 >= height)
+		return true;
+
+	const float d = points.depth(x, y);
+	const float limit = threshold * d;
+	const float neighbours[4] = { points.depth(x + 1, y), points.depth(x - 1, y), points.depth(x, y + 1), points.depth(x, y - 1) };
+
+	if (d == 0)
+		return true;
+
+	for (float n : neighbours)
+	{
+		if (n == 0 || std::abs(n - d) > limit)
+			return true;
+	}
+
+	return false;
+}
+
+// The integral images are of doubles, a frame's worth of gradients summed as floats would
+// leave too few bits for the difference between two of the sums
+template<typename Points>
+static void integral_normals(const Points& points, size_t width, size_t height, unsigned int window, float threshold,
+	double* sums, uint16_t* distance, float* const out[3])
+{
+	const size_t stride = 6 * (width + 1);
+	// An even window is the odd one below it, so it's still centred
+	const unsigned int radius = (window - 1) / 2;
+	// Only whether a pixel is further than the window from a silhouette matters
+	const uint16_t far = uint16_t(std::min(radius + 1, 0xFFFFu));
+
+	std::fill(sums, sums + stride, 0.0);
+
+	// Down the frame, summing the gradients and the chessboard distance to the silhouettes
+	// above and to the left
+	for (size_t y = 0; y < height; ++y)
+	{
+		double rowSums[6] = {};
+		double* row = sums + (y + 1) * stride;
+
+		std::fill(row, row + 6, 0.0);
+
+		for (size_t x = 0; x < width; ++x)
+		{
+			uint16_t& d = distance[y * width + x];
+
+			if (is_silhouette(points, x, y, width, height, threshold))
+			{
+				d = 0;
+			}
+			else
+			{
+				const astra::Vector3f horizontal = points.point(x + 1, y) - points.point(x - 1, y);
+				const astra::Vector3f vertical = points.point(x, y + 1) - points.point(x, y - 1);
+
+				rowSums[0] += horizontal.x;
+				rowSums[1] += horizontal.y;
+				rowSums[2] += horizontal.z;
+				rowSums[3] += vertical.x;
+				rowSums[4] += vertical.y;
+				rowSums[5] += vertical.z;
+
+				// Not on the edge, so all of these are in the frame
+				const uint16_t* near = distance + y * width + x;
+				const uint16_t nearest = std::min(std::min(near[-1], near[-int(width) - 1]), std::min(near[-int(width)], near[-int(width) + 1]));
+				d = std::min(uint16_t(nearest + 1), far);
+			}
+
+			double* sum = row + 6 * (x + 1);
+			for (int c = 0; c < 6; c++)
+				sum[c] = sum[c - stride] + rowSums[c];
+		}
+	}
+
+	// Back up it, finishing the distances with the silhouettes below and to the right, and
+	// summing the window that fits inside them
+	for (size_t y = height; y-- > 0;)
+	{
+		for (size_t x = width; x-- > 0;)
+		{
+			uint16_t& d = distance[y * width + x];
+			const size_t o = y * width + x;
+
+			if (d != 0)
+			{
+				const uint16_t* near = distance + o;
+				const uint16_t nearest = std::min(std::min(near[1], near[width + 1]), std::min(near[width], near[width - 1]));
+				d = std::min(d, uint16_t(nearest + 1));
+			}
+
+			if (d == 0)
+			{
+				for (int c = 0; c < 3; c++)
+					out[c][o] = 0.0f;
+				continue;
+			}
+
+			const size_t r = std::min(size_t(radius), size_t(d - 1));
+			const double* top = sums + (y - r) * stride;
+			const double* bottom = sums + (y + r + 1) * stride;
+			const size_t left = 6 * (x - r);
+			const size_t right = 6 * (x + r + 1);
+
+			double g[6];
+			for (int c = 0; c < 6; c++)
+				g[c] = bottom[right + c] - top[right + c] - bottom[left + c] + top[left + c];
+
+			// vertical x horizontal, which points the same way as the cross products
+			out[0][o] = float(g[4] * g[2] - g[5] * g[1]);
+			out[1][o] = float(g[5] * g[0] - g[3] * g[2]);
+			out[2][o] = float(g[3] * g[1] - g[4] * g[0]);
+		}
+	}
+}
+
+size_t LitDepthVisualizer::tile_halo() const
+{
+	return blurMode == BLUR_BOX ? blurRadius : 1;
+}
+
+// The depth, the normals and the blurred normals of the tile and its halo, and a couple of
+// rows of sums for the blur
+size_t LitDepthVisualizer::tile_scratch_size(size_t tileWidth, size_t tileHeight) const
+{
+	const size_t reach = tile_halo() + 1;
+	const size_t width = tileWidth + 2 * reach;
+	const size_t height = tileHeight + 2 * reach;
+	return (7 * width * height + 2 * width) * sizeof(float);
+}
+
+void LitDepthVisualizer::shade_depth_tile(const int16_t* depthData, size_t width, size_t height, const float* columnRays, const float* rowRays,
+	size_t tileX, size_t tileY, size_t tileWidth, size_t tileHeight, float* scratch, astra::RgbPixel* texturePtr) const
+{
+	// As far as the blur reaches, and the one more the normals reach past that, in the frame
+	const size_t reach = tile_halo() + 1;
+	const size_t left = tileX > reach ? tileX - reach : 0;
+	const size_t top = tileY > reach ? tileY - reach : 0;
+	const size_t right = std::min(width, tileX + tileWidth + reach);
+	const size_t bottom = std::min(height, tileY + tileHeight + reach);
+
+	const size_t haloWidth = right - left;
+	const size_t haloHeight = bottom - top;
+	const size_t numPixels = haloWidth * haloHeight;
+
+	float* const depth = scratch;
+	float* const normals[3] = { scratch + numPixels, scratch + 2 * numPixels, scratch + 3 * numPixels };
+	float* const blurred[3] = { scratch + 4 * numPixels, scratch + 5 * numPixels, scratch + 6 * numPixels };
+	float* const rows = scratch + 7 * numPixels;
+
+	const bool avx2 = uses_avx2();
+
+	for (size_t y = 0; y < haloHeight; ++y)
+	{
+		const int16_t* in = depthData + (top + y) * width + left;
+		float* out = depth + y * haloWidth;
+
+		size_t x = 0;
+#ifdef SIMD_AVX2
+		if (avx2)
+			x = depth_to_plane_avx2(in, out, haloWidth);
+#endif
+		for (; x < haloWidth; ++x)
+			out[x] = float(in[x]);
+	}
+
+	// The edge of the halo is only zeroed like the edge of the frame where it is the edge of
+	// the frame, everywhere else it's past what the tile's pixels reach
+	const float* const points[3] = { nullptr, nullptr, depth };
+	cross_normal_planes(points, columnRays + left, rowRays + top, normals, haloWidth, haloHeight, true, avx2);
+	blur_normal_planes(normals, blurred, haloWidth, haloHeight, blurMode, blurRadius, rows, avx2);
+
+#ifdef SIMD_AVX2
+	const ShaderAvx2 shader(lightVector, lightColor, ambientColor);
+#endif
+
+	for (size_t y = 0; y < tileHeight; ++y)
+	{
+		const size_t o = (tileY + y - top) * haloWidth + (tileX - left);
+		const float* const sums[3] = { blurred[0] + o, blurred[1] + o, blurred[2] + o };
+		astra::RgbPixel* out = texturePtr + y * tileWidth;
+
+		size_t x = 0;
+#ifdef SIMD_AVX2
+		if (avx2)
+			x = shade_planes_avx2(depth + o, sums, out, tileWidth, shader);
+#endif
+		for (; x < tileWidth; ++x)
+		{
+			const astra::Vector3f sum(sums[0][x], sums[1][x], sums[2][x]);
+			shade_pixel(depth[o + x], astra::Vector3f::normalize(sum), out[x]);
+		}
+	}
+}
+
+void LitDepthVisualizer::calculate_integral_normals(size_t width, size_t height, bool fromDepth)
+{
+	if (fromDepth)
+		integral_normals(RayPoints{ pointPlanes[2], rayX, rayY, width }, width, height, integralWindow,
+			depthChangeThreshold, gradientSums, silhouetteDistance, blurPlanes);
+	else
+		integral_normals(PlanePoints{ pointPlanes, width }, width, height, integralWindow,
+			depthChangeThreshold, gradientSums, silhouetteDistance, blurPlanes);
+}
+
+void LitDepthVisualizer::shade_planes(astra::RgbPixel* texturePtr, size_t count)
+{
+	size_t i = 0;
+#ifdef SIMD_AVX2
+	if (uses_avx2())
+		i = shade_planes_avx2(pointPlanes[2], blurPlanes, texturePtr, count, ShaderAvx2(lightVector, lightColor, ambientColor));
+#endif
+
+	for (; i < count; ++i)
+	{
+		const astra::Vector3f sum(blurPlanes[0][i], blurPlanes[1][i], blurPlanes[2][i]);
+		shade_pixel(pointPlanes[2][i], astra::Vector3f::normalize(sum), texturePtr[i]);
+	}
+}
+
+// The normals write_normals() reads, and the depth the shading would have masked them with
+template<typename Normal>
+struct MapNormals
+{
+	const Normal* normals;
+	const astra::Vector3f* points;
+
+	Normal normal(size_t i) const { return normals[i]; }
+	float depth(size_t i) const { return points[i].z; }
+};
+
+struct PlaneNormals
+{
+	const float* const* planes;
+	const float* depths;
+
+	astra::Vector3f normal(size_t i) const { return astra::Vector3f(planes[0][i], planes[1][i], planes[2][i]); }
+	float depth(size_t i) const { return depths[i]; }
+};
+
+// Only where the shading would have lit the pixel, which is where it has depth
+static inline void store_normal_texel(uint16_t* out, const astra::Vector3f& normal, float depth)
+{
+	const bool none = depth == 0.0f || (normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f);
+
+	out[0] = FramePacker::toHalf(none ? 0.0f : normal.x);
+	out[1] = FramePacker::toHalf(none ? 0.0f : normal.y);
+	out[2] = FramePacker::toHalf(none ? 0.0f : normal.z);
+	out[3] = FramePacker::toHalf(none ? 0.0f : depth);
+}
+
+// A blurred sum, which doesn't have to be unit length to be folded
+static inline void store_octahedral_texel(uint16_t* out, const astra::Vector3f& normal, float depth)
+{
+	float x = 0.0f;
+	float y = 0.0f;
+	const bool none = !fold_octahedral(normal, x, y) || depth == 0.0f;
+
+	out[0] = FramePacker::toHalf(none ? LitDepthVisualizer::OctTexelNone : x);
+	out[1] = FramePacker::toHalf(none ? 0.0f : y);
+}
+
+// Already on the octahedron, so it's only scaled
+static inline void store_octahedral_texel(uint16_t* out, const LitDepthVisualizer::OctNormal& normal, float depth)
+{
+	const bool none = normal.x == LitDepthVisualizer::OctNormalNone || depth == 0.0f;
+
+	out[0] = FramePacker::toHalf(none ? LitDepthVisualizer::OctTexelNone : normal.x * (1.0f / 32767.0f));
+	out[1] = FramePacker::toHalf(none ? 0.0f : normal.y * (1.0f / 32767.0f));
+}
+
+// From pixel 'begin', the ones before it were written by the vector kernel
+template<typename Normals>
+static void write_normal_texels(const Normals& normals, uint16_t* out, size_t begin, size_t count, LitDepthVisualizer::Output output)
+{
+	if (output == LitDepthVisualizer::OUTPUT_NORMALS_RG16F)
+	{
+		out += begin * 2;
+		for (size_t i = begin; i < count; ++i, out += 2)
+			store_octahedral_texel(out, normals.normal(i), normals.depth(i));
+	}
+	else
+	{
+		out += begin * 4;
+		for (size_t i = begin; i < count; ++i, out += 4)
+			store_normal_texel(out, shading_normal(normals.normal(i)), normals.depth(i));
+	}
+}
+
+void LitDepthVisualizer::write_normals(const astra::Vector3f* pointData, size_t count)
+{
+	if (bufferLayout == LAYOUT_SOA || bufferDepth)
+	{
+		size_t i = 0;
+#ifdef SIMD_AVX2
+		if (uses_avx2() && has_f16c())
+			i = output == OUTPUT_NORMALS_RG16F ? write_octahedral_texels_avx2(blurPlanes, pointPlanes[2], normalOutput, count) :
+				write_normal_texels_avx2(blurPlanes, pointPlanes[2], normalOutput, count);
+#endif
+		write_normal_texels(PlaneNormals{ blurPlanes, pointPlanes[2] }, normalOutput, i, count, output);
+	}
+	else if (bufferFormat == NORMAL_OCTAHEDRAL)
+		write_normal_texels(MapNormals<OctNormal>{ blurNormalMapOct, pointData }, normalOutput, 0, count, output);
+	else
+		write_normal_texels(MapNormals<astra::Vector3f>{ blurNormalMap, pointData }, normalOutput, 0, count, output);
+}
+
+bool LitDepthVisualizer::calculate_normals(const astra::Vector3f* positionMap, int width, int height)
+{
+	if (!prepare_buffers(width, height))
+		return false;
+
+	if (bufferLayout == LAYOUT_SOA)
+	{
+		calculate_normal_planes(positionMap, width, height);
+		return true;
+	}
+
+	if (bufferFormat == NORMAL_OCTAHEDRAL)
+	{
+		calculate_normal_map(positionMap, width, height, normalMapOct);
+
+		if (blurMode == BLUR_BOX)
+			LitDepthVisualizer::box_blur_separable(normalMapOct, blurNormalMapOct, width, height, blurRadius, blurRows);
+		else
+			LitDepthVisualizer::box_blur_octahedral(normalMapOct, blurNormalMapOct, width, height, blurRows);
+		return true;
+	}
+
+	calculate_normal_map(positionMap, width, height, normalMap);
+
+	if (blurMode == BLUR_BOX)
+		LitDepthVisualizer::box_blur_separable(normalMap, blurNormalMap, width, height, blurRadius, blurRows);
+	else
+		LitDepthVisualizer::box_blur_fast(normalMap, blurNormalMap, width, height);
+	return true;
 }
\ No newline at end of file
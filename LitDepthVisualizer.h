@@ -1,73 +1,335 @@
-// This file is part of the Orbbec Astra SDK [https://orbbec3d.com]
-// Copyright (c) 2015-2017 Orbbec 3D
-//
-// Licensed under the Apache License, Version 2.0 (the "License");
-// you may not use this file except in compliance with the License.
-// You may obtain a copy of the License at
-//
-// http://www.apache.org/licenses/LICENSE-2.0
-//
-// Unless required by applicable law or agreed to in writing, software
-// distributed under the License is distributed on an "AS IS" BASIS,
-// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-// See the License for the specific language governing permissions and
-// limitations under the License.
-//
-// Be excellent to each other.
-#ifndef LITDEPTHVISUALIZER_H
-#define LITDEPTHVISUALIZER_H
-
-#include <astra/astra.hpp>
-#include <cstring>
-#include <algorithm>
-
-class LitDepthVisualizer
-{
-public:
-
-	static void box_blur(
-		const astra::Vector3f* in,
-		astra::Vector3f* out,
-		const size_t width,
-		const size_t height,
-		const int blurRadius = 1);
-
-	static void box_blur_fast(
-		const astra::Vector3f* in, 
-		astra::Vector3f* out,
-		const size_t width,
-		const size_t height);
-
-	LitDepthVisualizer();
-
-	void set_light_color(const astra::RgbPixel& color);
-	void set_light_direction(const astra::Vector3f& direction);
-	void set_ambient_color(const astra::RgbPixel& color);
-	void set_blur_radius(unsigned int radius);
-
-	void update(const astra::PointFrame& pointFrame);
-
-	astra::RgbPixel* get_output() const;
-
-private:
-	using VectorMapPtr = std::unique_ptr<astra::Vector3f[]>;
-	VectorMapPtr normalMap{ nullptr };
-	VectorMapPtr blurNormalMap{ nullptr };
-	size_t normalMapLength{ 0 };
-
-	astra::Vector3f lightVector;
-	unsigned int blurRadius{ 1 };
-	astra::RgbPixel lightColor;
-	astra::RgbPixel ambientColor;
-
-	size_t outputWidth;
-	size_t outputHeight;
-
-	using BufferPtr = std::unique_ptr<astra::RgbPixel[]>;
-	BufferPtr outputBuffer{ nullptr };
-
-	void prepare_buffer(size_t width, size_t height);
-	void calculate_normals(const astra::PointFrame& pointFrame);
-};
-
-#endif /* LITDEPTHVISUALIZER_H */
+// This file is part of the Orbbec Astra SDK [https://orbbec3d.com]
+// Copyright (c) 2015-2017 Orbbec 3D
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Be excellent to each other.
+#ifndef LITDEPTHVISUALIZER_H
+#define LITDEPTHVISUALIZER_H
+
+#include <astra/astra.hpp>
+#include "FrameArena.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+class LitDepthVisualizer
+{
+public:
+	// How the normal maps are stored. Shading is limited by memory bandwidth rather than
+	// arithmetic, so the smaller format is faster despite the encoding.
+	enum NormalFormat
+	{
+		NORMAL_FLOAT,		// astra::Vector3f, 12 bytes a pixel
+		NORMAL_OCTAHEDRAL,	// OctNormal, 4 bytes a pixel
+	};
+
+	// How update() holds the points and normals when it isn't fused
+	enum Layout
+	{
+		LAYOUT_AOS,			// maps of astra::Vector3f, or OctNormal, a pixel at a time
+		LAYOUT_SOA,			// separate x, y and z planes of floats, 8 pixels at a time with AVX2
+	};
+
+	// What the normals are worked out from, which the owner passes to update() or update_depth()
+	enum NormalSource
+	{
+		NORMALS_POINTS,		// the world space points of a PointFrame
+		NORMALS_DEPTH,		// a DepthFrame and the field of view
+	};
+
+	// How the normals are worked out
+	enum NormalEstimator
+	{
+		ESTIMATE_CROSS,		// cross products with the 4 neighbours, then blurred by the BlurMode
+		ESTIMATE_INTEGRAL,	// the average 3D gradients over a window, from integral images
+	};
+
+	// What update() and update_depth() make. The normals are in world space, y up and z away
+	// from the camera, for relighting the depth on the GPU.
+	enum Output
+	{
+		OUTPUT_SHADED,			// get_output(), the depth lit by the light
+		OUTPUT_NORMALS_RGBA16F,	// get_normal_output(), the unit normals and the depth in millimetres
+		OUTPUT_NORMALS_RG16F,	// get_normal_output(), the normals folded onto an octahedron
+	};
+
+	// How the normals are smoothed before shading
+	enum BlurMode
+	{
+		BLUR_FAST,			// box_blur_fast()
+		BLUR_BOX,			// box_blur_separable() with the blur radius
+	};
+
+	// A direction folded onto an octahedron and stored as two snorm16s, accurate to a few
+	// thousandths of a degree. The zero vector, for no normal, is stored with x = OctNormalNone.
+	struct OctNormal
+	{
+		int16_t x;
+		int16_t y;
+	};
+
+	static const int16_t OctNormalNone = INT16_MIN;
+	// Past this the box's rows of normals and the tiles' halos get too big to be worth carving
+	static const unsigned int MaxBlurRadius = 32;
+	// The x of an OUTPUT_NORMALS_RG16F pixel without a normal, outside the octahedron
+	static const float OctTexelNone;
+
+	// 'normal' doesn't have to be unit length
+	static OctNormal encode_normal(const astra::Vector3f& normal);
+	// Unit length, or zero
+	static astra::Vector3f decode_normal(OctNormal normal);
+
+	static void box_blur(
+		const astra::Vector3f* in,
+		astra::Vector3f* out,
+		const size_t width,
+		const size_t height,
+		const int blurRadius = 1);
+
+	static void box_blur_fast(
+		const astra::Vector3f* in, 
+		astra::Vector3f* out,
+		const size_t width,
+		const size_t height);
+
+	// box_blur_fast() for octahedral normals, each sum is re-encoded as its direction.
+	// 'rows' is scratch for 2 * width sums.
+	static void box_blur_octahedral(
+		const OctNormal* in,
+		OctNormal* out,
+		const size_t width,
+		const size_t height,
+		astra::Vector3f* rows);
+
+	// A (2 * radius + 1) square box blur that keeps running sums down the columns and across
+	// the rows, so its cost doesn't depend on the radius. Only the pixels inside the frame are
+	// summed, so the edges are blurred like everywhere else. 'rows' is scratch for 2 * width sums.
+	static void box_blur_separable(
+		const astra::Vector3f* in,
+		astra::Vector3f* out,
+		const size_t width,
+		const size_t height,
+		const int radius,
+		astra::Vector3f* rows);
+
+	// The same for octahedral normals, each sum is re-encoded as its direction
+	static void box_blur_separable(
+		const OctNormal* in,
+		OctNormal* out,
+		const size_t width,
+		const size_t height,
+		const int radius,
+		astra::Vector3f* rows);
+
+	LitDepthVisualizer();
+
+	LitDepthVisualizer(const LitDepthVisualizer&) = delete;
+	LitDepthVisualizer& operator=(const LitDepthVisualizer&) = delete;
+
+	// Bytes of FrameArena the scratch buffers update() needs for one size, with the current settings
+	size_t scratch_size(size_t width, size_t height) const;
+
+	// Carves the scratch buffers from 'arena' rather than the visualizer's own, its owner
+	// resets it and should leave scratch_size() of room for them
+	void set_arena(FrameArena* arena);
+
+	void set_light_color(const astra::RgbPixel& color);
+	void set_light_direction(const astra::Vector3f& direction);
+	void set_ambient_color(const astra::RgbPixel& color);
+	// Clamped to MaxBlurRadius
+	void set_blur_radius(unsigned int radius);
+	unsigned int get_blur_radius() const { return blurRadius; }
+	void set_blur_mode(BlurMode mode);
+	BlurMode get_blur_mode() const { return blurMode; }
+	void set_normal_format(NormalFormat format);
+	NormalFormat get_normal_format() const { return normalFormat; }
+
+	// Whether update() works down the frame a row at a time, shading each row as soon as the
+	// rows of normals around it are ready. Only a few rows of normals are kept, so they stay
+	// in cache and the normal format doesn't matter. The output is exactly the same, as long as
+	// the width is a multiple of 8 when the AVX2 kernel is shading.
+	void set_fused(bool fused);
+	bool get_fused() const { return fused; }
+
+	// With LAYOUT_SOA the points are split into planes once a frame, and the normals, blur and
+	// shading work along the planes, so the cross products don't have to be gathered from
+	// the interleaved points. The normal format doesn't matter. The output can differ from
+	// LAYOUT_AOS by one in a channel, as the sums are added up in a different order.
+	void set_layout(Layout layout);
+	Layout get_layout() const { return layout; }
+
+	// Whether the float normals are shaded 8 pixels at a time with AVX2, on CPUs that have it.
+	// The scalar loop is the reference, the two can differ by one in a channel.
+	void set_simd(bool simd);
+	bool get_simd() const { return simd; }
+	// Whether this CPU and OS can run the AVX2 kernel
+	static bool has_avx2();
+	bool uses_avx2() const { return simd && has_avx2(); }
+
+	void update(const astra::PointFrame& pointFrame);
+	void update(const astra::Vector3f* pointData, size_t width, size_t height);
+
+	// Shades a depth frame in millimetres without world space points. Each point is found
+	// as it's needed, as its depth times the ray through its pixel, with the rays worked out
+	// for the field of view (in radians) once. Always works on planes, like LAYOUT_SOA, and
+	// is shaded the same as update() on the points the Astra SDK makes from the depth.
+	void update_depth(const int16_t* depthData, size_t width, size_t height, float hFov, float vFov);
+
+	// The rays update_depth() finds the points along, through the columns and rows of a frame
+	static void make_rays(size_t width, size_t height, float hFov, float vFov, float* columnRays, float* rowRays);
+
+	// update_depth() on one tile of the frame at a time, for TiledDepthRenderer. Each tile is
+	// worked out from the depth in a halo around it, as far as its normals and their blur
+	// reach, so the tiles can be shaded in any order on any thread. The halo's depth, normals
+	// and blur are all in 'scratch', tile_scratch_size() bytes, so a tile stays in cache from
+	// the depth to the shading. The rays are make_rays() for the whole frame, and
+	// the tile is shaded into 'out' a row of 'tileWidth' pixels at a time.
+	//
+	// Only the cross products, not the integral images. The output can differ from
+	// update_depth() by one in a channel where the AVX2 loops are split differently, or the
+	// box blur's sums are added up in a different order.
+	size_t tile_halo() const;
+	size_t tile_scratch_size(size_t tileWidth, size_t tileHeight) const;
+	void shade_depth_tile(const int16_t* depthData, size_t width, size_t height, const float* columnRays, const float* rowRays,
+		size_t tileX, size_t tileY, size_t tileWidth, size_t tileHeight, float* scratch, astra::RgbPixel* out) const;
+
+	// Which of those the owner calls, so scratch_size() knows which buffers it needs
+	void set_normal_source(NormalSource source);
+	NormalSource get_normal_source() const { return normalSource; }
+
+	// With ESTIMATE_INTEGRAL the normal of a pixel is the cross product of the average
+	// vertical and horizontal gradients of the points in a window around it, like PCL's
+	// AVERAGE_3D_GRADIENT. The gradients are summed into integral images, so any window
+	// costs the same 4 lookups a pixel, and they smooth the normals themselves, so there's
+	// no blur. Always works on planes, like LAYOUT_SOA, and isn't fused.
+	//
+	// Where the depth changes between neighbours by more than 'threshold' times the depth,
+	// or there is none, is a silhouette. The window shrinks so it never reaches over one, and
+	// the pixels on the silhouettes are left without a normal.
+	void set_normal_estimator(NormalEstimator estimator);
+	NormalEstimator get_normal_estimator() const { return estimator; }
+	// Width of the window in pixels, odd sizes are centred and even ones are one smaller
+	void set_integral_window(unsigned int size);
+	unsigned int get_integral_window() const { return integralWindow; }
+	void set_depth_change_threshold(float threshold);
+	float get_depth_change_threshold() const { return depthChangeThreshold; }
+
+	// Either of the normal outputs skips the shading altogether. A pixel of OUTPUT_NORMALS_RGBA16F
+	// is 4 halves, and 0 where there's no normal. A pixel of OUTPUT_NORMALS_RG16F is the
+	// x and y of encode_normal() as 2 halves, in [-1, 1], with OctTexelNone for no normal.
+	// Fused shading doesn't apply to them.
+	void set_output(Output output);
+	Output get_output_mode() const { return output; }
+	// Halves per pixel of the normal output
+	static size_t output_channels(Output output) { return output == OUTPUT_NORMALS_RG16F ? 2 : 4; }
+
+	// Null when the last update couldn't carve its buffers, and left nothing to read
+	astra::RgbPixel* get_output() const;
+	const uint16_t* get_normal_output() const { return normalOutput; }
+
+	// Fills the blurred normal map update() shades with. False if its buffers couldn't be carved.
+	bool calculate_normals(const astra::Vector3f* positionMap, int width, int height);
+
+private:
+	FrameArena ownArena;
+	FrameArena* arena{ &ownArena };
+	uint32_t arenaGeneration{ 0 };
+
+	NormalFormat normalFormat{ NORMAL_FLOAT };
+	bool fused{ false };
+	Layout layout{ LAYOUT_AOS };
+	NormalSource normalSource{ NORMALS_POINTS };
+	NormalEstimator estimator{ ESTIMATE_CROSS };
+	unsigned int integralWindow{ 9 };
+	float depthChangeThreshold{ 0.02f };
+	Output output{ OUTPUT_SHADED };
+	bool simd{ true };
+
+	// What the buffers were carved for, the normal maps of 'bufferFormat', or the rows
+	// update_fused() works in for 'bufferBlurMode' and 'bufferBlurRadius'
+	NormalFormat bufferFormat{ NORMAL_FLOAT };
+	Layout bufferLayout{ LAYOUT_AOS };
+	bool bufferRows{ false };
+	bool bufferDepth{ false };
+	NormalEstimator bufferEstimator{ ESTIMATE_CROSS };
+	Output bufferOutput{ OUTPUT_SHADED };
+	BlurMode bufferBlurMode{ BLUR_FAST };
+	unsigned int bufferBlurRadius{ 0 };
+
+	astra::Vector3f* normalMap{ nullptr };
+	astra::Vector3f* blurNormalMap{ nullptr };
+	OctNormal* normalMapOct{ nullptr };
+	OctNormal* blurNormalMapOct{ nullptr };
+	astra::Vector3f* blurRows{ nullptr };
+	// One row of normals for BLUR_FAST, a ring of 2 * radius + 1 rows for BLUR_BOX
+	astra::Vector3f* normalRow{ nullptr };
+	// The x, y and z planes for LAYOUT_SOA, and a row or two of sums for blurring them
+	float* pointPlanes[3]{};
+	float* normalPlanes[3]{};
+	float* blurPlanes[3]{};
+	float* planeRows{ nullptr };
+	// For ESTIMATE_INTEGRAL, the integral images of the x, y and z of the horizontal and then
+	// the vertical gradients, interleaved so the corners of a window are 4 runs of 6, a row
+	// and column larger than the frame. And how far each pixel is from a silhouette.
+	double* gradientSums{ nullptr };
+	uint16_t* silhouetteDistance{ nullptr };
+	// The rays through each column and row for update_depth(), for the field of view and
+	// arena generation they were worked out for
+	float* rayX{ nullptr };
+	float* rayY{ nullptr };
+	float rayHFov{ 0.0f };
+	float rayVFov{ 0.0f };
+	uint32_t rayGeneration{ 0 };
+	astra::RgbPixel* outputBuffer{ nullptr };
+	uint16_t* normalOutput{ nullptr };
+
+	astra::Vector3f lightVector;
+	unsigned int blurRadius{ 1 };
+	BlurMode blurMode{ BLUR_FAST };
+	astra::RgbPixel lightColor;
+	astra::RgbPixel ambientColor;
+
+	size_t outputWidth{ 0 };
+	size_t outputHeight{ 0 };
+
+	// The layout the buffers are carved in, the integral images only work on planes
+	Layout buffer_layout() const { return estimator == ESTIMATE_INTEGRAL ? LAYOUT_SOA : layout; }
+	// Whether update() shades a row at a time, which only cross products can and which needs shading
+	bool fused_rows() const { return fused && estimator == ESTIMATE_CROSS && output == OUTPUT_SHADED; }
+	size_t buffers_size(size_t width, size_t height, bool rows, bool depth) const;
+	// False, with no output, if the arena couldn't give them all
+	bool prepare_buffers(size_t width, size_t height, bool rows = false, bool depth = false);
+	void prepare_rays(float hFov, float vFov);
+	bool prepare_buffer(size_t width, size_t height);
+
+	void update_fused(const astra::Vector3f* pointData, size_t width, size_t height);
+	void update_fused_box(const astra::Vector3f* pointData, size_t width, size_t height);
+	void calculate_normal_planes(const astra::Vector3f* positionMap, size_t width, size_t height);
+	void calculate_depth_normals(const int16_t* depthData, size_t width, size_t height);
+	void calculate_plane_normals(size_t width, size_t height, bool fromDepth);
+	void calculate_integral_normals(size_t width, size_t height, bool fromDepth);
+	void shade_planes(astra::RgbPixel* texturePtr, size_t count);
+	// Writes the blurred normals to the normal output, 'pointData' is what update() was given
+	void write_normals(const astra::Vector3f* pointData, size_t count);
+	void shade_pixel(float depth, const astra::Vector3f& norm, astra::RgbPixel& out) const;
+
+	template<typename Normal>
+	void shade(const astra::Vector3f* pointData, const Normal* normMap, astra::RgbPixel* texturePtr, size_t width, size_t height);
+
+	// Shades as many of the first 'count' pixels as the vector kernel can, returning how many
+	size_t shade_simd(const astra::Vector3f* pointData, const astra::Vector3f* normMap, astra::RgbPixel* texturePtr, size_t count) const;
+	size_t shade_simd(const astra::Vector3f*, const OctNormal*, astra::RgbPixel*, size_t) const { return 0; }
+};
+
+#endif /* LITDEPTHVISUALIZER_H */
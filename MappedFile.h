@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only into memory
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// 'path' is UTF-8. Returns false if the file can't be opened or is empty.
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return base != nullptr; }
+
+	const uint8_t* data() const { return base; }
+	uint64_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+	void* file{ nullptr };
+	void* mapping{ nullptr };
+#else
+	int fd{ -1 };
+#endif
+
+	const uint8_t* base{ nullptr };
+	uint64_t length{ 0 };
+};
+
+#endif // MAPPEDFILE_H
@@ -13,32 +13,131 @@
 */
 
 #include "OrbbecAstraTOP.h"
+#include "FramePacker.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <cmath>
-#include <random>
+#include <algorithm>
 #include <chrono>
 
 unsigned int OrbbecAstraTOP::instances = 0;
 
-// Uncomment this if you want to run an example that fills the data using threading
-#define THREADING_EXAMPLE
+// Frames can be produced in one of several modes, selected at runtime by the 'Mode' parameter.
+//
+// Free Run: a producer thread continually pumps the sensor and fills new buffers, which
+// the consumer (main thread) picks up when able. This gives the lowest latency, but frames
+// are dropped when the sensor produces faster than the TOP cooks.
+//
+// Cook Signalled: the main thread signals the producer thread to generate a new frame
+// each time it consumes a frame. Assuming the producer generates the frame in time before
+// execute() gets called again this gives a 1:1 sync between producing and consuming frames.
+//
+// Inline: no producer thread, the sensor is pumped and the buffer filled and uploaded
+// synchronously inside execute(). This costs cook time but has no queueing at all.
+//
+// Adaptive: runs as Cook Signalled while the TOP cooks at least as fast as the sensor
+// delivers frames and switches to Free Run when cooks fall behind, so a slow cook never
+// displays a frame that is a whole cook interval old.
+
+// The 'Acquisition' parameter picks how frames are taken from a sensor. Callback lets the
+// Astra SDK call back with frames from astra_update(), which the producer thread pumps a few
+// times per sensor frame. Poll has the producer thread wait in astra_reader_open_frame() for
+// each frame instead, so frames are picked up as soon as they arrive.
+
+// Longest a polled sensor blocks the producer thread waiting for a frame. Bounds how long
+// stopping the thread takes; Inline mode never waits, it runs inside the cook.
+const unsigned int PollWaitTimeout = 50;
+
+// Adaptive mode switches to Free Run once cooks take this much longer than sensor frames,
+// and back to Cook Signalled once they are within the lower ratio. The gap between the two
+// keeps it from flapping when both rates are nearly equal.
+const double AdaptiveFreeRunRatio = 1.25;
+const double AdaptiveSignalledRatio = 1.05;
+
+// Channels output to the Info CHOP
+enum InfoChan
+{
+	INFO_EXECUTE_COUNT,
+	INFO_SENSOR_FPS,
+	INFO_DELIVERED_FPS,
+	INFO_FRAMES_DROPPED,
+	INFO_QUEUE_DEPTH,
+	INFO_UPDATE_MS,
+	INFO_CONVERT_MS,
+	INFO_VISUALIZE_MS,
+	INFO_FILL_MS,
+	INFO_UPLOAD_MS,
+	INFO_LATENCY_MEAN_MS,
+	INFO_LATENCY_P99_MS,
+	INFO_RECORD_WRITTEN,
+	INFO_RECORD_DROPPED,
+	INFO_RECORD_DEPTH_RATIO,
+	INFO_SHARE_PUBLISHED,
+	INFO_PLAYBACK_FRAME,
+	INFO_ARENA_HUGE_PAGES,
+	INFO_SHADING_AVX2,
+	INFO_PACK_THREADS,
+	NUM_INFO_CHANS
+};
 
-// The threading example can run in two modes. One where the producer is continually
-// producing new frames that the consumer (main thread) picks up when able.
-// This more is useful for things such as external device input. This is the default
-// mode.
+// Rows output to the Info DAT, describing the frame last uploaded
+enum InfoRow
+{
+	INFO_ROW_EXECUTE_COUNT,
+	INFO_ROW_FRAME_ID,
+	INFO_ROW_FRAME_INDEX,
+	INFO_ROW_DEVICE_TIMESTAMP,
+	INFO_ROW_ARRIVAL_TIME,
+	INFO_ROW_AGE_AT_UPLOAD_MS,
+	INFO_ROW_WIDTH,
+	INFO_ROW_HEIGHT,
+	INFO_ROW_PIXEL_FORMAT,
+	INFO_ROW_STREAM,
+	NUM_INFO_ROWS
+};
 
-// The second mode can be instead used by also defining THREADING_SINGLED_PRODUCER.
-// (I.e Uncommenting the below line)
-// In this mode the main thread will signal to the producer thread to generate a new
-// frame each time it consumes a frame.
-// Assuming the producer will generate a new frame in time before execute() gets called
-// again this gives a better 1:1 sync between producing and consuming frames.
+static const char*
+pixelFormatName(uint32_t format)
+{
+	switch (format)
+	{
+	case ASTRA_PIXEL_FORMAT_DEPTH_MM:	return "depth_mm";
+	case ASTRA_PIXEL_FORMAT_GRAY8:		return "gray8";
+	case ASTRA_PIXEL_FORMAT_GRAY16:		return "gray16";
+	case ASTRA_PIXEL_FORMAT_RGB888:		return "rgb888";
+	case ASTRA_PIXEL_FORMAT_YUV422:		return "yuv422";
+	case ASTRA_PIXEL_FORMAT_YUYV:		return "yuyv";
+	case ASTRA_PIXEL_FORMAT_POINT:		return "point";
+	default:							return "unknown";
+	}
+}
 
-//#define THREADING_SIGNALED_PRODUCER
+static const char*
+streamTypeName(int32_t type)
+{
+	switch (type)
+	{
+	case AstraFrameListener::DEPTH:		return "depth";
+	case AstraFrameListener::COLOR:		return "color";
+	case AstraFrameListener::IR_16:		return "ir16";
+	case AstraFrameListener::IR_RGB:	return "irrgb";
+	default:							return "unknown";
+	}
+}
+
+static OP_PixelFormat
+uploadFormat(FramePacker::Destination destination)
+{
+	switch (destination)
+	{
+	case FramePacker::DEST_RGBA8_FIXED:		return OP_PixelFormat::RGBA8Fixed;
+	case FramePacker::DEST_RGBA16_FLOAT:	return OP_PixelFormat::RGBA16Float;
+	case FramePacker::DEST_RG16_FLOAT:		return OP_PixelFormat::RG16Float;
+	default:								return OP_PixelFormat::RGBA32Float;
+	}
+}
 
 // These functions are basic C function, which the DLL loader can find
 // much easier than finding a C++ Class.
@@ -107,32 +206,34 @@ OrbbecAstraTOP::OrbbecAstraTOP(const OP_NodeInfo* info, TOP_Context* context) :
 	myThread(nullptr),
 	myThreadShouldExit(false),
 	myStartWork(false),
+	myThreadMode(ProducerMode::FreeRun),
+	myAdaptiveMode(ProducerMode::CookSignalled),
+	myLastProducedFrame(0),
+	myFramesSkipped(0),
+	myCookInterval(0.0),
+	myUploadAge(0),
+	myTraceRequested(false),
+	myRecordEnabled(false),
+	myShareSlots(0),
+	mySeekRequested(false),
+	myPixelFormat(FramePacker::DEST_RGBA32_FLOAT),
+	myPackThreads(4),
 	myContext(context),
 	myFrameQueue(context)
 {
 	myExecuteCount = 0;
 
-	connectSensor(name.c_str());
+	PipelineTrace::instance().setThreadName("main");
 }
 
 OrbbecAstraTOP::~OrbbecAstraTOP()
 {
-#ifdef THREADING_EXAMPLE
-	if (myThread)
-	{
-		myThreadShouldExit.store(true);
-		// Incase the thread is sleeping waiting for a signal
-		// to create more work, wake it up
-		startMoreWork();
-		if (myThread->joinable())
-		{
-			myThread->join();
-		}
-		delete myThread;
-	}
-#endif
+	stopProducer();
 
 	disconnectSensor();
+
+	// Not left for the trace's destructor, which runs as the plugin is unloaded
+	PipelineTrace::instance().waitForWrite();
 }
 
 void
@@ -144,11 +245,13 @@ OrbbecAstraTOP::getGeneralInfo(TOP_GeneralInfo* ginfo, const OP_Inputs* inputs,
 void
 OrbbecAstraTOP::execute(TOP_Output* output, const OP_Inputs* inputs, void* reserved1)
 {
-	const char* device = inputs->getParString("Device");
+	// Device 'playback' plays the recording in 'Playbackfile' instead of a sensor
+	std::string device = inputs->getParString("Device");
+	if (device == "playback")
+		device = std::string("playback:") + inputs->getParFilePath("Playbackfile");
+
 	const char* frame = inputs->getParString("Type");
 	
-	name = std::string("device/sensor") + std::string(device);
-
 	StreamType updated = StreamType::DEPTH;
 	if (!strcmp(frame, "Color"))
 		updated = StreamType::COLOR;
@@ -160,150 +263,213 @@ OrbbecAstraTOP::execute(TOP_Output* output, const OP_Inputs* inputs, void* reser
 		updated = StreamType::DEPTH;
 
 	setStreamType( updated );
+	setPolling(!strcmp(inputs->getParString("Acquisition"), "Poll"));
+	setHugePages(inputs->getParInt("Hugepages") != 0);
+	setNormalFormat(!strcmp(inputs->getParString("Normalformat"), "Octahedral") ?
+		LitDepthVisualizer::NORMAL_OCTAHEDRAL : LitDepthVisualizer::NORMAL_FLOAT);
+
+	// Normals from the depth, or from integral images, are always worked out on planes, so
+	// none of how the points are shaded applies to them. Fused shading keeps no normal maps,
+	// so their layout and format don't matter, and neither does the format of the planes.
+	const bool depthNormals = !strcmp(inputs->getParString("Normals"), "Depth");
+	const bool integral = !strcmp(inputs->getParString("Normalestimator"), "Integral");
+	const bool fusedShading = inputs->getParInt("Fusedshading") != 0;
+	const bool planes = !strcmp(inputs->getParString("Layout"), "Soa");
+	const bool pointMaps = !depthNormals && !integral;
+	setDepthNormals(depthNormals);
+	setFusedShading(fusedShading);
+	setVisualizerLayout(planes ? LitDepthVisualizer::LAYOUT_SOA : LitDepthVisualizer::LAYOUT_AOS);
+
+	// The normals are lit on the GPU instead, which needs whole normal maps, so isn't fused
+	const char* outputName = inputs->getParString("Depthoutput");
+	DepthOutput depthOutput = DEPTH_SHADED;
+	if (!strcmp(outputName, "Normalsrgba"))
+		depthOutput = DEPTH_NORMALS_RGBA16F;
+	else if (!strcmp(outputName, "Normalsrg"))
+		depthOutput = DEPTH_NORMALS_RG16F;
+	else if (!strcmp(outputName, "Depth"))
+		depthOutput = DEPTH_MILLIMETRES;
+	else if (!strcmp(outputName, "Points"))
+		depthOutput = DEPTH_POINTS;
+	const bool shaded = depthOutput == DEPTH_SHADED;
+	const bool fused = fusedShading && shaded;
+	setDepthOutput(depthOutput);
+
+	// None of the visualizer's settings matter to the depth or the points
+	const bool lit = depthOutput != DEPTH_MILLIMETRES && depthOutput != DEPTH_POINTS;
+	inputs->enablePar("Normals", lit);
+	inputs->enablePar("Fusedshading", lit && pointMaps && shaded);
+	inputs->enablePar("Layout", lit && pointMaps && !fused);
+	inputs->enablePar("Normalformat", lit && pointMaps && !fused && !planes);
+
+	const char* pixelFormat = inputs->getParString("Pixelformat");
+	if (!strcmp(pixelFormat, "Rgba8fixed"))
+		myPixelFormat.store(FramePacker::DEST_RGBA8_FIXED);
+	else if (!strcmp(pixelFormat, "Rgba16float"))
+		myPixelFormat.store(FramePacker::DEST_RGBA16_FLOAT);
+	else
+		myPixelFormat.store(FramePacker::DEST_RGBA32_FLOAT);
+	myPackThreads.store(std::max(1, inputs->getParInt("Packthreads")));
+
+	// Only the points are cropped and decimated
+	setReprojection(inputs->getParInt("Roiposition", 0), inputs->getParInt("Roiposition", 1),
+		inputs->getParInt("Roisize", 0), inputs->getParInt("Roisize", 1), inputs->getParInt("Decimation"));
+	const bool points = depthOutput == DEPTH_POINTS || (lit && !depthNormals);
+	inputs->enablePar("Roiposition", points);
+	inputs->enablePar("Roisize", points);
+	inputs->enablePar("Decimation", points);
+
+	// The integral images smooth the normals themselves
+	const bool boxBlur = !strcmp(inputs->getParString("Normalblur"), "Box");
+	setNormalBlur(boxBlur ? LitDepthVisualizer::BLUR_BOX : LitDepthVisualizer::BLUR_FAST,
+		unsigned(std::max(0, inputs->getParInt("Blurradius"))));
+	setNormalEstimator(integral ? LitDepthVisualizer::ESTIMATE_INTEGRAL : LitDepthVisualizer::ESTIMATE_CROSS,
+		unsigned(std::max(1, inputs->getParInt("Normalwindow"))), float(inputs->getParDouble("Depthchange")));
+	inputs->enablePar("Normalestimator", lit);
+	inputs->enablePar("Normalblur", lit && !integral);
+	inputs->enablePar("Blurradius", lit && !integral && boxBlur);
+	inputs->enablePar("Normalwindow", lit && integral);
+	inputs->enablePar("Depthchange", lit && integral);
+	setSimdShading(inputs->getParInt("Simdshading") != 0);
+	inputs->enablePar("Simdshading", shaded || points);
+
+	// The tiles are only for the lit depth, from the depth with cross products
+	const bool tiled = inputs->getParInt("Tiledshading") != 0;
+	setTiledShading(tiled, inputs->getParInt("Tilesize"));
+	inputs->enablePar("Tiledshading", shaded && depthNormals && !integral);
+	inputs->enablePar("Tilesize", shaded && depthNormals && !integral && tiled);
+
+	if (!isSensorConnected(device.c_str()))
+	{
+		// The producer thread pumps the current source, it's restarted below
+		stopProducer();
+		connectSensor(device.c_str());
 
-	connectSensor(name.c_str());
+		myWarning = getPlaybackError();
+	}
+
+	setPlaybackOptions(!strcmp(inputs->getParString("Playbackmode"), "Realtime"), inputs->getParInt("Playbackloop") != 0);
+
+	if (mySeekRequested.exchange(false))
+		seekPlayback(inputs->getParInt("Seekframe"));
 
 	myExecuteCount++;
 
-#ifdef THREADING_EXAMPLE
-	mySettingsLock.lock();
-#endif
+	updateCookInterval();
+	pipelineStats.expire();
+
+	if (myTraceRequested.exchange(false))
+	{
+		PipelineTrace::instance().start(inputs->getParDouble("Traceseconds"), inputs->getParFilePath("Tracefile"));
+		myWarning.clear();
+	}
 
-	// See comments at the top of this file to information about the threading
-	// example mode for this project.
-#ifdef THREADING_EXAMPLE
-	mySettingsLock.unlock();
+	if (!PipelineTrace::instance().update())
+		myWarning = std::string("Unable to write trace file ") + inputs->getParFilePath("Tracefile");
 
-	if (!myThread)
+	// Only acts when the toggle changes, so a recording that failed to start or was stopped
+	// by a reconnect isn't retried (and the file overwritten) every cook
+	const bool record = inputs->getParInt("Record") != 0;
+	if (record != myRecordEnabled)
 	{
-		myThread = new std::thread(
-			[this]()
-			{
-				std::random_device rd;
-				std::mt19937 mt(rd());
-
-				// We are going to generate new frame data at irregular interval
-				std::uniform_real_distribution<double> dist(10.0, 40.0);
-
-				// Exit when our owner tells us to
-				while (!this->myThreadShouldExit)
-				{
-#ifdef THREADING_SIGNALED_PRODUCER
-					this->waitForMoreWork();
-					// We may be waking up because the owner is trying to shut down
-					if (myThreadShouldExit)
-					{
-						break;
-					}
-#else
-					auto begin = std::chrono::steady_clock::now();
-#endif
-					astra_update();
+		myRecordEnabled = record;
+		if (!record)
+			stopRecording();
+		else if (startRecording(inputs->getParFilePath("Recordfile"), inputs->getParInt("Recordcompress") != 0))
+			myWarning.clear();
+		else
+			myWarning = std::string("Unable to create recording file ") + inputs->getParFilePath("Recordfile");
+	}
 
-					TOP_UploadInfo info;
-					info.textureDesc.width = getStreamWidth();
-					info.textureDesc.height = getStreamHeight();
-					info.textureDesc.texDim = OP_TexDim::e2D;
-					info.textureDesc.pixelFormat = OP_PixelFormat::RGBA32Float;
-					uint64_t size = uint64_t(info.textureDesc.width) * info.textureDesc.height * sizeof(float) * 4;
-					OP_SmartRef<TOP_Buffer> buf = this->myFrameQueue.getBufferToUpdate(size, TOP_BufferFlags::None);
+	if (getRecorder().hasWriteError())
+		myWarning = std::string("Error writing recording file ") + inputs->getParFilePath("Recordfile");
 
-					// If there is a buffer to update
-					if (buf)
-					{
-						this->mySettingsLock.lock();
+	// Readers follow the exporter to a new ring, so unlike a recording it's simply restarted
+	// whenever its settings change
+	const std::string shareName = inputs->getParInt("Share") ? inputs->getParString("Sharename") : "";
+	const int shareSlots = inputs->getParInt("Shareslots");
+	if (shareName != myShareName || (!shareName.empty() && shareSlots != myShareSlots))
+	{
+		myShareName = shareName;
+		myShareSlots = shareSlots;
 
-						// ** Update Orbbec settings
+		if (shareName.empty())
+			stopSharing();
+		else
+			startSharing(shareName, shareSlots);
+	}
 
-						this->mySettingsLock.unlock();
+	if (getExporter().hasError())
+		myWarning = std::string("Unable to create shared memory ") + myShareName;
 
-						OrbbecAstraTOP::fillBuffer(buf, 0, info.textureDesc.width, info.textureDesc.height);
+	ProducerMode requested = ProducerMode::FreeRun;
+	const char* mode = inputs->getParString("Mode");
+	if (!strcmp(mode, "Cooksignalled"))
+		requested = ProducerMode::CookSignalled;
+	else if (!strcmp(mode, "Inline"))
+		requested = ProducerMode::Inline;
+	else if (!strcmp(mode, "Adaptive"))
+		requested = ProducerMode::Adaptive;
 
-						BufferInfo bufInfo;
-						bufInfo.buf = buf;
-						bufInfo.uploadInfo = info;
-						this->myFrameQueue.updateComplete(bufInfo);
-					}
+	const ProducerMode resolved = resolveProducerMode(requested);
 
-#ifndef THREADING_SIGNALED_PRODUCER
-					auto end = std::chrono::steady_clock::now();
-					auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+	setWaitTimeout(resolved == ProducerMode::Inline ? 0 : PollWaitTimeout);
 
-					// Sleep for a 15.5ms. We want our loops to be 16.666ms, so this give some wiggle wrong.
-					// In almost all cases we wouldn't be manually sleeping, but instead sleeping
-					// using a function from the SDK of the device that we are reading.
-					std::this_thread::sleep_for(std::chrono::microseconds(15500 - duration));
-#endif
-				}
-			});
+	// See comments at the top of this file for information about the producer modes.
+	if (resolved == ProducerMode::Inline)
+	{
+		// The sensor must only be pumped from one thread
+		stopProducer();
+
+		updateSensor();
+
+		if (claimNewFrame())
+		{
+			fillAndUpload(output, getStreamWidth(), getStreamHeight(), OP_TexDim::e2D, 1, 0);
+		}
+		return;
+	}
+
+	if (myThreadMode.exchange(resolved) != resolved)
+	{
+		// Wake the thread in case it's waiting on a signal that will no longer come
+		startMoreWork();
 	}
 
+	startProducer();
+
 	// Tries to assign a buffer to be uploaded to the TOP
 	BufferInfo bufInfo = myFrameQueue.getBufferToUpload();
 
 	if (bufInfo.buf)
+	{
+		PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_UPLOAD);
+		PipelineTrace::Scope trace("upload", bufInfo.metadata.frameId);
 		output->uploadBuffer(&bufInfo.buf, bufInfo.uploadInfo, nullptr);
+		uploaded(bufInfo.metadata);
+	}
 
-#ifdef THREADING_SIGNALED_PRODUCER
-	// Tell the thread to make another frame
-	startMoreWork();
-#endif
-
-#else
-
-	fillAndUpload(output, speed, width, height, OP_TexDim::e2D, 1, 0);
-	// You can uncomment these to upload other texture dimension types, to other color buffer indices.
-	// Use a Render Select TOP to view the other textures
-	//fillAndUpload(output, speed, 256, 256, OP_TexDim::eCube, 1, 1);
-	//fillAndUpload(output, speed, 64, 64, OP_TexDim::e3D, 32, 2);
-
-	if (inputs->getNumInputs() > 0)
+	if (resolved == ProducerMode::CookSignalled)
 	{
-		// Although you'd general never want to download a texture only to re-upload it.
-		// This is here to show how to read from a TOP input in CPU memory.
-		// More typically used to output the image data to another output device/file.
-		const OP_TOPInput* top = inputs->getInputTOP(0);
-		if (top)
-		{
-			OP_TOPInputDownloadOptions opts;
-			// If you want to download the texture as a particular format, regardless of what it is
-			// on the GPU, you can force it here.
-			//opts.pixelFormat = OP_PixelFormat::RGBA32Float;
-			OP_SmartRef<OP_TOPDownloadResult> downRes = top->downloadTexture(opts, nullptr);
-
-			// the getData() call on OP_TOPDownloadResult will stall until the download is finished.
-			// This is usually a whilte, but less than a full frame, so instead of stalling on it
-			// we keep track of the previous download result, and use that to output.
-			// This avoids a stall, but results in the uploaded image being 1 frame behind in this
-			// example.
-			// More typically situations involve outputing to a device/file later on, possibly
-			// passthis the OP_SmartRef<OP_TOPDownloadResult> to another thread so it can stall
-			// and process the data as soon as it's ready.
-			if (myPrevDownRes)
-			{
-				TOP_UploadInfo info;
-				info.textureDesc = myPrevDownRes->textureDesc;
-				info.colorBufferIndex = 3;
-				OP_SmartRef<TOP_Buffer> buf = myContext->createOutputBuffer(myPrevDownRes->size, TOP_BufferFlags::None, nullptr);
-
-				memcpy(buf->data, myPrevDownRes->getData(), myPrevDownRes->size);
-
-				output->uploadBuffer(&buf, info, nullptr);
-			}
-			myPrevDownRes = std::move(downRes);
-		}
+		// Tell the thread to make another frame
+		startMoreWork();
 	}
-#endif
 }
 
 void
-OrbbecAstraTOP::fillAndUpload(TOP_Output* output, double speed, int width, int height, OP_TexDim texDim, int numLayers, int colorBufferIndex)
+OrbbecAstraTOP::fillAndUpload(TOP_Output* output, int width, int height, OP_TexDim texDim, int numLayers, int colorBufferIndex)
 {
+	if (width == 0 || height == 0)
+		return;
+
+	// The pack kernel is picked once for all the layers
+	const FramePacker::Destination destination = FramePacker::resolve(getStreamFormat(), myPixelFormat.load());
+
 	TOP_UploadInfo info;
 	info.textureDesc.texDim = texDim;
 	info.textureDesc.width = width;
 	info.textureDesc.height = height;
-	info.textureDesc.pixelFormat = OP_PixelFormat::RGBA32Float;
+	info.textureDesc.pixelFormat = uploadFormat(destination);
 	if (texDim == OP_TexDim::e2DArray || texDim == OP_TexDim::e3D)
 		info.textureDesc.depth = numLayers;
 	else if (texDim == OP_TexDim::eCube)
@@ -314,56 +480,250 @@ OrbbecAstraTOP::fillAndUpload(TOP_Output* output, double speed, int width, int h
 
 	info.colorBufferIndex = colorBufferIndex;
 
-	uint64_t layerBytes = uint64_t(info.textureDesc.width) * info.textureDesc.height * 4 * sizeof(float);
+	uint64_t layerBytes = uint64_t(info.textureDesc.width) * info.textureDesc.height * FramePacker::destinationBytesPerPixel(destination);
 	uint64_t byteSize = layerBytes * numLayers;
 	OP_SmartRef<TOP_Buffer> buf = myContext->createOutputBuffer(byteSize, TOP_BufferFlags::None, nullptr);
 
-	uint64_t byteOffset = 0;
-	for (int i = 0; i < numLayers; i++)
 	{
-		//myStep += speed;
-		fillBuffer(buf, byteOffset, info.textureDesc.width, info.textureDesc.height);
-		byteOffset += layerBytes;
+		PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_FILL);
+		PipelineTrace::Scope trace("fillBuffer", myLastProducedFrame);
+
+		uint64_t byteOffset = 0;
+		for (int i = 0; i < numLayers; i++)
+		{
+			fillBuffer(buf, byteOffset, info.textureDesc.width, info.textureDesc.height, destination);
+			byteOffset += layerBytes;
+		}
 	}
 
-	output->uploadBuffer(&buf, info, nullptr);
+	{
+		PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_UPLOAD);
+		PipelineTrace::Scope trace("upload", myLastProducedFrame);
+		output->uploadBuffer(&buf, info, nullptr);
+	}
+	uploaded(getFrameMetadata());
 }
 
 void
-OrbbecAstraTOP::fillBuffer(OP_SmartRef<TOP_Buffer>& buf, uint64_t byteOffset, int width, int height)
+OrbbecAstraTOP::uploaded(const FrameMetadata& metadata)
 {
-	assert(buf->size - byteOffset >= uint64_t(width) * height * sizeof(float) * 4);
+	myUploadedMetadata = metadata;
+	myUploadAge = metadata.arrivalTime != 0 ? PipelineStats::now() - metadata.arrivalTime : 0;
+	pipelineStats.countDeliveredFrame(metadata.arrivalTime);
+}
 
-	char* bytePtr = (char*)buf->data;
-	bytePtr += byteOffset;
+void
+OrbbecAstraTOP::startProducer()
+{
+	if (myThread)
+		return;
+
+	myThreadShouldExit.store(false);
+	myThread = new std::thread([this]() { this->producerLoop(); });
+}
+
+void
+OrbbecAstraTOP::stopProducer()
+{
+	if (!myThread)
+		return;
+
+	myThreadShouldExit.store(true);
+	// Incase the thread is sleeping waiting for a signal
+	// to create more work, wake it up
+	startMoreWork();
+	if (myThread->joinable())
+	{
+		myThread->join();
+	}
+	delete myThread;
+	myThread = nullptr;
+}
 
-	float* mem = (float*)bytePtr;
-
-	for (int y = 0; y < height; ++y){
-		for (int x = 0; x < width; ++x){
-			float* pixel = &mem[4 * (y*width + x)];
-
-			size_t index = 4 * (y * width + x);
-			
-			uint8_t* buffer;
-			switch (streamType){
-			case StreamType::DEPTH:
-				buffer = &depthStream.buffer[0];
-				break;
-			case StreamType::COLOR:
-				buffer = &colorStream.buffer[0];
-				break;
-			default:
-				break;
+void
+OrbbecAstraTOP::producerLoop()
+{
+	PipelineTrace::instance().setThreadName("producer");
+
+	// Exit when our owner tells us to
+	while (!myThreadShouldExit)
+	{
+		const bool signalled = myThreadMode.load() == ProducerMode::CookSignalled;
+
+		if (signalled)
+		{
+			waitForMoreWork();
+			// We may be waking up because the owner is trying to shut down
+			if (myThreadShouldExit)
+			{
+				break;
 			}
+		}
 
-			// RGBA
-			for(size_t i = 0; i < 4; i++)
-				pixel[i] = float(buffer[index + i]) / 255.0f;
+		auto begin = std::chrono::steady_clock::now();
+
+		produceFrame();
+
+		// A source that waits for its frames has already waited as long as it needs to
+		if (!signalled && !sensorWaitsForFrames())
+		{
+			auto end = std::chrono::steady_clock::now();
+			auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+
+			// Poll a few times per sensor frame so a new frame waits at most a fraction of
+			// the sensor interval before it's picked up. Until the interval is known poll at
+			// roughly 60Hz, leaving some wiggle room under 16.666ms.
+			const double sensorInterval = getFrameInterval();
+			long long period = sensorInterval > 0.0 ? (long long)(sensorInterval * 1000.0 / 4.0) : 15500;
+			period = std::max(1000LL, std::min(15500LL, period));
+
+			if (period > duration)
+				std::this_thread::sleep_for(std::chrono::microseconds(period - duration));
 		}
 	}
 }
 
+void
+OrbbecAstraTOP::updateSensor()
+{
+	PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_UPDATE);
+
+	// The frame id is only known once the frame has arrived, so this can't use a trace scope
+	const uint64_t begin = PipelineTrace::instance().isRecording() ? PipelineStats::now() : 0;
+
+	pollSensor();
+
+	if (begin != 0)
+		PipelineTrace::instance().addEvent("sensor_update", begin, PipelineStats::now(), getFramesReceived());
+}
+
+void
+OrbbecAstraTOP::produceFrame()
+{
+	updateSensor();
+
+	// Only queue a buffer when the sensor delivered something new, otherwise
+	// the TOP would re-upload the same frame
+	if (!claimNewFrame())
+		return;
+	const uint32_t framesReceived = myLastProducedFrame;
+
+	TOP_UploadInfo info;
+	info.textureDesc.width = getStreamWidth();
+	info.textureDesc.height = getStreamHeight();
+	info.textureDesc.texDim = OP_TexDim::e2D;
+	const FramePacker::Destination destination = FramePacker::resolve(getStreamFormat(), myPixelFormat.load());
+	info.textureDesc.pixelFormat = uploadFormat(destination);
+
+	if (info.textureDesc.width == 0 || info.textureDesc.height == 0)
+		return;
+
+	uint64_t size = uint64_t(info.textureDesc.width) * info.textureDesc.height * FramePacker::destinationBytesPerPixel(destination);
+	OP_SmartRef<TOP_Buffer> buf = myFrameQueue.getBufferToUpdate(size, TOP_BufferFlags::None);
+
+	// If there is a buffer to update
+	if (buf)
+	{
+		mySettingsLock.lock();
+
+		// ** Update Orbbec settings
+
+		mySettingsLock.unlock();
+
+		{
+			PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_FILL);
+			PipelineTrace::Scope trace("fillBuffer", framesReceived);
+			fillBuffer(buf, 0, info.textureDesc.width, info.textureDesc.height, destination);
+		}
+
+		BufferInfo bufInfo;
+		bufInfo.buf = buf;
+		bufInfo.uploadInfo = info;
+		bufInfo.metadata = getFrameMetadata();
+		myFrameQueue.updateComplete(bufInfo);
+	}
+}
+
+bool
+OrbbecAstraTOP::claimNewFrame()
+{
+	const uint32_t framesReceived = getFramesReceived();
+	if (framesReceived == myLastProducedFrame)
+		return false;
+
+	// The frames delivered in between were converted, but replaced before they were filled
+	// into a buffer, which in Cook Signalled mode is most of them when the sensor is faster
+	myFramesSkipped += framesReceived - myLastProducedFrame - 1;
+	myLastProducedFrame = framesReceived;
+	return true;
+}
+
+void
+OrbbecAstraTOP::updateCookInterval()
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	if (myLastCookTime != std::chrono::steady_clock::time_point())
+	{
+		const double interval = std::chrono::duration<double, std::milli>(now - myLastCookTime).count();
+
+		// A long gap means the TOP stopped cooking for a while (e.g. it was not being viewed),
+		// which says nothing about the steady state cook rate.
+		if (interval > 1000.0)
+			myCookInterval = 0.0;
+		else if (myCookInterval == 0.0)
+			myCookInterval = interval;
+		else
+			myCookInterval += 0.1 * (interval - myCookInterval);
+	}
+	myLastCookTime = now;
+}
+
+OrbbecAstraTOP::ProducerMode
+OrbbecAstraTOP::resolveProducerMode(ProducerMode requested)
+{
+	if (requested != ProducerMode::Adaptive)
+		return requested;
+
+	const double sensorInterval = getFrameInterval();
+
+	// Without both measurements keep whatever we were doing
+	if (sensorInterval > 0.0 && myCookInterval > 0.0)
+	{
+		if (myAdaptiveMode == ProducerMode::CookSignalled && myCookInterval > sensorInterval * AdaptiveFreeRunRatio)
+			myAdaptiveMode = ProducerMode::FreeRun;
+		else if (myAdaptiveMode == ProducerMode::FreeRun && myCookInterval < sensorInterval * AdaptiveSignalledRatio)
+			myAdaptiveMode = ProducerMode::CookSignalled;
+	}
+
+	return myAdaptiveMode;
+}
+
+void
+OrbbecAstraTOP::fillBuffer(OP_SmartRef<TOP_Buffer>& buf, uint64_t byteOffset, int width, int height, FramePacker::Destination destination)
+{
+	assert(buf->size - byteOffset >= uint64_t(width) * height * FramePacker::destinationBytesPerPixel(destination));
+
+	char* bytePtr = (char*)buf->data;
+	bytePtr += byteOffset;
+
+	// The IR streams are converted into the color buffer, see getStreamWidth()
+	const Stream& stream = streamType == StreamType::DEPTH ? depthStream : colorStream;
+	if (!stream.buffer)
+		return;
+
+	myPackPool.setThreads(myPackThreads.load());
+
+	// The depth is shaded straight into the buffer, the tiles are spread over the same threads
+	if (stream.format == FramePacker::SOURCE_DEPTH16_LIT)
+	{
+		renderDepthTiles((uint8_t*)bytePtr, destination, myPackPool);
+		return;
+	}
+
+	FramePacker::pack(stream.format, destination, &stream.buffer[0], (uint8_t*)bytePtr, width, height, myPackPool);
+}
+
 
 void
 OrbbecAstraTOP::startMoreWork()
@@ -404,27 +764,117 @@ int32_t
 OrbbecAstraTOP::getNumInfoCHOPChans(void *reserved1)
 {
 	// We return the number of channel we want to output to any Info CHOP
-	// connected to the TOP. In this example we are just going to send one channel.
-	return 2;
+	// connected to the TOP.
+	return NUM_INFO_CHANS;
 }
 
 void
 OrbbecAstraTOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
 {
-	// This function will be called once for each channel we said we'd want to return
-	// In this example it'll only be called once.
+	// This function will be called once for each channel we said we'd want to return.
+	// The stats are snapshotted once per cook, on the first channel. Taking a snapshot
+	// also keeps stats collection switched on, see PipelineStats.
 
 	if (index == 0)
+		myStatsSnapshot = pipelineStats.takeSnapshot(myFrameQueue.getQueueDepth(), myFrameQueue.getNumDropped() + myFramesSkipped.load());
+
+	const PipelineStats::Snapshot& snap = myStatsSnapshot;
+
+	switch (index)
 	{
+	case INFO_EXECUTE_COUNT:
 		chan->name->setString("executeCount");
 		chan->value = (float)myExecuteCount;
+		break;
+	case INFO_SENSOR_FPS:
+		chan->name->setString("sensorFps");
+		chan->value = (float)snap.sensorFps;
+		break;
+	case INFO_DELIVERED_FPS:
+		chan->name->setString("deliveredFps");
+		chan->value = (float)snap.deliveredFps;
+		break;
+	case INFO_FRAMES_DROPPED:
+		// Replaced in the queue, or converted and replaced before they were queued
+		chan->name->setString("framesDropped");
+		chan->value = (float)snap.framesDropped;
+		break;
+	case INFO_QUEUE_DEPTH:
+		chan->name->setString("queueDepth");
+		chan->value = (float)snap.queueDepth;
+		break;
+	case INFO_UPDATE_MS:
+		chan->name->setString("updateMs");
+		chan->value = (float)snap.stageMs[PipelineStats::STAGE_UPDATE];
+		break;
+	case INFO_CONVERT_MS:
+		chan->name->setString("convertMs");
+		chan->value = (float)snap.stageMs[PipelineStats::STAGE_CONVERT];
+		break;
+	case INFO_VISUALIZE_MS:
+		chan->name->setString("visualizeMs");
+		chan->value = (float)snap.stageMs[PipelineStats::STAGE_VISUALIZE];
+		break;
+	case INFO_FILL_MS:
+		// With tiled shading the depth is lit as it's packed, so this includes the lighting
+		// and visualizeMs doesn't
+		chan->name->setString("fillMs");
+		chan->value = (float)snap.stageMs[PipelineStats::STAGE_FILL];
+		break;
+	case INFO_UPLOAD_MS:
+		chan->name->setString("uploadMs");
+		chan->value = (float)snap.stageMs[PipelineStats::STAGE_UPLOAD];
+		break;
+	case INFO_LATENCY_MEAN_MS:
+		chan->name->setString("latencyMeanMs");
+		chan->value = (float)snap.latencyMeanMs;
+		break;
+	case INFO_LATENCY_P99_MS:
+		chan->name->setString("latencyP99Ms");
+		chan->value = (float)snap.latencyP99Ms;
+		break;
+	case INFO_RECORD_WRITTEN:
+		chan->name->setString("recordFramesWritten");
+		chan->value = (float)getRecorder().getFramesWritten();
+		break;
+	case INFO_RECORD_DROPPED:
+		chan->name->setString("recordFramesDropped");
+		chan->value = (float)getRecorder().getFramesDropped();
+		break;
+	case INFO_RECORD_DEPTH_RATIO:
+		chan->name->setString("recordDepthRatio");
+		chan->value = (float)getRecorder().getDepthCompressionRatio();
+		break;
+	case INFO_SHARE_PUBLISHED:
+		chan->name->setString("shareFramesPublished");
+		chan->value = (float)getExporter().getFramesPublished();
+		break;
+	case INFO_PLAYBACK_FRAME:
+		chan->name->setString("playbackFrame");
+		chan->value = (float)getPlaybackFrame();
+		break;
+	case INFO_ARENA_HUGE_PAGES:
+		chan->name->setString("arenaHugePages");
+		chan->value = getArena().usesHugePages() ? 1.0f : 0.0f;
+		break;
+	case INFO_SHADING_AVX2:
+		chan->name->setString("shadingAvx2");
+		chan->value = usesAvx2Shading() ? 1.0f : 0.0f;
+		break;
+	case INFO_PACK_THREADS:
+		// The time they take is fillMs
+		chan->name->setString("packThreads");
+		chan->value = (float)myPackThreads.load();
+		break;
+	default:
+		break;
 	}
 }
 
 bool		
 OrbbecAstraTOP::getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1)
 {
-	infoSize->rows = 2;
+	infoSize->rows = NUM_INFO_ROWS;
 	infoSize->cols = 2;
 	// Setting this to false means we'll be assigning values to the table
 	// one row at a time. True means we'll do it one column at a time.
@@ -439,25 +889,104 @@ OrbbecAstraTOP::getInfoDATEntries(int32_t index,
 								void *reserved1)
 {
 	char tempBuffer[4096];
+	const FrameMetadata& meta = myUploadedMetadata;
 
-	if (index == 0)
+	const char* name = nullptr;
+	switch (index)
 	{
-		// Set the value for the first column
+	case INFO_ROW_EXECUTE_COUNT:
+		name = "executeCount";
 #ifdef _WIN32
-		strcpy_s(tempBuffer, "executeCount");
+		sprintf_s(tempBuffer, "%d", myExecuteCount);
 #else // macOS
-		strlcpy(tempBuffer, "executeCount", sizeof(tempBuffer));
+		snprintf(tempBuffer, sizeof(tempBuffer), "%d", myExecuteCount);
 #endif
-		entries->values[0]->setString(tempBuffer);
-
-		// Set the value for the second column
+		break;
+	case INFO_ROW_FRAME_ID:
+		name = "frameId";
 #ifdef _WIN32
-		sprintf_s(tempBuffer, "%d", myExecuteCount);
+		sprintf_s(tempBuffer, "%u", meta.frameId);
 #else // macOS
-		snprintf(tempBuffer, sizeof(tempBuffer), "%d", myExecuteCount);
+		snprintf(tempBuffer, sizeof(tempBuffer), "%u", meta.frameId);
+#endif
+		break;
+	case INFO_ROW_FRAME_INDEX:
+		name = "frameIndex";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%d", meta.frameIndex);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%d", meta.frameIndex);
+#endif
+		break;
+	case INFO_ROW_DEVICE_TIMESTAMP:
+		name = "deviceTimestamp";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%llu", (unsigned long long)meta.deviceTimestamp);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%llu", (unsigned long long)meta.deviceTimestamp);
+#endif
+		break;
+	case INFO_ROW_ARRIVAL_TIME:
+		name = "arrivalTime";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%llu", (unsigned long long)meta.arrivalTime);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%llu", (unsigned long long)meta.arrivalTime);
+#endif
+		break;
+	case INFO_ROW_AGE_AT_UPLOAD_MS:
+		name = "ageAtUploadMs";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%.3f", double(myUploadAge) / 1000.0);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%.3f", double(myUploadAge) / 1000.0);
+#endif
+		break;
+	case INFO_ROW_WIDTH:
+		name = "width";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%d", meta.width);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%d", meta.width);
 #endif
-		entries->values[1]->setString(tempBuffer);
+		break;
+	case INFO_ROW_HEIGHT:
+		name = "height";
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "%d", meta.height);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "%d", meta.height);
+#endif
+		break;
+	case INFO_ROW_PIXEL_FORMAT:
+		name = "pixelFormat";
+#ifdef _WIN32
+		strcpy_s(tempBuffer, pixelFormatName(meta.pixelFormat));
+#else // macOS
+		strlcpy(tempBuffer, pixelFormatName(meta.pixelFormat), sizeof(tempBuffer));
+#endif
+		break;
+	case INFO_ROW_STREAM:
+		name = "stream";
+#ifdef _WIN32
+		strcpy_s(tempBuffer, streamTypeName(meta.streamType));
+#else // macOS
+		strlcpy(tempBuffer, streamTypeName(meta.streamType), sizeof(tempBuffer));
+#endif
+		break;
+	default:
+		return;
 	}
+
+	entries->values[0]->setString(name);
+	entries->values[1]->setString(tempBuffer);
+}
+
+void
+OrbbecAstraTOP::getWarningString(OP_String* warning, void* reserved1)
+{
+	if (!myWarning.empty())
+		warning->setString(myWarning.c_str());
 }
 
 void
@@ -491,6 +1020,539 @@ OrbbecAstraTOP::setupParameters(OP_ParameterManager* manager, void *reserved1)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Mode
+	{
+		OP_StringParameter np;
+
+		np.name = "Mode";
+		np.label = "Mode";
+
+		np.defaultValue = "Freerun";
+
+		const char* names[] = { "Freerun", "Cooksignalled", "Inline", "Adaptive" };
+		const char* labels[] = { "Free Run", "Cook Signalled", "Inline", "Adaptive" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 4, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Acquisition
+	{
+		OP_StringParameter np;
+
+		np.name = "Acquisition";
+		np.label = "Acquisition";
+
+		np.defaultValue = "Callback";
+
+		const char* names[] = { "Callback", "Poll" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &names[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Hugepages
+	{
+		OP_NumericParameter np;
+
+		np.name = "Hugepages";
+		np.label = "Huge Pages";
+
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Depthoutput
+	{
+		OP_StringParameter np;
+
+		np.name = "Depthoutput";
+		np.label = "Depth Output";
+
+		np.defaultValue = "Shaded";
+
+		const char* names[] = { "Shaded", "Normalsrgba", "Normalsrg", "Depth", "Points" };
+		const char* labels[] = { "Shaded", "Normals (RGBA16 Float)", "Octahedral Normals (RG16 Float)", "Depth (mm)", "Points (mm)" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 5, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Pixelformat, the depth, points and normals don't fit in 8 bits and are uploaded as floats
+	{
+		OP_StringParameter np;
+
+		np.name = "Pixelformat";
+		np.label = "Pixel Format";
+
+		np.defaultValue = "Rgba32float";
+
+		const char* names[] = { "Rgba8fixed", "Rgba16float", "Rgba32float" };
+		const char* labels[] = { "8-bit fixed (RGBA)", "16-bit float (RGBA)", "32-bit float (RGBA)" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 3, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Packthreads, the frame is packed for upload in bands of rows over this many threads
+	{
+		OP_NumericParameter np;
+
+		np.name = "Packthreads";
+		np.label = "Pack Threads";
+
+		np.defaultValues[0] = 4;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 16;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Normals
+	{
+		OP_StringParameter np;
+
+		np.name = "Normals";
+		np.label = "Normals From";
+
+		np.defaultValue = "Depth";
+
+		const char* names[] = { "Depth", "Points" };
+		const char* labels[] = { "Depth (Ray LUT)", "Reprojected Points" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Roiposition
+	{
+		OP_NumericParameter np;
+
+		np.name = "Roiposition";
+		np.label = "ROI Position";
+
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 0;
+			np.minSliders[i] = 0;
+			np.maxSliders[i] = 640;
+			np.minValues[i] = 0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Roisize, 0 runs to the edge of the depth
+	{
+		OP_NumericParameter np;
+
+		np.name = "Roisize";
+		np.label = "ROI Size";
+
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 0;
+			np.minSliders[i] = 0;
+			np.maxSliders[i] = 640;
+			np.minValues[i] = 0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Decimation
+	{
+		OP_NumericParameter np;
+
+		np.name = "Decimation";
+		np.label = "Decimation";
+
+		np.defaultValues[0] = 1;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 8;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Normalformat
+	{
+		OP_StringParameter np;
+
+		np.name = "Normalformat";
+		np.label = "Normal Format";
+
+		np.defaultValue = "Float";
+
+		const char* names[] = { "Float", "Octahedral" };
+		const char* labels[] = { "Float (12 bytes)", "Octahedral (4 bytes)" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Fusedshading
+	{
+		OP_NumericParameter np;
+
+		np.name = "Fusedshading";
+		np.label = "Fused Shading";
+
+		np.defaultValues[0] = 1;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Layout
+	{
+		OP_StringParameter np;
+
+		np.name = "Layout";
+		np.label = "Layout";
+
+		np.defaultValue = "Aos";
+
+		const char* names[] = { "Aos", "Soa" };
+		const char* labels[] = { "Array of Structs", "Struct of Arrays" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Normalestimator
+	{
+		OP_StringParameter np;
+
+		np.name = "Normalestimator";
+		np.label = "Normal Estimator";
+
+		np.defaultValue = "Cross";
+
+		const char* names[] = { "Cross", "Integral" };
+		const char* labels[] = { "Cross Products", "Integral Images" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Normalwindow
+	{
+		OP_NumericParameter np;
+
+		np.name = "Normalwindow";
+		np.label = "Normal Window";
+
+		np.defaultValues[0] = 9;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 41;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Depthchange, a fraction of the depth
+	{
+		OP_NumericParameter np;
+
+		np.name = "Depthchange";
+		np.label = "Depth Change Threshold";
+
+		np.defaultValues[0] = 0.02;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.2;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Normalblur
+	{
+		OP_StringParameter np;
+
+		np.name = "Normalblur";
+		np.label = "Normal Blur";
+
+		np.defaultValue = "Fast3x3";
+
+		const char* names[] = { "Fast3x3", "Box" };
+		const char* labels[] = { "3x3", "Box" };
+
+		OP_ParAppendResult res = manager->appendMenu(np, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Blurradius
+	{
+		OP_NumericParameter np;
+
+		np.name = "Blurradius";
+		np.label = "Blur Radius";
+
+		np.defaultValues[0] = 2;
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 20;
+		np.minValues[0] = 0;
+		np.maxValues[0] = LitDepthVisualizer::MaxBlurRadius;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Simdshading
+	{
+		OP_NumericParameter np;
+
+		np.name = "Simdshading";
+		np.label = "SIMD Shading";
+
+		np.defaultValues[0] = 1;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Tiledshading, the depth is lit and packed a tile at a time over the pack threads
+	{
+		OP_NumericParameter np;
+
+		np.name = "Tiledshading";
+		np.label = "Tiled Shading";
+
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Tilesize
+	{
+		OP_NumericParameter np;
+
+		np.name = "Tilesize";
+		np.label = "Tile Size";
+
+		np.defaultValues[0] = 128;
+		np.minSliders[0] = 8;
+		np.maxSliders[0] = 256;
+		np.minValues[0] = 8;
+		np.maxValues[0] = TiledDepthRenderer::MaxTileSize;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Trace
+	{
+		OP_StringParameter sp;
+
+		sp.name = "Tracefile";
+		sp.label = "Trace File";
+		sp.page = "Trace";
+
+		sp.defaultValue = "astra_trace.json";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Traceseconds";
+		np.label = "Trace Seconds";
+		np.page = "Trace";
+
+		np.defaultValues[0] = 5.0;
+		np.minSliders[0] = 0.5;
+		np.maxSliders[0] = 30.0;
+		np.minValues[0] = 0.1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Tracecapture";
+		np.label = "Capture Trace";
+		np.page = "Trace";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Record
+	{
+		OP_NumericParameter np;
+
+		np.name = "Record";
+		np.label = "Record";
+		np.page = "Record";
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+
+		sp.name = "Recordfile";
+		sp.label = "Record File";
+		sp.page = "Record";
+
+		sp.defaultValue = "astra_recording.astrarec";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Recordcompress";
+		np.label = "Compress Depth";
+		np.page = "Record";
+
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Share
+	{
+		OP_NumericParameter np;
+
+		np.name = "Share";
+		np.label = "Share";
+		np.page = "Share";
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+
+		sp.name = "Sharename";
+		sp.label = "Shared Memory Name";
+		sp.page = "Share";
+
+		sp.defaultValue = "astra0";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Shareslots";
+		np.label = "Slots";
+		np.page = "Share";
+
+		np.defaultValues[0] = 4;
+		np.minSliders[0] = 2;
+		np.maxSliders[0] = 16;
+		np.minValues[0] = 2;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Playback
+	{
+		OP_StringParameter sp;
+
+		sp.name = "Playbackfile";
+		sp.label = "Playback File";
+		sp.page = "Playback";
+
+		sp.defaultValue = "astra_recording.astrarec";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+
+		sp.name = "Playbackmode";
+		sp.label = "Playback Mode";
+		sp.page = "Playback";
+
+		sp.defaultValue = "Realtime";
+
+		const char* names[] = { "Realtime", "Fast" };
+		const char* labels[] = { "Real Time", "As Fast As Possible" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, &names[0], &labels[0]);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Playbackloop";
+		np.label = "Loop";
+		np.page = "Playback";
+
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Seekframe";
+		np.label = "Seek Frame";
+		np.page = "Playback";
+
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 1000;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+
+		np.name = "Seek";
+		np.label = "Seek";
+		np.page = "Playback";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Pulse
 	{
 		OP_NumericParameter	np;
@@ -508,6 +1570,12 @@ void
 OrbbecAstraTOP::pulsePressed(const char* name, void *reserved1)
 {
 
+	if (!strcmp(name, "Tracecapture"))
+		myTraceRequested = true;
+
+	if (!strcmp(name, "Seek"))
+		mySeekRequested = true;
+
 	if (!strcmp(name, "Reset"))
 		disconnectSensor();
 }
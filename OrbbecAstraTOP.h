@@ -16,14 +16,30 @@
 #include "FrameQueue.h"
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <chrono>
 using namespace TD;
 
 #include "astraframelistener.h"
+#include "WorkerPool.h"
 
 class OrbbecAstraTOP : public TOP_CPlusPlusBase, public AstraFrameListener
 {
 public:
 
+	// How frames get from the sensor to the TOP, selected with the 'Mode' parameter.
+	enum class ProducerMode
+	{
+		// The producer thread continually produces frames, the cook picks up the newest one.
+		FreeRun,
+		// The cook signals the producer thread to produce the next frame, giving 1:1 pairing.
+		CookSignalled,
+		// Frames are produced and uploaded synchronously inside execute(), no producer thread.
+		Inline,
+		// Switches between FreeRun and CookSignalled based on cook interval vs sensor interval.
+		Adaptive,
+	};
+
 	OrbbecAstraTOP(const OP_NodeInfo *info, TOP_Context* context);
 	virtual ~OrbbecAstraTOP();
 
@@ -33,7 +49,7 @@ public:
 							const OP_Inputs*,
 							void* reserved1) override;
 
-	void				fillBuffer(OP_SmartRef<TOP_Buffer>& mem, uint64_t byteOffset, int width, int height);
+	void				fillBuffer(OP_SmartRef<TOP_Buffer>& mem, uint64_t byteOffset, int width, int height, FramePacker::Destination destination);
 
 
 	virtual int32_t		getNumInfoCHOPChans(void *reserved1) override;
@@ -46,6 +62,8 @@ public:
 									OP_InfoDATEntries *entries,
 									void *reserved1) override;
 
+	virtual void		getWarningString(OP_String *warning, void *reserved1) override;
+
 	virtual void		setupParameters(OP_ParameterManager *manager, void *reserved1) override;
 	virtual void		pulsePressed(const char *name, void *reserved1) override;
 
@@ -60,10 +78,23 @@ public:
 
 private:
 
-	void				fillAndUpload(TOP_Output* output, double speed, int width, int height, OP_TexDim texDim, int numLayers, int colorBufferIndex);
+	void				fillAndUpload(TOP_Output* output, int width, int height, OP_TexDim texDim, int numLayers, int colorBufferIndex);
+	// Records the frame just uploaded for the Info CHOP and DAT
+	void				uploaded(const FrameMetadata& metadata);
 
 	void				startMoreWork();
 
+	void				startProducer();
+	void				stopProducer();
+	void				producerLoop();
+	void				produceFrame();
+	void				updateSensor();
+	// Whether the sensor delivered a frame since the last one produced
+	bool				claimNewFrame();
+
+	void				updateCookInterval();
+	ProducerMode		resolveProducerMode(ProducerMode requested);
+
 	// We don't need to store this pointer, but we do for the example.
 	// The OP_NodeInfo class store information about the node that's using
 	// this instance of the class (like its name).
@@ -76,8 +107,7 @@ private:
 	std::mutex			mySettingsLock;
 	// ** Add Orbbec settings ** 
 
-	// Used for threading example
-	// Search for #define THREADING_EXAMPLE to enable that example
+	// Used by the FreeRun, CookSignalled and Adaptive producer modes
 	FrameQueue			myFrameQueue;
 	std::thread*		myThread;
 	std::atomic<bool>	myThreadShouldExit;
@@ -86,6 +116,46 @@ private:
 	std::mutex			myConditionLock;
 	std::atomic<bool>	myStartWork;
 
+	// The mode the producer thread is currently running in. Never Inline or Adaptive,
+	// those are resolved in execute() before being handed to the thread.
+	std::atomic<ProducerMode>	myThreadMode;
+	ProducerMode		myAdaptiveMode;
+	uint32_t			myLastProducedFrame;
+	// Frames converted but superseded before they were produced, for framesDropped
+	std::atomic<uint64_t>	myFramesSkipped;
+
+	// Smoothed time between cooks, used by the Adaptive mode
+	std::chrono::steady_clock::time_point	myLastCookTime;
+	double				myCookInterval;
+
+	// Stats reported on the Info CHOP, taken once per cook
+	PipelineStats::Snapshot	myStatsSnapshot;
+
+	// The frame last uploaded to the TOP and how long after it arrived, for the Info DAT
+	FrameMetadata		myUploadedMetadata;
+	uint64_t			myUploadAge;
+
+	// Set by the 'Tracecapture' pulse, the capture is started in the next execute()
+	std::atomic<bool>	myTraceRequested;
+
+	// Last state of the 'Record' toggle
+	bool				myRecordEnabled;
+
+	// Name and slot count the frames are being shared with, the name is empty when 'Share' is off
+	std::string			myShareName;
+	int					myShareSlots;
+
+	// Set by the 'Seek' pulse, the playback is moved to 'Seekframe' in the next execute()
+	std::atomic<bool>	mySeekRequested;
+
+	// The 'Pixelformat' asked for, the stream may be uploaded in another, see FramePacker::resolve()
+	std::atomic<FramePacker::Destination>	myPixelFormat;
+
+	// 'Packthreads', applied to the pool by whichever thread is filling the buffers
+	std::atomic<int>	myPackThreads;
+	WorkerPool			myPackPool;
+
+	std::string			myWarning;
+
 	TOP_Context*		myContext;
-	OP_SmartRef<OP_TOPDownloadResult> myPrevDownRes;
 };
@@ -0,0 +1,132 @@
+#include "PipelineStats.h"
+
+#include <algorithm>
+
+// Stop collecting when the Info CHOP hasn't asked for this long, in microseconds
+const uint64_t ExpireTime = 2000000;
+
+PipelineStats::ScopedTimer::ScopedTimer(PipelineStats& stats, Stage stage) :
+	myStats(stats),
+	myStage(stage),
+	myBegin(stats.isEnabled() ? PipelineStats::now() : 0)
+{
+}
+
+PipelineStats::ScopedTimer::~ScopedTimer()
+{
+	if (myBegin != 0)
+		myStats.addStageTime(myStage, PipelineStats::now() - myBegin);
+}
+
+PipelineStats::PipelineStats() :
+	myEnabled(false),
+	myLastSnapshotTime(0),
+	mySensorFrames(0),
+	myDeliveredFrames(0),
+	myNumLatencies(0),
+	myNextLatency(0)
+{
+	for (int i = 0; i < NUM_STAGES; i++)
+	{
+		myStageTotal[i] = 0;
+		myStageCount[i] = 0;
+	}
+}
+
+uint64_t
+PipelineStats::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+PipelineStats::expire()
+{
+	if (isEnabled() && now() - myLastSnapshotTime > ExpireTime)
+		myEnabled.store(false);
+}
+
+void
+PipelineStats::addStageTime(Stage stage, uint64_t microseconds)
+{
+	myStageTotal[stage].fetch_add(microseconds, std::memory_order_relaxed);
+	myStageCount[stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+PipelineStats::countSensorFrame()
+{
+	mySensorFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+PipelineStats::countDeliveredFrame(uint64_t arrivalTime)
+{
+	myDeliveredFrames++;
+
+	if (!isEnabled() || arrivalTime == 0)
+		return;
+
+	myLatencies[myNextLatency] = now() - arrivalTime;
+	myNextLatency = (myNextLatency + 1) % LatencyWindow;
+	myNumLatencies = std::min(myNumLatencies + 1, LatencyWindow);
+}
+
+PipelineStats::Snapshot
+PipelineStats::takeSnapshot(int queueDepth, uint64_t framesDropped)
+{
+	// Latencies recorded before collection was last switched off are stale
+	if (!isEnabled())
+	{
+		myNumLatencies = 0;
+		myNextLatency = 0;
+	}
+
+	Snapshot snap;
+	snap.queueDepth = queueDepth;
+	snap.framesDropped = framesDropped;
+
+	const uint64_t time = now();
+	const uint64_t sensorFrames = mySensorFrames.exchange(0);
+	const uint64_t deliveredFrames = myDeliveredFrames;
+	myDeliveredFrames = 0;
+
+	// The first snapshot after collection was off covers an unknown span, so report no rates
+	if (isEnabled() && time > myLastSnapshotTime)
+	{
+		const double seconds = double(time - myLastSnapshotTime) / 1000000.0;
+		snap.sensorFps = double(sensorFrames) / seconds;
+		snap.deliveredFps = double(deliveredFrames) / seconds;
+	}
+
+	for (int i = 0; i < NUM_STAGES; i++)
+	{
+		// A sample landing between these two exchanges is attributed to the next snapshot,
+		// which skews a single reading by at most one sample.
+		const uint64_t count = myStageCount[i].exchange(0);
+		const uint64_t total = myStageTotal[i].exchange(0);
+		if (count > 0)
+			snap.stageMs[i] = double(total) / double(count) / 1000.0;
+	}
+
+	if (myNumLatencies > 0)
+	{
+		uint64_t sorted[LatencyWindow];
+		std::copy(myLatencies, myLatencies + myNumLatencies, sorted);
+
+		uint64_t total = 0;
+		for (int i = 0; i < myNumLatencies; i++)
+			total += sorted[i];
+		snap.latencyMeanMs = double(total) / double(myNumLatencies) / 1000.0;
+
+		const int p99 = (myNumLatencies * 99) / 100;
+		std::nth_element(sorted, sorted + p99, sorted + myNumLatencies);
+		snap.latencyP99Ms = double(sorted[p99]) / 1000.0;
+	}
+
+	myLastSnapshotTime = time;
+	myEnabled.store(true);
+
+	return snap;
+}
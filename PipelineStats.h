@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Per-stage timing and throughput counters for the frame pipeline, reported on the Info CHOP.
+//
+// Collection is only switched on while something reads the stats. takeSnapshot() enables it,
+// and expire() (called every cook) disables it again once nobody has asked for a while. While
+// disabled the instrumented code pays for a single relaxed atomic load per stage.
+class PipelineStats
+{
+public:
+	enum Stage
+	{
+		STAGE_UPDATE,		// FrameSource::update()
+		STAGE_CONVERT,		// Stream conversion in on_frame_ready, including STAGE_VISUALIZE
+		STAGE_VISUALIZE,	// LitDepthVisualizer::update(), not with tiled shading
+		STAGE_FILL,			// OrbbecAstraTOP::fillBuffer(), with tiled shading's lighting too
+		STAGE_UPLOAD,		// TOP_Output::uploadBuffer()
+		NUM_STAGES
+	};
+
+	class Snapshot
+	{
+	public:
+		double		sensorFps = 0.0;
+		double		deliveredFps = 0.0;
+		uint64_t	framesDropped = 0;
+		int			queueDepth = 0;
+
+		// Mean time spent in each stage since the previous snapshot
+		double		stageMs[NUM_STAGES] = {};
+
+		// Host arrival of the frame in on_frame_ready until it was uploaded
+		double		latencyMeanMs = 0.0;
+		double		latencyP99Ms = 0.0;
+	};
+
+	// Times the enclosing scope into a stage, if collection is enabled
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(PipelineStats& stats, Stage stage);
+		~ScopedTimer();
+
+	private:
+		PipelineStats&	myStats;
+		Stage			myStage;
+		uint64_t		myBegin;
+	};
+
+	PipelineStats();
+
+	// Steady clock in microseconds, the time base for everything in the pipeline
+	static uint64_t		now();
+
+	bool				isEnabled() const { return myEnabled.load(std::memory_order_relaxed); }
+
+	// Disables collection when no snapshot has been taken for a while
+	void				expire();
+
+	// These can be called from any thread
+	void				addStageTime(Stage stage, uint64_t microseconds);
+	void				countSensorFrame();
+
+	// These must be called from the main thread
+	void				countDeliveredFrame(uint64_t arrivalTime);
+	Snapshot			takeSnapshot(int queueDepth, uint64_t framesDropped);
+
+private:
+	static const int	LatencyWindow = 512;
+
+	std::atomic<bool>		myEnabled;
+	uint64_t				myLastSnapshotTime;
+
+	std::atomic<uint64_t>	myStageTotal[NUM_STAGES];
+	std::atomic<uint64_t>	myStageCount[NUM_STAGES];
+
+	std::atomic<uint64_t>	mySensorFrames;
+	uint64_t				myDeliveredFrames;
+
+	// Ring of the most recent frame latencies in microseconds
+	uint64_t				myLatencies[LatencyWindow];
+	int						myNumLatencies;
+	int						myNextLatency;
+};
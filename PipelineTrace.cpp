@@ -0,0 +1,257 @@
+#include "PipelineTrace.h"
+#include "PipelineStats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+PipelineTrace::Scope::Scope(const char* name, uint32_t frameId) :
+	myName(name),
+	myFrameId(frameId),
+	myBegin(PipelineTrace::instance().isRecording() ? PipelineStats::now() : 0)
+{
+}
+
+PipelineTrace::Scope::~Scope()
+{
+	if (myBegin != 0)
+		PipelineTrace::instance().addEvent(myName, myBegin, PipelineStats::now(), myFrameId);
+}
+
+PipelineTrace::RingHandle::~RingHandle()
+{
+	if (ring)
+	{
+		std::lock_guard<std::mutex> lock(PipelineTrace::instance().myRingsLock);
+		ring->inUse = false;
+	}
+}
+
+PipelineTrace&
+PipelineTrace::instance()
+{
+	static PipelineTrace trace;
+	return trace;
+}
+
+PipelineTrace::PipelineTrace() :
+	myRecording(false),
+	myGeneration(0),
+	myEndTime(0),
+	myWriteFailed(false)
+{
+}
+
+PipelineTrace::~PipelineTrace()
+{
+	waitForWrite();
+}
+
+void
+PipelineTrace::start(double seconds, const std::string& path)
+{
+	myRecording.store(false);
+
+	myPath = path;
+	myEndTime = PipelineStats::now() + uint64_t(seconds * 1000000.0);
+
+	// Rings notice the new generation and reset themselves on their next event
+	myGeneration++;
+	myRecording.store(true);
+}
+
+bool
+PipelineTrace::update()
+{
+	if (!isRecording() || PipelineStats::now() < myEndTime)
+		return !myWriteFailed.exchange(false);
+
+	myRecording.store(false);
+
+	// Copied out under the lock, formatted and written without it
+	std::vector<RingSnapshot> rings = snapshot();
+
+	waitForWrite();
+	myWriter = std::thread([this, rings, path = myPath]() {
+		if (!write(rings, path))
+			myWriteFailed.store(true);
+	});
+	return true;
+}
+
+void
+PipelineTrace::waitForWrite()
+{
+	if (myWriter.joinable())
+		myWriter.join();
+}
+
+void
+PipelineTrace::setThreadName(const char* name)
+{
+	ThreadRing* ring = threadRing();
+#ifdef _WIN32
+	strncpy_s(ring->threadName, name, _TRUNCATE);
+#else // macOS
+	strlcpy(ring->threadName, name, sizeof(ring->threadName));
+#endif
+}
+
+void
+PipelineTrace::addEvent(const char* name, uint64_t begin, uint64_t end, uint32_t frameId)
+{
+	if (!isRecording())
+		return;
+
+	push(Event{ name, begin, end - begin, frameId, false });
+}
+
+void
+PipelineTrace::addInstant(const char* name, uint32_t frameId)
+{
+	if (!isRecording())
+		return;
+
+	push(Event{ name, PipelineStats::now(), 0, frameId, true });
+}
+
+PipelineTrace::ThreadRing*
+PipelineTrace::threadRing()
+{
+	thread_local RingHandle handle;
+
+	if (!handle.ring)
+	{
+		std::lock_guard<std::mutex> lock(myRingsLock);
+
+		// Reuse the ring of a thread that has exited, producer threads come and go
+		// whenever the TOP's Mode changes. Rings still holding events for the running
+		// capture are left alone until it has been written.
+		const uint32_t generation = myGeneration.load();
+		for (auto& ring : myRings)
+		{
+			if (!ring->inUse && (!isRecording() || ring->generation.load() != generation))
+			{
+				handle.ring = ring.get();
+				break;
+			}
+		}
+
+		if (!handle.ring)
+		{
+			myRings.push_back(std::unique_ptr<ThreadRing>(new ThreadRing()));
+			handle.ring = myRings.back().get();
+			handle.ring->threadId = (uint32_t)myRings.size();
+		}
+
+		handle.ring->inUse = true;
+		handle.ring->threadName[0] = '\0';
+		handle.ring->generation.store(0);
+		handle.ring->count.store(0);
+	}
+
+	return handle.ring;
+}
+
+void
+PipelineTrace::push(const Event& event)
+{
+	ThreadRing* ring = threadRing();
+
+	// Only this thread writes to its ring, so these don't need to be atomic read-modify-writes
+	const uint32_t generation = myGeneration.load(std::memory_order_relaxed);
+	if (ring->generation.load(std::memory_order_relaxed) != generation)
+	{
+		ring->generation.store(generation, std::memory_order_relaxed);
+		ring->count.store(0, std::memory_order_relaxed);
+	}
+
+	const uint32_t count = ring->count.load(std::memory_order_relaxed);
+	ring->events[count % RingCapacity] = event;
+	ring->count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<PipelineTrace::RingSnapshot>
+PipelineTrace::snapshot()
+{
+	const uint32_t generation = myGeneration.load();
+
+	std::vector<RingSnapshot> snapshots;
+
+	std::lock_guard<std::mutex> lock(myRingsLock);
+	for (auto& ring : myRings)
+	{
+		if (ring->generation.load() != generation)
+			continue;
+
+		const uint32_t count = ring->count.load(std::memory_order_acquire);
+		const uint32_t begin = count - std::min(count, RingCapacity);
+
+		RingSnapshot snapshot;
+		snapshot.threadId = ring->threadId;
+		snapshot.threadName = ring->threadName;
+		for (uint32_t i = begin; i != count; i++)
+			snapshot.events.push_back(ring->events[i % RingCapacity]);
+
+		// A thread that saw the capture running just before it stopped may still be pushing,
+		// over the oldest events of a full ring. Any it could have reached are left out.
+		const uint32_t after = ring->count.load(std::memory_order_acquire);
+		if (after - begin >= RingCapacity)
+		{
+			const size_t overwritten = std::min(size_t(after - begin - RingCapacity + 1), snapshot.events.size());
+			snapshot.events.erase(snapshot.events.begin(), snapshot.events.begin() + overwritten);
+		}
+
+		snapshots.push_back(std::move(snapshot));
+	}
+
+	return snapshots;
+}
+
+bool
+PipelineTrace::write(const std::vector<RingSnapshot>& rings, const std::string& path)
+{
+	FILE* file = nullptr;
+#ifdef _WIN32
+	fopen_s(&file, path.c_str(), "w");
+#else // macOS
+	file = fopen(path.c_str(), "w");
+#endif
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+
+	for (const RingSnapshot& ring : rings)
+	{
+		if (!ring.threadName.empty())
+		{
+			fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", ring.threadId, ring.threadName.c_str());
+			first = false;
+		}
+
+		for (const Event& e : ring.events)
+		{
+			if (!e.instant)
+			{
+				fprintf(file, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu,\"args\":{\"frame\":%u}}",
+					first ? "" : ",\n", e.name, ring.threadId,
+					(unsigned long long)e.begin, (unsigned long long)e.duration, e.frameId);
+			}
+			else
+			{
+				fprintf(file, "%s{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{\"frame\":%u}}",
+					first ? "" : ",\n", e.name, ring.threadId,
+					(unsigned long long)e.begin, e.frameId);
+			}
+			first = false;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
\ No newline at end of file
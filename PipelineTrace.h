@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Captures a bounded window of timestamped pipeline events and writes them out in the
+// Chrome trace / Perfetto JSON format (load the file in ui.perfetto.dev or chrome://tracing).
+//
+// Every thread that records events gets its own fixed size ring, so recording is a couple
+// of plain stores and a release store with no locks or allocation. When more events arrive
+// than a ring holds, the oldest ones are overwritten. While no capture is running recording
+// an event costs a single relaxed atomic load.
+//
+// The trace is process wide, so a capture started from one TOP also records the events of
+// any other instance running at the same time.
+//
+// When a capture ends its events are copied out of the rings and written to the file on a
+// thread of its own, so neither the cook nor threads recording their first event wait on it.
+class PipelineTrace
+{
+public:
+	// Records the time the enclosing scope took as a single trace event
+	class Scope
+	{
+	public:
+		Scope(const char* name, uint32_t frameId);
+		~Scope();
+
+	private:
+		const char*		myName;
+		uint32_t		myFrameId;
+		uint64_t		myBegin;
+	};
+
+	static PipelineTrace&	instance();
+
+	// Starts a new capture, discarding any events from the previous one
+	void				start(double seconds, const std::string& path);
+
+	// Call this regularly from the main thread. Once the capture window has elapsed the
+	// capture is stopped and written out to the file passed to start() in the background.
+	// Returns false once, on the first call after writing the file failed.
+	bool				update();
+
+	// Waits for the capture being written, if there is one. Call it before the plugin is
+	// unloaded, joining a thread then can deadlock.
+	void				waitForWrite();
+
+	bool				isRecording() const { return myRecording.load(std::memory_order_relaxed); }
+
+	// Names the calling thread in the trace
+	void				setThreadName(const char* name);
+
+	// 'name' must be a string literal, only the pointer is stored.
+	// Times are PipelineStats::now() microseconds.
+	void				addEvent(const char* name, uint64_t begin, uint64_t end, uint32_t frameId);
+	void				addInstant(const char* name, uint32_t frameId);
+
+private:
+	static const uint32_t	RingCapacity = 16384;
+
+	class Event
+	{
+	public:
+		const char*		name;
+		uint64_t		begin;
+		uint64_t		duration;
+		uint32_t		frameId;
+		bool			instant;
+	};
+
+	class ThreadRing
+	{
+	public:
+		uint32_t				threadId = 0;
+		bool					inUse = false;
+		char					threadName[32] = {};
+
+		// Capture this ring's events belong to, rings reset themselves when a new one starts.
+		// Only the ring's thread changes it, but write() reads it.
+		std::atomic<uint32_t>	generation{ 0 };
+		// Total events recorded this capture, the ring holds the last RingCapacity of them
+		std::atomic<uint32_t>	count{ 0 };
+		Event					events[RingCapacity];
+	};
+
+	// Hands a thread's ring back to the pool when the thread exits
+	class RingHandle
+	{
+	public:
+		~RingHandle();
+
+		ThreadRing*		ring = nullptr;
+	};
+
+	// The events of one ring as they were when the capture ended
+	class RingSnapshot
+	{
+	public:
+		uint32_t			threadId;
+		std::string			threadName;
+		std::vector<Event>	events;
+	};
+
+	PipelineTrace();
+	~PipelineTrace();
+
+	ThreadRing*			threadRing();
+	void				push(const Event& event);
+	std::vector<RingSnapshot>	snapshot();
+	static bool			write(const std::vector<RingSnapshot>& rings, const std::string& path);
+
+	std::atomic<bool>		myRecording;
+	std::atomic<uint32_t>	myGeneration;
+	uint64_t				myEndTime;
+	std::string				myPath;
+
+	std::mutex				myRingsLock;
+	std::vector<std::unique_ptr<ThreadRing>>	myRings;
+
+	std::thread				myWriter;
+	std::atomic<bool>		myWriteFailed;
+};
@@ -0,0 +1,302 @@
+#include "PlaybackFrameSource.h"
+#include "DepthCodec.h"
+
+#include <string.h>
+#include <algorithm>
+
+const char* const PlaybackPrefix = "playback:";
+
+// When playback falls further behind the recording than this it stops trying to catch up,
+// rather than delivering a burst of frames
+const auto MaxPacingLag = std::chrono::milliseconds(250);
+
+bool PlaybackFrameSource::isPlayback(const char* device)
+{
+	return !strncmp(device, PlaybackPrefix, strlen(PlaybackPrefix));
+}
+
+PlaybackFrameSource::PlaybackFrameSource(const char* device) :
+	streams(STREAM_DEPTH | STREAM_COLOR | STREAM_IR_16 | STREAM_IR_RGB)
+{
+	memset(&header, 0, sizeof(header));
+
+	const std::string path = device + strlen(PlaybackPrefix);
+	if (!open(path))
+		file.close();
+}
+
+void PlaybackFrameSource::setRealtime(bool r)
+{
+	realtime.store(r);
+}
+
+void PlaybackFrameSource::setLoop(bool l)
+{
+	loop.store(l);
+}
+
+void PlaybackFrameSource::seek(int frame)
+{
+	seekRequest.store(std::max(0, frame));
+}
+
+// Out of real time every update() delivers a frame, so there's nothing to wait between them
+// for. Once a recording that doesn't loop has run out it goes back to being polled.
+bool PlaybackFrameSource::waitsForFrames() const
+{
+	if (realtime.load() || frames.empty())
+		return false;
+
+	return loop.load() || currentFrame.load() < getFrameCount();
+}
+
+void PlaybackFrameSource::setStreams(uint32_t s)
+{
+	streams.store(s);
+}
+
+void PlaybackFrameSource::getFieldOfView(float& hFov, float& vFov) const
+{
+	hFov = header.hFov;
+	vFov = header.vFov;
+}
+
+void PlaybackFrameSource::update()
+{
+	const int frameCount = getFrameCount();
+	if (frameCount == 0)
+		return;
+
+	const int seekTo = seekRequest.exchange(-1);
+	if (seekTo >= 0){
+		currentFrame.store(std::min(seekTo, frameCount - 1));
+		pacing = false;
+	}
+
+	int frame = currentFrame.load();
+	if (frame >= frameCount){
+		if (!loop.load())
+			return;
+
+		frame = 0;
+		pacing = false;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+
+	if (realtime.load()){
+		if (!pacing){
+			pacing = true;
+			pacingFrame = frame;
+			pacingStart = now;
+		}
+		else{
+			const uint64_t begin = frames[pacingFrame].time;
+			const uint64_t time = std::max(frames[frame].time, begin);
+			const auto due = pacingStart + std::chrono::microseconds(time - begin);
+
+			if (now < due)
+				return;
+
+			if (now - due > MaxPacingLag){
+				pacingFrame = frame;
+				pacingStart = now;
+			}
+		}
+	}
+	else{
+		pacing = false;
+	}
+
+	deliver(frame);
+	currentFrame.store(frame + 1);
+}
+
+bool PlaybackFrameSource::open(const std::string& path)
+{
+	if (!file.open(path)){
+		error = "Unable to open playback file " + path;
+		return false;
+	}
+
+	if (file.size() < sizeof(RecordingHeader)){
+		error = "Not a recording: " + path;
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+
+	if (memcmp(header.magic, RecordingMagic, sizeof(header.magic)) != 0 ||
+		header.headerSize < sizeof(RecordingHeader) || header.headerSize > file.size()){
+		error = "Not a recording: " + path;
+		return false;
+	}
+
+	if (header.version > RecordingVersion){
+		error = "Recording was made by a newer version: " + path;
+		return false;
+	}
+
+	// Recordings that weren't stopped cleanly have no index
+	if (!readIndex() && !scanFrames()){
+		error = "Recording has no frames: " + path;
+		return false;
+	}
+
+	// Pace by the device clock only if every frame has a device timestamp
+	bool deviceTimes = true;
+	for (const FrameEntry& entry : frames)
+		deviceTimes &= entry.time != 0;
+
+	if (!deviceTimes){
+		for (FrameEntry& entry : frames){
+			RecordingFrameHeader frameHeader;
+			memcpy(&frameHeader, file.data() + entry.offset, sizeof(frameHeader));
+			entry.time = frameHeader.arrivalTime;
+		}
+	}
+
+	return true;
+}
+
+bool PlaybackFrameSource::readIndex()
+{
+	frames.clear();
+
+	const uint64_t indexSize = header.numFrames * sizeof(RecordingIndexEntry);
+	if (header.indexOffset == 0 || header.numFrames == 0 ||
+		header.indexOffset > file.size() || indexSize > file.size() - header.indexOffset)
+		return false;
+
+	const uint8_t* index = file.data() + header.indexOffset;
+	for (uint64_t i = 0; i < header.numFrames; i++){
+		RecordingIndexEntry entry;
+		memcpy(&entry, index + i * sizeof(entry), sizeof(entry));
+
+		if (entry.offset < header.headerSize || entry.offset + sizeof(RecordingFrameHeader) > header.indexOffset){
+			frames.clear();
+			return false;
+		}
+
+		frames.push_back(FrameEntry{ entry.offset, entry.timestamp });
+	}
+
+	return true;
+}
+
+bool PlaybackFrameSource::scanFrames()
+{
+	frames.clear();
+
+	uint64_t offset = header.headerSize;
+	while (offset + sizeof(RecordingFrameHeader) <= file.size()){
+		RecordingFrameHeader frameHeader;
+		memcpy(&frameHeader, file.data() + offset, sizeof(frameHeader));
+
+		// Stops at the index, or at a frame that was only partly written
+		if (frameHeader.magic != RecordingFrameMagic || frameHeader.frameSize < sizeof(frameHeader) ||
+			frameHeader.frameSize > file.size() - offset)
+			break;
+
+		frames.push_back(FrameEntry{ offset, frameHeader.timestamp });
+		offset += frameHeader.frameSize;
+	}
+
+	return !frames.empty();
+}
+
+template<typename T>
+static void setView(const RecordingChunkHeader& chunk, const uint8_t* data, FrameView<T>& view, uint32_t stream, FrameSet& frameSet)
+{
+	// Only the raw encoding can be served in place
+	if (chunk.encoding != RECORDING_ENCODING_RAW ||
+		chunk.rawSize != uint64_t(chunk.width) * chunk.height * sizeof(T) || chunk.dataSize != chunk.rawSize)
+		return;
+
+	view.data = (const T*)data;
+	view.width = chunk.width;
+	view.height = chunk.height;
+	view.frameIndex = chunk.frameIndex;
+
+	frameSet.streams |= stream;
+}
+
+void PlaybackFrameSource::deliver(int frame)
+{
+	const uint64_t offset = frames[frame].offset;
+
+	RecordingFrameHeader frameHeader;
+	memcpy(&frameHeader, file.data() + offset, sizeof(frameHeader));
+	if (frameHeader.magic != RecordingFrameMagic)
+		return;
+
+	const uint64_t frameEnd = std::min(offset + frameHeader.frameSize, file.size());
+
+	FrameSet frameSet;
+	frameSet.timestamp = frameHeader.timestamp;
+
+	// Like a live source, nothing is done for the streams no one asked for. Skipping the
+	// depth saves decoding it when it's compressed.
+	const uint32_t wanted = streams.load();
+
+	uint64_t chunkOffset = offset + sizeof(RecordingFrameHeader);
+	for (uint32_t i = 0; i < frameHeader.numChunks; i++){
+		if (chunkOffset + sizeof(RecordingChunkHeader) > frameEnd)
+			break;
+
+		RecordingChunkHeader chunk;
+		memcpy(&chunk, file.data() + chunkOffset, sizeof(chunk));
+
+		const uint64_t dataOffset = chunkOffset + sizeof(RecordingChunkHeader);
+		if (chunk.magic != RecordingChunkMagic || chunk.dataSize > frameEnd - dataOffset)
+			break;
+
+		const uint8_t* data = file.data() + dataOffset;
+		chunkOffset = dataOffset + recordingAlign(chunk.dataSize);
+
+		if ((chunk.stream & wanted) == 0)
+			continue;
+
+		switch (chunk.stream){
+		case STREAM_DEPTH:
+			if (chunk.encoding == RECORDING_ENCODING_DEPTH_DELTA)
+				decodeDepth(chunk, data, frameSet);
+			else
+				setView(chunk, data, frameSet.depth, STREAM_DEPTH, frameSet);
+			break;
+		case STREAM_COLOR:
+			setView(chunk, data, frameSet.color, STREAM_COLOR, frameSet);
+			break;
+		case STREAM_IR_16:
+			setView(chunk, data, frameSet.ir16, STREAM_IR_16, frameSet);
+			break;
+		case STREAM_IR_RGB:
+			setView(chunk, data, frameSet.irRgb, STREAM_IR_RGB, frameSet);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (listener)
+		listener->on_frame_ready(frameSet);
+}
+
+void PlaybackFrameSource::decodeDepth(const RecordingChunkHeader& chunk, const uint8_t* data, FrameSet& frameSet)
+{
+	const size_t pixels = size_t(chunk.width) * chunk.height;
+	if (chunk.rawSize != pixels * sizeof(int16_t))
+		return;
+
+	depth.resize(pixels);
+	if (!DepthCodec::decode(data, size_t(chunk.dataSize), depth.data(), chunk.width, chunk.height))
+		return;
+
+	FrameView<int16_t>& view = frameSet.depth;
+	view.data = depth.data();
+	view.width = chunk.width;
+	view.height = chunk.height;
+	view.frameIndex = chunk.frameIndex;
+
+	frameSet.streams |= STREAM_DEPTH;
+}
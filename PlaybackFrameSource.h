@@ -0,0 +1,82 @@
+#ifndef PLAYBACKFRAMESOURCE_H
+#define PLAYBACKFRAMESOURCE_H
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include "RecordingFormat.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Plays back a recording made by FrameRecorder, selected with a Device of "playback:<file>".
+//
+// The file is memory mapped and the frames are delivered as views straight into the
+// mapping, so playback exercises the conversion path just like a live sensor does.
+// Compressed depth is decoded into a buffer owned by the source.
+//
+// In real time mode frames are paced by their recorded timestamps, otherwise every update()
+// delivers the next frame, for running the pipeline as fast as it can go.
+class PlaybackFrameSource : public FrameSource
+{
+public:
+	static bool isPlayback(const char* device);
+
+	PlaybackFrameSource(const char* device);
+
+	// Empty if the recording was opened, otherwise why it couldn't be
+	const std::string& getError() const { return error; }
+
+	int getFrameCount() const { return int(frames.size()); }
+	// The frame that will be delivered next
+	int getCurrentFrame() const { return currentFrame.load(); }
+
+	// These can be called from any thread
+	void setRealtime(bool realtime);
+	void setLoop(bool loop);
+	void seek(int frame);
+
+	virtual void setStreams(uint32_t streams) override;
+
+	virtual void update() override;
+	virtual bool waitsForFrames() const override;
+	virtual void getFieldOfView(float& hFov, float& vFov) const override;
+
+protected:
+	struct FrameEntry
+	{
+		uint64_t offset;
+		// Recorded time in microseconds used for pacing, the device timestamp when there is one
+		uint64_t time;
+	};
+
+	bool open(const std::string& path);
+	bool readIndex();
+	bool scanFrames();
+
+	void deliver(int frame);
+	void decodeDepth(const RecordingChunkHeader& chunk, const uint8_t* data, FrameSet& frameSet);
+
+	std::string error;
+
+	MappedFile file;
+	RecordingHeader header;
+	std::vector<FrameEntry> frames;
+
+	std::atomic<bool> realtime{ true };
+	std::atomic<bool> loop{ true };
+	std::atomic<int> seekRequest{ -1 };
+	std::atomic<uint32_t> streams;
+
+	std::atomic<int> currentFrame{ 0 };
+
+	// Wall clock time frame 'pacingFrame' was (or would have been) delivered
+	bool pacing{ false };
+	int pacingFrame{ 0 };
+	std::chrono::steady_clock::time_point pacingStart;
+
+	std::vector<int16_t> depth;
+};
+
+#endif // PLAYBACKFRAMESOURCE_H
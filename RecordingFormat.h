@@ -0,0 +1,116 @@
+#ifndef RECORDINGFORMAT_H
+#define RECORDINGFORMAT_H
+
+#include <cstdint>
+
+// On-disk layout of a recording made by FrameRecorder:
+//
+//   RecordingHeader
+//   for each frame:
+//     RecordingFrameHeader
+//     for each stream in the frame: RecordingChunkHeader, then the chunk's data
+//   RecordingIndexEntry for each frame
+//
+// Values are stored little endian. Every header and all chunk data start on a
+// RecordingAlignment boundary, so a memory mapped recording can be read in place.
+//
+// The index and the stream modes in the header are only filled in when the recording is
+// stopped. A recording that was cut short has an indexOffset of 0, its frames can still be
+// found by walking them from the start using frameSize.
+
+const uint32_t RecordingAlignment = 64;
+const uint32_t RecordingVersion = 1;
+const char RecordingMagic[8] = { 'A', 'S', 'T', 'R', 'R', 'E', 'C', '1' };
+
+const uint32_t RecordingFrameMagic = 0x454D5246;	// "FRME"
+const uint32_t RecordingChunkMagic = 0x4B4E4843;	// "CHNK"
+
+const int RecordingMaxStreams = 8;
+
+enum RecordingEncoding
+{
+	RECORDING_ENCODING_RAW = 0,
+	RECORDING_ENCODING_DEPTH_DELTA = 1,		// 16-bit depth compressed with DepthCodec
+};
+
+struct RecordingStreamMode
+{
+	uint32_t stream;			// FrameSource::StreamFlags
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelFormat;		// astra_pixel_format_t
+};
+
+struct RecordingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;		// The first frame starts here
+
+	// Field of view of the depth camera in radians, to rebuild points from depth
+	float hFov;
+	float vFov;
+
+	uint64_t indexOffset;		// 0 if the recording wasn't stopped cleanly
+	uint64_t numFrames;
+
+	// Mode of each stream when it first appeared in the recording
+	uint32_t numStreams;
+	uint32_t reserved0;
+	RecordingStreamMode streams[RecordingMaxStreams];
+
+	uint8_t reserved[16];
+};
+
+struct RecordingFrameHeader
+{
+	uint32_t magic;
+	uint32_t frameNumber;		// Position in the recording, starting at 0
+	uint32_t streams;			// FrameSource::StreamFlags of the chunks that follow
+	uint32_t numChunks;
+
+	uint64_t timestamp;			// FrameSet::timestamp
+	uint64_t arrivalTime;		// Host PipelineStats::now() when the frame arrived
+
+	// Bytes from the start of this header to the next frame
+	uint64_t frameSize;
+
+	uint8_t reserved[24];
+};
+
+struct RecordingChunkHeader
+{
+	uint32_t magic;
+	uint32_t stream;			// One of FrameSource::StreamFlags
+	int32_t frameIndex;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelFormat;		// astra_pixel_format_t
+	uint32_t encoding;			// RecordingEncoding
+	uint32_t reserved0;
+
+	uint64_t rawSize;			// Bytes of the image once decoded
+	uint64_t dataSize;			// Bytes stored after this header, not counting the padding
+
+	uint8_t reserved[16];
+};
+
+struct RecordingIndexEntry
+{
+	uint64_t offset;			// Of the frame's RecordingFrameHeader
+	uint64_t timestamp;
+	uint64_t arrivalTime;
+	uint32_t frameNumber;
+	uint32_t streams;
+};
+
+static_assert(sizeof(RecordingHeader) % RecordingAlignment == 0, "RecordingHeader must keep frames aligned");
+static_assert(sizeof(RecordingFrameHeader) == RecordingAlignment, "RecordingFrameHeader must keep chunks aligned");
+static_assert(sizeof(RecordingChunkHeader) == RecordingAlignment, "RecordingChunkHeader must keep data aligned");
+
+inline uint64_t recordingAlign(uint64_t size)
+{
+	return (size + RecordingAlignment - 1) & ~uint64_t(RecordingAlignment - 1);
+}
+
+#endif // RECORDINGFORMAT_H
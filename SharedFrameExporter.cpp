@@ -0,0 +1,187 @@
+#include "SharedFrameExporter.h"
+
+#include <string.h>
+
+// A ring name that's still held by readers of an earlier export is skipped
+static const int MaxRingAttempts = 16;
+
+template<typename T>
+static uint64_t imageSize(const FrameView<T>& view)
+{
+	return view.is_valid() ? sharedFrameAlign(uint64_t(view.width) * view.height * sizeof(T)) : 0;
+}
+
+SharedFrameExporter::SharedFrameExporter()
+{
+}
+
+SharedFrameExporter::~SharedFrameExporter()
+{
+	stop();
+}
+
+void SharedFrameExporter::start(const std::string& n, int slots)
+{
+	stop();
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	name = n;
+	numSlots = slots < 2 ? 2 : slots;
+	generation = 0;
+	sequence = 0;
+
+	framesPublished.store(0);
+	error.store(false);
+
+	if (!directory.create(name, sizeof(SharedFrameDirectory), false)){
+		error.store(true);
+		return;
+	}
+
+	SharedFrameDirectory* header = (SharedFrameDirectory*)directory.data();
+
+	// Readers from an earlier export may still have this mapped, so the generation they're
+	// watching is left alone until there's a ring to move them to
+	memcpy(header->magic, SharedFrameDirectoryMagic, sizeof(header->magic));
+	header->version = SharedFrameVersion;
+	header->generation.store(0, std::memory_order_release);
+
+	exporting.store(true);
+}
+
+void SharedFrameExporter::stop()
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	exporting.store(false);
+
+	if (directory.isOpen())
+		((SharedFrameDirectory*)directory.data())->generation.store(0, std::memory_order_release);
+
+	closeRing();
+	directory.close();
+}
+
+uint64_t SharedFrameExporter::getFramesPublished() const
+{
+	return framesPublished.load();
+}
+
+bool SharedFrameExporter::hasError() const
+{
+	return error.load();
+}
+
+void SharedFrameExporter::publish(const FrameSet& frames, uint64_t arrivalTime)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (!exporting.load() || error.load())
+		return;
+
+	const uint64_t required = sizeof(SharedFrameSlot) + imageSize(frames.depth) + imageSize(frames.color) +
+							  imageSize(frames.ir16) + imageSize(frames.irRgb);
+
+	if (!ring.isOpen() || required > slotSize){
+		if (!createRing(required)){
+			error.store(true);
+			return;
+		}
+	}
+
+	SharedFrameRingHeader* header = (SharedFrameRingHeader*)ring.data();
+
+	// Sequences carry on across rings, so readers waiting for a newer frame keep working
+	sequence++;
+	SharedFrameSlot* slot = (SharedFrameSlot*)(ring.data() + header->headerSize + ((sequence - 1) % numSlots) * slotSize);
+
+	// Odd while the slot is being written, readers holding its last frame see the change
+	const uint64_t slotLock = slot->lock.load(std::memory_order_relaxed);
+	slot->lock.store(slotLock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot->sequence = sequence;
+	slot->timestamp = frames.timestamp;
+	slot->arrivalTime = arrivalTime;
+	slot->streams = 0;
+	slot->numImages = 0;
+
+	uint64_t offset = sizeof(SharedFrameSlot);
+	writeImage(frames.depth, SHARED_FRAME_DEPTH, ASTRA_PIXEL_FORMAT_DEPTH_MM, slot, offset);
+	writeImage(frames.color, SHARED_FRAME_COLOR, ASTRA_PIXEL_FORMAT_RGB888, slot, offset);
+	writeImage(frames.ir16, SHARED_FRAME_IR_16, ASTRA_PIXEL_FORMAT_GRAY16, slot, offset);
+	writeImage(frames.irRgb, SHARED_FRAME_IR_RGB, ASTRA_PIXEL_FORMAT_RGB888, slot, offset);
+
+	slot->lock.store(slotLock + 2, std::memory_order_release);
+	header->latestSequence.store(sequence, std::memory_order_release);
+
+	framesPublished++;
+}
+
+template<typename T>
+void SharedFrameExporter::writeImage(const FrameView<T>& view, uint32_t stream, uint32_t pixelFormat, SharedFrameSlot* slot, uint64_t& offset)
+{
+	if (!view.is_valid())
+		return;
+
+	SharedFrameImage& image = slot->images[slot->numImages++];
+	image.stream = stream;
+	image.pixelFormat = pixelFormat;
+	image.width = view.width;
+	image.height = view.height;
+	image.bytesPerPixel = sizeof(T);
+	image.reserved0 = 0;
+	image.offset = offset;
+
+	const size_t byteLength = size_t(view.width) * view.height * sizeof(T);
+	memcpy((uint8_t*)slot + offset, view.data, byteLength);
+
+	slot->streams |= stream;
+	offset += sharedFrameAlign(byteLength);
+}
+
+bool SharedFrameExporter::createRing(uint64_t size)
+{
+	// Readers drop the old ring, and don't pick up the new one until its size is written
+	SharedFrameDirectory* directoryHeader = (SharedFrameDirectory*)directory.data();
+	directoryHeader->generation.store(0, std::memory_order_release);
+
+	closeRing();
+
+	const uint64_t ringSize = sizeof(SharedFrameRingHeader) + numSlots * size;
+
+	for (int attempt = 0; attempt < MaxRingAttempts; attempt++){
+		generation++;
+		if (ring.create(name + "_" + std::to_string(generation), ringSize, true))
+			break;
+	}
+
+	if (!ring.isOpen())
+		return false;
+
+	slotSize = size;
+	memset(ring.data(), 0, size_t(ringSize));
+
+	SharedFrameRingHeader* header = (SharedFrameRingHeader*)ring.data();
+	memcpy(header->magic, SharedFrameRingMagic, sizeof(header->magic));
+	header->version = SharedFrameVersion;
+	header->headerSize = sizeof(SharedFrameRingHeader);
+	header->numSlots = numSlots;
+	header->slotSize = slotSize;
+
+	directoryHeader->ringSize = ringSize;
+	directoryHeader->generation.store(generation, std::memory_order_release);
+
+	return true;
+}
+
+void SharedFrameExporter::closeRing()
+{
+	if (!ring.isOpen())
+		return;
+
+	((SharedFrameRingHeader*)ring.data())->closed.store(1, std::memory_order_release);
+	ring.close();
+	slotSize = 0;
+}
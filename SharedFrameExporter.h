@@ -0,0 +1,64 @@
+#ifndef SHAREDFRAMEEXPORTER_H
+#define SHAREDFRAMEEXPORTER_H
+
+#include "FrameSource.h"
+#include "sharedframe/SharedFrameFormat.h"
+#include "sharedframe/SharedMemory.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Publishes the raw frames delivered by a FrameSource to a ring of slots in named shared
+// memory, for other processes to read with SharedFrameReader (see sharedframe/).
+//
+// publish() copies each image into the next slot and moves on, it never waits for readers.
+// The ring is made when the first frame arrives, sized to fit it, and is replaced by a
+// bigger one if the frames outgrow it.
+class SharedFrameExporter
+{
+public:
+	SharedFrameExporter();
+	~SharedFrameExporter();
+
+	// 'name' is what readers open, 'numSlots' how many frames the ring holds
+	void start(const std::string& name, int numSlots);
+	void stop();
+
+	bool isExporting() const { return exporting.load(std::memory_order_relaxed); }
+
+	// Can be called from any one thread while exporting
+	void publish(const FrameSet& frames, uint64_t arrivalTime);
+
+	uint64_t getFramesPublished() const;
+	// Set when the shared memory couldn't be created, until the next start()
+	bool hasError() const;
+
+private:
+	bool createRing(uint64_t slotSize);
+	void closeRing();
+
+	template<typename T>
+	void writeImage(const FrameView<T>& view, uint32_t stream, uint32_t pixelFormat, SharedFrameSlot* slot, uint64_t& offset);
+
+	std::atomic<bool> exporting{ false };
+
+	// Held while publishing, so stop() can't pull the memory out from under it
+	std::mutex lock;
+
+	std::string name;
+	int numSlots{ 0 };
+
+	SharedMemory directory;
+	SharedMemory ring;
+	uint32_t generation{ 0 };
+	uint64_t slotSize{ 0 };
+
+	uint64_t sequence{ 0 };
+
+	std::atomic<uint64_t> framesPublished{ 0 };
+	std::atomic<bool> error{ false };
+};
+
+#endif // SHAREDFRAMEEXPORTER_H
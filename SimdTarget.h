@@ -0,0 +1,19 @@
+#ifndef SIMDTARGET_H
+#define SIMDTARGET_H
+
+// The AVX2 kernels are compiled for every x64 build and only run when the CPU has AVX2,
+// see LitDepthVisualizer::has_avx2(). AVX2_TARGET goes on each function that uses it, so
+// the rest of the file is still built for the baseline CPU.
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#ifdef _WIN32
+#define AVX2_TARGET
+#define F16C_TARGET
+#else // macOS
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define F16C_TARGET __attribute__((target("avx2,f16c")))
+#endif
+#endif
+
+#endif // SIMDTARGET_H
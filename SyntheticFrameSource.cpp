@@ -0,0 +1,207 @@
+#include "SyntheticFrameSource.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+// Field of view of the Astra depth camera, so the generated points have realistic proportions
+const float HorizontalFov = 1.0225f;
+const float VerticalFov = 0.7964f;
+
+// Width of the band on the left with no depth, like the shadow the Astra's projector casts
+const int ShadowDivisor = 32;
+
+const char* const SyntheticPrefix = "synthetic";
+
+bool SyntheticFrameSource::isSynthetic(const char* device)
+{
+	const size_t length = strlen(SyntheticPrefix);
+	return !strncmp(device, SyntheticPrefix, length) && (device[length] == '\0' || device[length] == ':');
+}
+
+SyntheticFrameSource::SyntheticFrameSource(const char* device) :
+	streams(STREAM_DEPTH | STREAM_COLOR | STREAM_IR_16 | STREAM_IR_RGB)
+{
+	int w = 0;
+	int h = 0;
+	double rate = 0.0;
+
+	const char* options = device + strlen(SyntheticPrefix);
+	if (sscanf(options, ":%dx%d@%lf", &w, &h, &rate) == 3 &&
+		w >= 16 && w <= 4096 && h >= 16 && h <= 4096 && rate >= 1.0 && rate <= 1000.0)
+	{
+		width = w;
+		height = h;
+		fps = rate;
+	}
+
+	const size_t numPixels = size_t(width) * height;
+	depth.resize(numPixels);
+	color.resize(numPixels);
+	ir16.resize(numPixels);
+	irRgb.resize(numPixels);
+}
+
+void SyntheticFrameSource::setStreams(uint32_t s)
+{
+	streams.store(s);
+}
+
+void SyntheticFrameSource::update()
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / fps));
+
+	if (!started){
+		nextFrameTime = now;
+		started = true;
+	}
+
+	if (now < nextFrameTime)
+		return;
+
+	nextFrameTime += interval;
+	if (nextFrameTime < now)
+		nextFrameTime = now + interval;
+
+	FrameSet frames;
+	generate(nextFrameIndex++, frames);
+
+	if (listener)
+		listener->on_frame_ready(frames);
+}
+
+void SyntheticFrameSource::getFieldOfView(float& hFov, float& vFov) const
+{
+	hFov = HorizontalFov;
+	vFov = VerticalFov;
+}
+
+template<typename T>
+static void setView(const std::vector<T>& data, int width, int height, int32_t frameIndex, FrameView<T>& view)
+{
+	view.data = data.data();
+	view.width = width;
+	view.height = height;
+	view.frameIndex = frameIndex;
+}
+
+void SyntheticFrameSource::generate(int32_t frameIndex, FrameSet& frames)
+{
+	const uint32_t wanted = streams.load();
+	const double time = double(frameIndex) / fps;
+
+	frames = FrameSet();
+	frames.timestamp = uint64_t(time * 1000000.0);
+
+	generateDepth(time);
+	frames.streams |= STREAM_DEPTH;
+	setView(depth, width, height, frameIndex, frames.depth);
+
+	if (wanted & STREAM_COLOR){
+		generateColor(time);
+		frames.streams |= STREAM_COLOR;
+		setView(color, width, height, frameIndex, frames.color);
+	}
+
+	if (wanted & (STREAM_IR_16 | STREAM_IR_RGB)){
+		generateIR();
+		frames.streams |= STREAM_IR_16 | STREAM_IR_RGB;
+		setView(ir16, width, height, frameIndex, frames.ir16);
+		setView(irRgb, width, height, frameIndex, frames.irRgb);
+	}
+}
+
+// The scene is a wall sloping towards the camera at the bottom, a sphere circling in front
+// of it and a slanted box sliding from side to side.
+void SyntheticFrameSource::generateDepth(double time)
+{
+	const float sphereX = float(width * (0.5 + 0.3 * cos(0.9 * time)));
+	const float sphereY = float(height * (0.45 + 0.15 * sin(1.3 * time)));
+	const float sphereRadius = 0.16f * height;
+	const float sphereDepth = float(1400.0 + 300.0 * sin(0.5 * time));
+
+	// Triangle wave with a 4 second period
+	const double phase = fmod(time / 4.0, 1.0);
+	const double slide = phase < 0.5 ? phase * 2.0 : 2.0 - phase * 2.0;
+	const int boxLeft = int(width * (0.05 + 0.7 * slide));
+	const int boxRight = boxLeft + width / 5;
+	const int boxTop = int(height * 0.55);
+	const int boxBottom = int(height * 0.9);
+
+	const int shadowRight = width / ShadowDivisor;
+
+	int16_t* out = depth.data();
+	for (int y = 0; y < height; y++){
+		const float wallDepth = 3200.0f - 600.0f * float(y) / float(height);
+		const float dy = float(y) - sphereY;
+
+		for (int x = 0; x < width; x++, out++){
+			float z = wallDepth;
+
+			if (y >= boxTop && y < boxBottom && x >= boxLeft && x < boxRight)
+				z = 2000.0f + 300.0f * float(x - boxLeft) / float(boxRight - boxLeft);
+
+			const float dx = float(x) - sphereX;
+			const float distance2 = (dx * dx + dy * dy) / (sphereRadius * sphereRadius);
+			if (distance2 < 1.0f)
+				z = std::min(z, sphereDepth - 250.0f * std::sqrt(1.0f - distance2));
+
+			if (x < shadowRight)
+				z = 0.0f;
+
+			*out = int16_t(z);
+		}
+	}
+}
+
+void SyntheticFrameSource::generateColor(double time)
+{
+	const int cell = std::max(1, height / 12);
+	const int scroll = int(time * cell);
+
+	const int16_t* in = depth.data();
+	astra::RgbPixel* out = color.data();
+	for (int y = 0; y < height; y++){
+		const float wallDepth = 3200.0f - 600.0f * float(y) / float(height);
+
+		for (int x = 0; x < width; x++, in++, out++){
+			const float z = float(*in);
+
+			if (z == 0.0f){
+				*out = astra::RgbPixel(20, 20, 20);
+			}
+			else if (z < wallDepth - 1.0f){
+				// Nearer things are brighter, tinted orange
+				const int shade = std::max(0, std::min(255, int(255.0f - (z - 1000.0f) * 0.1f)));
+				*out = astra::RgbPixel(uint8_t(shade), uint8_t(shade * 3 / 5), uint8_t(shade / 5));
+			}
+			else{
+				const bool checker = (((x + scroll) / cell) + (y / cell)) & 1;
+				const uint8_t grey = checker ? 150 : 110;
+				*out = astra::RgbPixel(grey, grey, uint8_t(grey + 20));
+			}
+		}
+	}
+}
+
+void SyntheticFrameSource::generateIR()
+{
+	const size_t numPixels = size_t(width) * height;
+
+	for (size_t i = 0; i < numPixels; i++){
+		const float z = float(depth[i]);
+
+		// 10 bit intensity falling off with distance, like the reflected IR pattern
+		uint16_t value = 0;
+		if (z != 0.0f)
+			value = uint16_t(std::max(0.0f, std::min(1023.0f, 1023.0f * (1.0f - (z - 500.0f) / 3500.0f))));
+
+		ir16[i] = value;
+
+		const uint8_t grey = uint8_t(value >> 2);
+		irRgb[i] = astra::RgbPixel(grey, grey, grey);
+	}
+}
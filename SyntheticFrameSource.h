@@ -0,0 +1,58 @@
+#ifndef SYNTHETICFRAMESOURCE_H
+#define SYNTHETICFRAMESOURCE_H
+
+#include "FrameSource.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Generates a scene of moving shapes in place of a sensor, so the pipeline can be run and
+// load-tested on machines without a camera. Selected with a Device of "synthetic", or
+// "synthetic:WxH@fps" to choose the resolution and rate, e.g. "synthetic:1280x960@60".
+//
+// The scene only depends on the frame index, so a given frame is identical from run to run.
+// Frames are paced to the requested rate against the steady clock, frames that fall behind
+// are skipped rather than queued up.
+class SyntheticFrameSource : public FrameSource
+{
+public:
+	static bool isSynthetic(const char* device);
+
+	SyntheticFrameSource(const char* device);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	double getFps() const { return fps; }
+
+	virtual void setStreams(uint32_t streams) override;
+
+	virtual void update() override;
+	virtual void getFieldOfView(float& hFov, float& vFov) const override;
+
+	// Generates frame 'frameIndex' of the scene into 'frames', regardless of the frame rate.
+	// The views stay valid until the next call.
+	void generate(int32_t frameIndex, FrameSet& frames);
+
+protected:
+	void generateDepth(double time);
+	void generateColor(double time);
+	void generateIR();
+
+	int width{ 640 };
+	int height{ 480 };
+	double fps{ 30.0 };
+
+	std::atomic<uint32_t> streams;
+
+	int32_t nextFrameIndex{ 0 };
+	bool started{ false };
+	std::chrono::steady_clock::time_point nextFrameTime;
+
+	std::vector<int16_t> depth;
+	std::vector<astra::RgbPixel> color;
+	std::vector<uint16_t> ir16;
+	std::vector<astra::RgbPixel> irRgb;
+};
+
+#endif // SYNTHETICFRAMESOURCE_H
@@ -0,0 +1,81 @@
+#include "TiledDepthRenderer.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+const int TiledDepthRenderer::MaxTileSize;
+
+TiledDepthRenderer::TiledDepthRenderer()
+{
+}
+
+void TiledDepthRenderer::setTileSize(int size)
+{
+	// Any smaller and the halo is most of the work
+	tileSize = std::min(std::max(8, size), MaxTileSize);
+}
+
+void TiledDepthRenderer::prepareRays(int width, int height, float hFov, float vFov)
+{
+	if (width == rayWidth && height == rayHeight && hFov == rayHFov && vFov == rayVFov)
+		return;
+
+	rayX.resize(size_t(width));
+	rayY.resize(size_t(height));
+	LitDepthVisualizer::make_rays(size_t(width), size_t(height), hFov, vFov, rayX.data(), rayY.data());
+
+	rayWidth = width;
+	rayHeight = height;
+	rayHFov = hFov;
+	rayVFov = vFov;
+}
+
+void TiledDepthRenderer::render(const LitDepthVisualizer& visualizer, const int16_t* depth, int width, int height, float hFov, float vFov,
+	FramePacker::Destination destination, uint8_t* dst, WorkerPool& pool)
+{
+	const FramePacker::Kernel kernel = FramePacker::select(FramePacker::SOURCE_RGB888, destination);
+	if (!kernel || width <= 0 || height <= 0)
+		return;
+
+	prepareRays(width, height, hFov, vFov);
+
+	const int size = tileSize;
+	const int tilesAcross = (width + size - 1) / size;
+	const int tilesDown = (height + size - 1) / size;
+
+	// Sized for the settings of this frame, on this thread before any of the others start
+	const size_t haloFloats = visualizer.tile_scratch_size(size_t(size), size_t(size)) / sizeof(float);
+	if (scratch.size() < size_t(pool.getThreads()))
+		scratch.resize(size_t(pool.getThreads()));
+	for (Scratch& s : scratch){
+		if (s.halo.size() < haloFloats)
+			s.halo.resize(haloFloats);
+		if (s.tile.size() < size_t(size) * size)
+			s.tile.resize(size_t(size) * size);
+		if (s.row.size() < size_t(size))
+			s.row.resize(size_t(size));
+	}
+
+	const size_t dstBytes = FramePacker::destinationBytesPerPixel(destination);
+
+	pool.run(tilesAcross * tilesDown, [&](int index, int thread) {
+		Scratch& s = scratch[size_t(thread)];
+
+		const int tileX = (index % tilesAcross) * size;
+		const int tileY = (index / tilesAcross) * size;
+		const int tileWidth = std::min(size, width - tileX);
+		const int tileHeight = std::min(size, height - tileY);
+
+		visualizer.shade_depth_tile(depth, size_t(width), size_t(height), rayX.data(), rayY.data(),
+			size_t(tileX), size_t(tileY), size_t(tileWidth), size_t(tileHeight), s.halo.data(), s.tile.data());
+
+		// Reversed into the flipped frame a row at a time, the last pixel of the frame first
+		for (int y = 0; y < tileHeight; y++){
+			const astra::RgbPixel* in = s.tile.data() + size_t(y) * tileWidth;
+			std::reverse_copy(in, in + tileWidth, s.row.data());
+
+			const size_t first = size_t(height - 1 - (tileY + y)) * width + size_t(width - tileX - tileWidth);
+			kernel((const uint8_t*)s.row.data(), dst + first * dstBytes, size_t(tileWidth));
+		}
+	});
+}
@@ -0,0 +1,66 @@
+#ifndef TILEDDEPTHRENDERER_H
+#define TILEDDEPTHRENDERER_H
+
+#include "LitDepthVisualizer.h"
+#include "FramePacker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+// Lights a depth frame and packs it for upload a tile at a time, instead of as a pass over
+// the whole frame for each step. Each tile goes from the depth to its normals, their blur,
+// the shading and the uploaded pixel format without leaving the cache of the core it's on,
+// see LitDepthVisualizer::shade_depth_tile(). The tiles are the chunks of work the pool
+// shares out between its threads.
+//
+// The frame is packed flipped the same as the listener's streams, so it's the same image
+// as update_depth() and FramePacker would make.
+class TiledDepthRenderer
+{
+public:
+	TiledDepthRenderer();
+
+	TiledDepthRenderer(const TiledDepthRenderer&) = delete;
+	TiledDepthRenderer& operator=(const TiledDepthRenderer&) = delete;
+
+	// Each thread's scratch grows with the square of the tile and its halo
+	static const int MaxTileSize = 256;
+
+	// Width and height of the tiles in pixels, clamped to [8, MaxTileSize]
+	void setTileSize(int size);
+	int getTileSize() const { return tileSize; }
+
+	// Lights 'depth', in millimetres, with the visualizer's light and blur, and packs it into
+	// 'dst' in 'destination', one of the formats FramePacker packs SOURCE_RGB888 into. The
+	// field of view is in radians.
+	void render(const LitDepthVisualizer& visualizer, const int16_t* depth, int width, int height, float hFov, float vFov,
+		FramePacker::Destination destination, uint8_t* dst, WorkerPool& pool);
+
+private:
+	// Each thread's, only grows
+	struct Scratch
+	{
+		std::vector<float> halo;
+		std::vector<astra::RgbPixel> tile;
+		std::vector<astra::RgbPixel> row;
+	};
+
+	void prepareRays(int width, int height, float hFov, float vFov);
+
+	int tileSize{ 128 };
+
+	// The rays through the columns and rows of the frame, for the size and field of view
+	std::vector<float> rayX;
+	std::vector<float> rayY;
+	int rayWidth{ 0 };
+	int rayHeight{ 0 };
+	float rayHFov{ 0.0f };
+	float rayVFov{ 0.0f };
+
+	std::vector<Scratch> scratch;
+};
+
+#endif // TILEDDEPTHRENDERER_H
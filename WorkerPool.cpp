@@ -0,0 +1,110 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool()
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	stopWorkers();
+}
+
+void WorkerPool::setThreads(int threads)
+{
+	const size_t numWorkers = size_t(std::max(1, threads) - 1);
+	if (numWorkers == workers.size())
+		return;
+
+	stopWorkers();
+
+	// Started knowing the current generation, so they only wake for the next job
+	for (size_t i = 0; i < numWorkers; i++){
+		const int thread = int(i) + 1;
+		const uint64_t current = generation;
+		workers.push_back(new std::thread([this, thread, current]() { this->workerLoop(thread, current); }));
+	}
+}
+
+void WorkerPool::stopWorkers()
+{
+	if (workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopRequested = true;
+	}
+	workReady.notify_all();
+
+	for (std::thread* worker : workers){
+		worker->join();
+		delete worker;
+	}
+	workers.clear();
+
+	stopRequested = false;
+}
+
+void WorkerPool::run(int count, const Job& j)
+{
+	if (count <= 0)
+		return;
+
+	// Not worth waking anyone for
+	if (workers.empty() || count == 1){
+		for (int i = 0; i < count; i++)
+			j(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		job = &j;
+		numChunks = count;
+		nextChunk.store(0);
+		busyWorkers = int(workers.size());
+		generation++;
+	}
+	workReady.notify_all();
+
+	runChunks(0);
+
+	std::unique_lock<std::mutex> guard(lock);
+	workDone.wait(guard, [this]() { return busyWorkers == 0; });
+	job = nullptr;
+}
+
+void WorkerPool::runChunks(int thread)
+{
+	for (int i = nextChunk++; i < numChunks; i = nextChunk++)
+		(*job)(i, thread);
+}
+
+void WorkerPool::workerLoop(int thread, uint64_t seenGeneration)
+{
+	for (;;){
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			workReady.wait(guard, [this, seenGeneration]() {
+				return stopRequested || generation != seenGeneration;
+			});
+
+			if (stopRequested)
+				break;
+
+			seenGeneration = generation;
+		}
+
+		runChunks(thread);
+
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			last = --busyWorkers == 0;
+		}
+		if (last)
+			workDone.notify_one();
+	}
+}
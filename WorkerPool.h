@@ -0,0 +1,59 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads that split a job into chunks between them, for work on the producer thread
+// that's big enough to spread over the idle cores, like packing a frame for upload.
+//
+// The thread calling run() takes chunks too, so a pool of n threads only starts n - 1. The
+// workers sleep on a condition between jobs. setThreads() and run() must be called from one
+// thread at a time, the one that owns the pool.
+class WorkerPool
+{
+public:
+	// 'thread' is 0 for the caller and counts up through the workers, for scratch of their own
+	typedef std::function<void(int chunk, int thread)> Job;
+
+	WorkerPool();
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// The threads that run a job, counting the caller. Starts or stops workers to match.
+	void setThreads(int threads);
+	int getThreads() const { return int(workers.size()) + 1; }
+
+	// Calls job(i) for each i in [0, numChunks), spread over the threads, and returns once
+	// they've all been done. The chunks are taken in order but finish in any order.
+	void run(int numChunks, const Job& job);
+
+private:
+	void workerLoop(int thread, uint64_t seenGeneration);
+	void runChunks(int thread);
+	void stopWorkers();
+
+	std::vector<std::thread*> workers;
+
+	std::mutex lock;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	bool stopRequested{ false };
+
+	// Set under the lock before the generation is bumped, which is what the workers wait on
+	const Job* job{ nullptr };
+	int numChunks{ 0 };
+	uint64_t generation{ 0 };
+	int busyWorkers{ 0 };
+
+	std::atomic<int> nextChunk{ 0 };
+};
+
+#endif // WORKERPOOL_H
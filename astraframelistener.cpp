@@ -1,286 +1,655 @@
-#include "astraframelistener.h"
-
-AstraFrameListener::AstraFrameListener()
-{
-}
-
-void AstraFrameListener::connectSensor(const char* device)
-{
-	if (connected)
-		return;
-	
-	streamSet = astra::StreamSet(device);
-
-	reader = streamSet.create_reader();
-
-	reader.stream<astra::PointStream>().start();
-
-	auto depthStream = configure_depth(reader);
-	depthStream.start();
-
-	auto colorStream = configure_color(reader);
-	colorStream.start();
-
-	auto irStream = configure_ir(reader, false);
-
-	setStreamType(DEPTH);
-
-	reader.add_listener(*this);
-
-	connected = true;
-}
-
-void AstraFrameListener::disconnectSensor()
-{
-	connected = false;
-}
-
-void AstraFrameListener::setStreamType(AstraFrameListener::StreamType type)
-{
-    streamType = type;
-}
-
-int AstraFrameListener::getStreamWidth()
-{
-	int width = 0;
-
-	switch (streamType) {
-	case DEPTH:
-		width = depthStream.width;
-		break;
-	default:
-		width = colorStream.width;
-		break;
-	}
-
-	return width;
-}
-
-int AstraFrameListener::getStreamHeight()
-{
-	int height = 0;
-
-	switch (streamType) {
-	case DEPTH:
-		height = depthStream.height;
-		break;
-	default:
-		height = colorStream.height;
-		break;
-	}
-
-	return height;
-}
-
-void AstraFrameListener::on_frame_ready(astra::StreamReader &reader, astra::Frame &frame)
-{
-    switch(streamType){
-    case DEPTH:
-		updateDepth(frame);
-        break;
-    case COLOR:
-		updateColor(frame);
-        break;
-	case IR_16:
-		updateIR_16(frame);
-		break;
-	case IR_RGB:
-		updateIR_RGB(frame);
-		break;
-    default:
-        break;
-    }
-}
-
-astra::DepthStream AstraFrameListener::configure_depth(astra::StreamReader & reader)
-{
-	auto depthStream = reader.stream<astra::DepthStream>();
-
-	auto oldMode = depthStream.mode();
-
-	//We don't have to set the mode to start the stream, but if you want to here is how:
-	astra::ImageStreamMode depthMode;
-
-	depthMode.set_width(640);
-	depthMode.set_height(480);
-	depthMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_DEPTH_MM);
-	depthMode.set_fps(30);
-
-	depthStream.set_mode(depthMode);
-
-	auto newMode = depthStream.mode();
-	return depthStream;
-}
-
-astra::InfraredStream AstraFrameListener::configure_ir(astra::StreamReader & reader, bool useRGB)
-{
-	auto irStream = reader.stream<astra::InfraredStream>();
-
-	auto oldMode = irStream.mode();
-
-	astra::ImageStreamMode irMode;
-	irMode.set_width(640);
-	irMode.set_height(480);
-
-	if (useRGB)
-		irMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_RGB888);
-	else
-		irMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_GRAY16);
-
-	irMode.set_fps(30);
-	irStream.set_mode(irMode);
-
-	auto newMode = irStream.mode();
-	return irStream;
-}
-
-astra::ColorStream AstraFrameListener::configure_color(astra::StreamReader & reader)
-{
-	auto colorStream = reader.stream<astra::ColorStream>();
-
-	auto oldMode = colorStream.mode();
-
-	astra::ImageStreamMode colorMode;
-	colorMode.set_width(640);
-	colorMode.set_height(480);
-	colorMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_RGB888);
-	colorMode.set_fps(30);
-
-	colorStream.set_mode(colorMode);
-
-	auto newMode = colorStream.mode();
-	return colorStream;
-}
-
-void AstraFrameListener::updateDepth(astra::Frame &frame)
-{
-	const astra::PointFrame pointFrame = frame.get<astra::PointFrame>();
-
-	if (!pointFrame.is_valid()){
-		clearStream(depthStream);
-		return;
-	}
-
-	const int depthWidth = pointFrame.width();
-	const int depthHeight = pointFrame.height();
-
-	prepareStream(depthWidth, depthHeight, depthStream);
-
-	visualizer.update(pointFrame);
-
-	astra::RgbPixel* depth = visualizer.get_output();
-	uint8_t* buffer = &depthStream.buffer[0];
-
-	for (int i = 0; i < depthWidth * depthHeight; i++){
-		const int rgbaOffset = i * 4;
-
-		//Flip the image vertically
-		int j = (depthWidth * depthHeight - 1) - i;
-
-		buffer[rgbaOffset] = depth[j].r;
-		buffer[rgbaOffset + 1] = depth[j].g;
-		buffer[rgbaOffset + 2] = depth[j].b;
-		buffer[rgbaOffset + 3] = 255;
-	}
-}
-
-void AstraFrameListener::updateColor(astra::Frame &frame)
-{
-	const astra::ColorFrame colorFrame = frame.get<astra::ColorFrame>();
-	if (!colorFrame.is_valid()) {
-		clearStream(colorStream);
-		return;
-	}
-
-	const int colorWidth = colorFrame.width();
-	const int colorHeight = colorFrame.height();
-
-	prepareStream(colorWidth, colorHeight, colorStream);
-
-	const astra::RgbPixel* color = colorFrame.data();
-	uint8_t* buffer = &colorStream.buffer[0];
-
-	for(int i = 0; i < colorWidth * colorHeight; i++){
-		const int rgbaOffset = i * 4;
-
-		//Flip the image vertically
-		int j = (colorWidth * colorHeight - 1) - i;
-
-		buffer[rgbaOffset] = color[j].r;
-		buffer[rgbaOffset + 1] = color[j].g;
-		buffer[rgbaOffset + 2] = color[j].b;
-		buffer[rgbaOffset + 3] = 255;
-	}
-}
-
-void AstraFrameListener::updateIR_16(astra::Frame& frame)
-{
-	const astra::InfraredFrame16 irFrame = frame.get<astra::InfraredFrame16>();
-
-	if (!irFrame.is_valid()){
-		clearStream(colorStream);
-		return;
-	}
-
-	const int irWidth = irFrame.width();
-	const int irHeight = irFrame.height();
-
-	prepareStream(irWidth, irHeight, colorStream);
-
-	const uint16_t* ir_values = irFrame.data();
-	uint8_t* buffer = &colorStream.buffer[0];
-	for (int i = 0; i < irWidth * irHeight; i++){
-		const int rgbaOffset = i * 4;
-		const uint16_t value = ir_values[i];
-		const uint8_t red = static_cast<uint8_t>(value >> 2);
-		const uint8_t blue = 0x66 - red / 2;
-		buffer[rgbaOffset] = red;
-		buffer[rgbaOffset + 1] = 0;
-		buffer[rgbaOffset + 2] = blue;
-		buffer[rgbaOffset + 3] = 255;
-	}
-}
-
-void AstraFrameListener::updateIR_RGB(astra::Frame& frame)
-{
-	const astra::InfraredFrameRgb irFrame = frame.get<astra::InfraredFrameRgb>();
-
-	if (!irFrame.is_valid()){
-		clearStream(colorStream);
-		return;
-	}
-
-	int irWidth = irFrame.width();
-	int irHeight = irFrame.height();
-
-	prepareStream(irWidth, irHeight, colorStream);
-
-	const astra::RgbPixel* irRGB = irFrame.data();
-	uint8_t* buffer = &colorStream.buffer[0];
-	for (int i = 0; i < irWidth * irHeight; i++){
-		const int rgbaOffset = i * 4;
-		buffer[rgbaOffset] = irRGB[i].r;
-		buffer[rgbaOffset + 1] = irRGB[i].g;
-		buffer[rgbaOffset + 2] = irRGB[i].b;
-		buffer[rgbaOffset + 3] = 255;
-	}
-}
-
-void AstraFrameListener::prepareStream(int width, int height, Stream& stream)
-{
-	if (stream.buffer == nullptr || width != stream.width || height != stream.height){
-		stream.width = width;
-		stream.height = height;
-
-		const int byteLength = width * height * 4;
-
-		stream.buffer = BufferPtr(new uint8_t[byteLength]);
-		clearStream(stream);
-	}
-}
-
-void AstraFrameListener::clearStream(Stream& stream)
-{
-	const int byteLength = stream.width * stream.height * 4;
-	std::fill(&stream.buffer[0], &stream.buffer[0] + byteLength, 0);
-}
+#include "astraframelistener.h"
+#include "AstraFrameSource.h"
+#include "AstraPollingFrameSource.h"
+#include "SyntheticFrameSource.h"
+#include "PlaybackFrameSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t streamsFor(AstraFrameListener::StreamType type)
+{
+	switch (type) {
+	case AstraFrameListener::DEPTH:
+		return FrameSource::STREAM_DEPTH;
+	case AstraFrameListener::COLOR:
+		return FrameSource::STREAM_COLOR;
+	case AstraFrameListener::IR_16:
+		return FrameSource::STREAM_IR_16;
+	case AstraFrameListener::IR_RGB:
+		return FrameSource::STREAM_IR_RGB;
+	default:
+		return 0;
+	}
+}
+
+// Copies the pixels the other way round, which turns the image upside down
+template<typename Pixel>
+static void copyFlipped(const Pixel* in, Pixel* out, int numPixels)
+{
+	for (int i = 0; i < numPixels; i++)
+		out[i] = in[(numPixels - 1) - i];
+}
+
+// A pixel of the visualizer's normal outputs
+template<int Channels>
+struct HalfPixel
+{
+	uint16_t channels[Channels];
+};
+
+AstraFrameListener::AstraFrameListener()
+{
+	visualizer.set_arena(&arena);
+	reprojector.setArena(&arena);
+}
+
+void AstraFrameListener::connectSensor(const char* device)
+{
+	if (isSensorConnected(device))
+		return;
+
+	// A recording is of one device, its header describes the old source
+	recorder.stop();
+
+	// Release the old source first, the SDK may not be able to open the same sensor twice
+	source.reset();
+	playback = nullptr;
+
+	if (SyntheticFrameSource::isSynthetic(device))
+		source.reset(new SyntheticFrameSource(device));
+	else if (PlaybackFrameSource::isPlayback(device)){
+		playback = new PlaybackFrameSource(device);
+		source.reset(playback);
+	}
+	else if (polling)
+		source.reset(new AstraPollingFrameSource(std::string("device/sensor") + device));
+	else
+		source.reset(new AstraFrameSource(std::string("device/sensor") + device));
+
+	source->setListener(this);
+	source->setStreams(streamsFor(streamType));
+	source->setWaitTimeout(waitTimeout.load());
+
+	deviceName = device;
+	sourcePolling = polling;
+	connected = true;
+}
+
+void AstraFrameListener::disconnectSensor()
+{
+	connected = false;
+}
+
+bool AstraFrameListener::isSensorConnected(const char* device) const
+{
+	return connected && deviceName == device && sourcePolling == polling;
+}
+
+void AstraFrameListener::setPolling(bool p)
+{
+	polling = p;
+}
+
+bool AstraFrameListener::sensorWaitsForFrames() const
+{
+	return source && source->waitsForFrames();
+}
+
+void AstraFrameListener::setWaitTimeout(unsigned int milliseconds)
+{
+	waitTimeout.store(milliseconds);
+
+	if (source)
+		source->setWaitTimeout(milliseconds);
+}
+
+void AstraFrameListener::pollSensor()
+{
+	if (source)
+		source->update();
+}
+
+bool AstraFrameListener::startRecording(const std::string& path, bool compressDepth)
+{
+	if (!source)
+		return false;
+
+	float hFov = 0.0f;
+	float vFov = 0.0f;
+	source->getFieldOfView(hFov, vFov);
+
+	return recorder.start(path, hFov, vFov, compressDepth);
+}
+
+void AstraFrameListener::stopRecording()
+{
+	recorder.stop();
+}
+
+const FrameRecorder& AstraFrameListener::getRecorder() const
+{
+	return recorder;
+}
+
+void AstraFrameListener::startSharing(const std::string& name, int numSlots)
+{
+	exporter.start(name, numSlots);
+}
+
+void AstraFrameListener::stopSharing()
+{
+	exporter.stop();
+}
+
+const SharedFrameExporter& AstraFrameListener::getExporter() const
+{
+	return exporter;
+}
+
+void AstraFrameListener::setPlaybackOptions(bool realtime, bool loop)
+{
+	if (playback){
+		playback->setRealtime(realtime);
+		playback->setLoop(loop);
+	}
+}
+
+void AstraFrameListener::seekPlayback(int frame)
+{
+	if (playback)
+		playback->seek(frame);
+}
+
+bool AstraFrameListener::isPlayback() const
+{
+	return playback != nullptr;
+}
+
+std::string AstraFrameListener::getPlaybackError() const
+{
+	return playback ? playback->getError() : std::string();
+}
+
+int AstraFrameListener::getPlaybackFrame() const
+{
+	return playback ? playback->getCurrentFrame() : 0;
+}
+
+int AstraFrameListener::getPlaybackFrameCount() const
+{
+	return playback ? playback->getFrameCount() : 0;
+}
+
+void AstraFrameListener::setHugePages(bool hugePages)
+{
+	arena.setHugePages(hugePages);
+}
+
+const FrameArena& AstraFrameListener::getArena() const
+{
+	return arena;
+}
+
+void AstraFrameListener::setNormalFormat(LitDepthVisualizer::NormalFormat format)
+{
+	normalFormat.store(format);
+}
+
+void AstraFrameListener::setFusedShading(bool fused)
+{
+	fusedShading.store(fused);
+}
+
+void AstraFrameListener::setDepthNormals(bool fromDepth)
+{
+	depthNormals.store(fromDepth);
+}
+
+void AstraFrameListener::setReprojection(int x, int y, int width, int height, int decimation)
+{
+	regionX.store(x);
+	regionY.store(y);
+	regionWidth.store(width);
+	regionHeight.store(height);
+	reprojectDecimation.store(decimation);
+}
+
+void AstraFrameListener::setDepthOutput(DepthOutput output)
+{
+	depthOutput.store(output);
+}
+
+void AstraFrameListener::setVisualizerLayout(LitDepthVisualizer::Layout layout)
+{
+	visualizerLayout.store(layout);
+}
+
+void AstraFrameListener::setNormalBlur(LitDepthVisualizer::BlurMode mode, unsigned int radius)
+{
+	blurMode.store(mode);
+	// As the visualizer clamps it, so the two compare the same in applyVisualizerSettings()
+	blurRadius.store(std::min(radius, LitDepthVisualizer::MaxBlurRadius));
+}
+
+void AstraFrameListener::setNormalEstimator(LitDepthVisualizer::NormalEstimator estimator, unsigned int window, float threshold)
+{
+	normalEstimator.store(estimator);
+	integralWindow.store(window);
+	depthChangeThreshold.store(threshold);
+}
+
+void AstraFrameListener::setSimdShading(bool simd)
+{
+	simdShading.store(simd);
+}
+
+bool AstraFrameListener::usesAvx2Shading() const
+{
+	return simdShading.load() && LitDepthVisualizer::has_avx2();
+}
+
+void AstraFrameListener::setTiledShading(bool tiled, int size)
+{
+	tiledShading.store(tiled);
+	tileSize.store(size);
+}
+
+void AstraFrameListener::renderDepthTiles(uint8_t* dst, FramePacker::Destination destination, WorkerPool& pool)
+{
+	if (!depthStream.buffer || depthStream.format != FramePacker::SOURCE_DEPTH16_LIT)
+		return;
+
+	// Timed as part of STAGE_FILL, which this is called from
+	PipelineTrace::Scope trace("TiledDepthRenderer::render", frameMetadata.frameId);
+
+	tileRenderer.render(visualizer, (const int16_t*)depthStream.buffer, depthStream.width, depthStream.height,
+		tiledHFov, tiledVFov, destination, dst, pool);
+}
+
+bool AstraFrameListener::applyVisualizerSettings()
+{
+	// Don't change the buffers, or change the size of the points with them
+	visualizer.set_simd(simdShading.load());
+	visualizer.set_integral_window(integralWindow.load());
+	visualizer.set_depth_change_threshold(depthChangeThreshold.load());
+	reprojector.setRegion(regionX.load(), regionY.load(), regionWidth.load(), regionHeight.load());
+	reprojector.setDecimation(reprojectDecimation.load());
+	reprojector.setSimd(simdShading.load());
+	tileRenderer.setTileSize(tileSize.load());
+
+	const LitDepthVisualizer::NormalFormat format = normalFormat.load();
+	const LitDepthVisualizer::NormalSource normalSource = depthNormals.load() ?
+		LitDepthVisualizer::NORMALS_DEPTH : LitDepthVisualizer::NORMALS_POINTS;
+	const bool fused = fusedShading.load();
+	const LitDepthVisualizer::Layout layout = visualizerLayout.load();
+	const LitDepthVisualizer::BlurMode mode = blurMode.load();
+	const unsigned int radius = blurRadius.load();
+	const LitDepthVisualizer::NormalEstimator estimator = normalEstimator.load();
+	const DepthOutput requested = depthOutput.load();
+	LitDepthVisualizer::Output output = LitDepthVisualizer::OUTPUT_SHADED;
+	if (requested == DEPTH_NORMALS_RGBA16F)
+		output = LitDepthVisualizer::OUTPUT_NORMALS_RGBA16F;
+	else if (requested == DEPTH_NORMALS_RG16F)
+		output = LitDepthVisualizer::OUTPUT_NORMALS_RG16F;
+
+	// The depth and points aren't visualized, but their buffers are laid out differently
+	const bool outputChanged = requested != appliedDepthOutput;
+	appliedDepthOutput = requested;
+
+	// The stream's format changes with this, so prepareStream() lays the buffers out again
+	appliedTiled = tiledShading.load() && requested == DEPTH_SHADED &&
+		normalSource == LitDepthVisualizer::NORMALS_DEPTH && estimator == LitDepthVisualizer::ESTIMATE_CROSS;
+
+	if (!outputChanged &&
+		format == visualizer.get_normal_format() && normalSource == visualizer.get_normal_source() &&
+		fused == visualizer.get_fused() && output == visualizer.get_output_mode() &&
+		layout == visualizer.get_layout() && mode == visualizer.get_blur_mode() &&
+		radius == visualizer.get_blur_radius() && estimator == visualizer.get_normal_estimator())
+		return false;
+
+	visualizer.set_normal_format(format);
+	visualizer.set_normal_source(normalSource);
+	visualizer.set_fused(fused);
+	visualizer.set_layout(layout);
+	visualizer.set_blur_mode(mode);
+	visualizer.set_blur_radius(radius);
+	visualizer.set_normal_estimator(estimator);
+	visualizer.set_output(output);
+	return true;
+}
+
+void AstraFrameListener::setStreamType(AstraFrameListener::StreamType type)
+{
+    streamType = type;
+
+	if (source)
+		source->setStreams(streamsFor(type));
+}
+
+int AstraFrameListener::getStreamWidth()
+{
+	int width = 0;
+
+	switch (streamType) {
+	case DEPTH:
+		width = depthStream.width;
+		break;
+	default:
+		width = colorStream.width;
+		break;
+	}
+
+	return width;
+}
+
+FramePacker::Source AstraFrameListener::getStreamFormat()
+{
+	return streamType == DEPTH ? depthStream.format : colorStream.format;
+}
+
+int AstraFrameListener::getStreamHeight()
+{
+	int height = 0;
+
+	switch (streamType) {
+	case DEPTH:
+		height = depthStream.height;
+		break;
+	default:
+		height = colorStream.height;
+		break;
+	}
+
+	return height;
+}
+
+uint32_t AstraFrameListener::getFramesReceived() const
+{
+	return framesReceived.load();
+}
+
+double AstraFrameListener::getFrameInterval() const
+{
+	return frameInterval.load();
+}
+
+const FrameMetadata& AstraFrameListener::getFrameMetadata() const
+{
+	return frameMetadata;
+}
+
+void AstraFrameListener::on_frame_ready(const FrameSet& frames)
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	frameMetadata = FrameMetadata();
+	frameMetadata.frameId = framesReceived.load() + 1;
+	frameMetadata.arrivalTime = PipelineStats::now();
+	frameMetadata.deviceTimestamp = frames.timestamp;
+	frameMetadata.streamType = streamType;
+
+	PipelineTrace::Scope trace("on_frame_ready", frameMetadata.frameId);
+
+	if (framesReceived.load() > 0){
+		const double interval = std::chrono::duration<double, std::milli>(now - lastFrameTime).count();
+		const double previous = frameInterval.load();
+
+		// Exponential moving average, seeded with the first measured interval
+		frameInterval.store(previous == 0.0 ? interval : previous + 0.1 * (interval - previous));
+	}
+	lastFrameTime = now;
+	pipelineStats.countSensorFrame();
+
+	if (recorder.isRecording()){
+		PipelineTrace::Scope trace("record", frameMetadata.frameId);
+		recorder.record(frames, frameMetadata.arrivalTime);
+	}
+
+	if (exporter.isExporting()){
+		PipelineTrace::Scope trace("share", frameMetadata.frameId);
+		exporter.publish(frames, frameMetadata.arrivalTime);
+	}
+
+	{
+		PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_CONVERT);
+		PipelineTrace::Scope trace("convert", frameMetadata.frameId);
+
+		switch(streamType){
+		case DEPTH:
+			updateDepth(frames);
+			break;
+		case COLOR:
+			updateColor(frames);
+			break;
+		case IR_16:
+			updateIR_16(frames);
+			break;
+		case IR_RGB:
+			updateIR_RGB(frames);
+			break;
+		default:
+			break;
+		}
+	}
+
+	framesReceived++;
+}
+
+void AstraFrameListener::updateDepth(const FrameSet& frames)
+{
+	// The visualizer's buffers change size with these, so the arena is laid out again
+	if (applyVisualizerSettings())
+		depthStream.buffer = nullptr;
+
+	const FrameView<int16_t>& depthFrame = frames.depth;
+	const DepthOutput output = appliedDepthOutput;
+
+	if (output == DEPTH_MILLIMETRES){
+		if (!depthFrame.is_valid()){
+			clearStream(depthStream);
+			return;
+		}
+
+		setFrameMetadata(depthFrame.frameIndex, depthFrame.width, depthFrame.height, ASTRA_PIXEL_FORMAT_DEPTH_MM);
+		prepareStream(depthFrame.width, depthFrame.height, depthStream, FramePacker::SOURCE_DEPTH16);
+
+		copyFlipped(depthFrame.data, (int16_t*)&depthStream.buffer[0], depthFrame.width * depthFrame.height);
+		return;
+	}
+
+	const bool fromDepth = output != DEPTH_POINTS && visualizer.get_normal_source() == LitDepthVisualizer::NORMALS_DEPTH;
+
+	// The rays through the depth pixels need the field of view
+	float hFov = 0.0f;
+	float vFov = 0.0f;
+	if (source)
+		source->getFieldOfView(hFov, vFov);
+
+	if (!depthFrame.is_valid() || hFov <= 0.0f || vFov <= 0.0f){
+		clearStream(depthStream);
+		return;
+	}
+
+	// The points are of the region of the depth, every so many pixels
+	int depthWidth = depthFrame.width;
+	int depthHeight = depthFrame.height;
+	if (!fromDepth)
+		reprojector.getOutputSize(depthFrame.width, depthFrame.height, depthWidth, depthHeight);
+
+	if (depthWidth == 0 || depthHeight == 0){
+		clearStream(depthStream);
+		return;
+	}
+
+	setFrameMetadata(depthFrame.frameIndex, depthWidth, depthHeight,
+		fromDepth ? ASTRA_PIXEL_FORMAT_DEPTH_MM : ASTRA_PIXEL_FORMAT_POINT);
+
+	// Lit as it's packed, see renderDepthTiles()
+	if (appliedTiled){
+		prepareStream(depthWidth, depthHeight, depthStream, FramePacker::SOURCE_DEPTH16_LIT);
+		memcpy(&depthStream.buffer[0], depthFrame.data, size_t(depthWidth) * depthHeight * sizeof(int16_t));
+
+		tiledHFov = hFov;
+		tiledVFov = vFov;
+		return;
+	}
+
+	FramePacker::Source format = FramePacker::SOURCE_RGB888;
+	if (output == DEPTH_NORMALS_RGBA16F)
+		format = FramePacker::SOURCE_NORMALS_RGBA16F;
+	else if (output == DEPTH_NORMALS_RG16F)
+		format = FramePacker::SOURCE_NORMALS_RG16F;
+	else if (output == DEPTH_POINTS)
+		format = FramePacker::SOURCE_POINTS;
+
+	prepareStream(depthWidth, depthHeight, depthStream, format);
+
+	const int numPixels = depthWidth * depthHeight;
+
+	{
+		PipelineStats::ScopedTimer timer(pipelineStats, PipelineStats::STAGE_VISUALIZE);
+
+		if (fromDepth){
+			PipelineTrace::Scope trace("LitDepthVisualizer::update_depth", frameMetadata.frameId);
+			visualizer.update_depth(depthFrame.data, depthWidth, depthHeight, hFov, vFov);
+		}
+		else{
+			FrameView<astra::Vector3f> points;
+			{
+				PipelineTrace::Scope trace("DepthReprojector::reproject", frameMetadata.frameId);
+				points = reprojector.reproject(depthFrame, hFov, vFov);
+			}
+
+			if (output == DEPTH_POINTS){
+				copyFlipped(points.data, (astra::Vector3f*)&depthStream.buffer[0], numPixels);
+				return;
+			}
+
+			PipelineTrace::Scope trace("LitDepthVisualizer::update", frameMetadata.frameId);
+			visualizer.update(points.data, depthWidth, depthHeight);
+		}
+	}
+
+	// There's no output when the visualizer couldn't carve its buffers
+	const void* visualized = output == DEPTH_SHADED ? (const void*)visualizer.get_output() : (const void*)visualizer.get_normal_output();
+	if (!visualized){
+		clearStream(depthStream);
+		return;
+	}
+
+	// Flipped the same as the lit depth
+	if (output == DEPTH_NORMALS_RGBA16F)
+		copyFlipped((const HalfPixel<4>*)visualizer.get_normal_output(), (HalfPixel<4>*)&depthStream.buffer[0], numPixels);
+	else if (output == DEPTH_NORMALS_RG16F)
+		copyFlipped((const HalfPixel<2>*)visualizer.get_normal_output(), (HalfPixel<2>*)&depthStream.buffer[0], numPixels);
+	else
+		copyFlipped(visualizer.get_output(), (astra::RgbPixel*)&depthStream.buffer[0], numPixels);
+}
+
+void AstraFrameListener::updateColor(const FrameSet& frames)
+{
+	const FrameView<astra::RgbPixel>& colorFrame = frames.color;
+	if (!colorFrame.is_valid()) {
+		clearStream(colorStream);
+		return;
+	}
+
+	const int colorWidth = colorFrame.width;
+	const int colorHeight = colorFrame.height;
+
+	setFrameMetadata(colorFrame.frameIndex, colorWidth, colorHeight, ASTRA_PIXEL_FORMAT_RGB888);
+
+	prepareStream(colorWidth, colorHeight, colorStream, FramePacker::SOURCE_RGB888);
+
+	//Flip the image vertically
+	copyFlipped(colorFrame.data, (astra::RgbPixel*)&colorStream.buffer[0], colorWidth * colorHeight);
+}
+
+void AstraFrameListener::updateIR_16(const FrameSet& frames)
+{
+	const FrameView<uint16_t>& irFrame = frames.ir16;
+
+	if (!irFrame.is_valid()){
+		clearStream(colorStream);
+		return;
+	}
+
+	const int irWidth = irFrame.width;
+	const int irHeight = irFrame.height;
+
+	setFrameMetadata(irFrame.frameIndex, irWidth, irHeight, ASTRA_PIXEL_FORMAT_GRAY16);
+
+	// The false colour is worked out as it's packed
+	prepareStream(irWidth, irHeight, colorStream, FramePacker::SOURCE_IR16);
+
+	memcpy(&colorStream.buffer[0], irFrame.data, size_t(irWidth) * irHeight * sizeof(uint16_t));
+}
+
+void AstraFrameListener::updateIR_RGB(const FrameSet& frames)
+{
+	const FrameView<astra::RgbPixel>& irFrame = frames.irRgb;
+
+	if (!irFrame.is_valid()){
+		clearStream(colorStream);
+		return;
+	}
+
+	int irWidth = irFrame.width;
+	int irHeight = irFrame.height;
+
+	setFrameMetadata(irFrame.frameIndex, irWidth, irHeight, ASTRA_PIXEL_FORMAT_RGB888);
+
+	prepareStream(irWidth, irHeight, colorStream, FramePacker::SOURCE_RGB888);
+
+	memcpy(&colorStream.buffer[0], irFrame.data, size_t(irWidth) * irHeight * sizeof(astra::RgbPixel));
+}
+
+void AstraFrameListener::prepareStream(int width, int height, Stream& stream, FramePacker::Source format)
+{
+	if (stream.buffer != nullptr && width == stream.width && height == stream.height && format == stream.format &&
+		stream.arenaGeneration == arena.getGeneration() && !arena.isStale())
+		return;
+
+	// A new mode, so lay the arena out for it. Only one stream is converted at a time,
+	// the other one's buffer goes with the old layout.
+	const size_t byteLength = size_t(width) * height * FramePacker::sourceBytesPerPixel(format);
+
+	// The depth itself needs neither, the points aren't visualized, and the tiles have
+	// scratch of their own
+	size_t arenaSize = FrameArena::align(byteLength);
+	if (&stream == &depthStream && appliedDepthOutput != DEPTH_MILLIMETRES && format != FramePacker::SOURCE_DEPTH16_LIT){
+		if (appliedDepthOutput != DEPTH_POINTS)
+			arenaSize += visualizer.scratch_size(width, height);
+		if (appliedDepthOutput == DEPTH_POINTS || visualizer.get_normal_source() == LitDepthVisualizer::NORMALS_POINTS)
+			arenaSize += DepthReprojector::scratchSize(width, height);
+	}
+
+	arena.reset(arenaSize);
+	depthStream.buffer = nullptr;
+	colorStream.buffer = nullptr;
+
+	stream.width = width;
+	stream.height = height;
+	stream.format = format;
+	stream.buffer = arena.allocate<uint8_t>(byteLength);
+	stream.arenaGeneration = arena.getGeneration();
+	clearStream(stream);
+}
+
+void AstraFrameListener::setFrameMetadata(int32_t frameIndex, int width, int height, astra_pixel_format_t pixelFormat)
+{
+	frameMetadata.frameIndex = frameIndex;
+	frameMetadata.width = width;
+	frameMetadata.height = height;
+	frameMetadata.pixelFormat = pixelFormat;
+}
+
+void AstraFrameListener::clearStream(Stream& stream)
+{
+	if (!stream.buffer)
+		return;
+
+	const size_t byteLength = size_t(stream.width) * stream.height * FramePacker::sourceBytesPerPixel(stream.format);
+	std::fill(&stream.buffer[0], &stream.buffer[0] + byteLength, 0);
+}
@@ -1,72 +1,239 @@
-#ifndef ASTRAFRAMELISTENER_H
-#define ASTRAFRAMELISTENER_H
-
-#include <astra/astra.hpp>
-#include "LitDepthVisualizer.h"
-
-#include <cstdio>
-#include <chrono>
-#include <iostream>
-#include <iomanip>
-
-class AstraFrameListener : public astra::FrameListener
-{  
-public:
-	using BufferPtr = std::unique_ptr<uint8_t[]>;
-
-    typedef enum StreamType{
-        DEPTH,
-		COLOR,
-		IR_16,
-		IR_RGB,
-    }
-    StreamType;
-
-	typedef struct Stream {
-		int width{ 0 };
-		int height{ 0 };
-		BufferPtr buffer;
-	}
-	Stream;
-
-	AstraFrameListener();
-
-	void connectSensor(const char* device);
-	void disconnectSensor();
-
-    void setStreamType(AstraFrameListener::StreamType type);
-
-	int getStreamWidth();
-	int getStreamHeight();
-
-    virtual void on_frame_ready(astra::StreamReader& reader,
-                                astra::Frame& frame) override;
-protected:
-	astra::DepthStream configure_depth(astra::StreamReader& reader);
-	astra::InfraredStream configure_ir(astra::StreamReader& reader, bool useRGB);
-	astra::ColorStream configure_color(astra::StreamReader& reader);
-
-    virtual void updateDepth(astra::Frame& frame);
-	virtual void updateColor(astra::Frame& frame);
-	virtual void updateIR_16(astra::Frame& frame);
-	virtual void updateIR_RGB(astra::Frame& frame);
-
-	virtual void prepareStream(int width, int height, Stream& stream);
-	virtual void clearStream(Stream& stream);
-
-    StreamType streamType{COLOR};
-
-	std::string name{ "device/default" };
-
-	bool connected{ false };
-
-	astra::StreamSet streamSet;
-	astra::StreamReader reader;
-
-	Stream depthStream;
-	Stream colorStream;
-
-	LitDepthVisualizer visualizer;
-};
-
-#endif // ASTRAFRAMELISTENER_H
+#ifndef ASTRAFRAMELISTENER_H
+#define ASTRAFRAMELISTENER_H
+
+#include <astra/astra.hpp>
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "PlaybackFrameSource.h"
+#include "SharedFrameExporter.h"
+#include "LitDepthVisualizer.h"
+#include "DepthReprojector.h"
+#include "FrameArena.h"
+#include "FramePacker.h"
+#include "TiledDepthRenderer.h"
+#include "WorkerPool.h"
+#include "PipelineStats.h"
+#include "PipelineTrace.h"
+#include "FrameMetadata.h"
+
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Converts the frames of a FrameSource into RGBA images for the TOP.
+class AstraFrameListener : public FrameSource::Listener
+{  
+public:
+    typedef enum StreamType{
+        DEPTH,
+		COLOR,
+		IR_16,
+		IR_RGB,
+    }
+    StreamType;
+
+	// What the depth stream is made into
+	typedef enum DepthOutput{
+		DEPTH_SHADED,			// lit by the visualizer
+		DEPTH_NORMALS_RGBA16F,	// the visualizer's normals, see LitDepthVisualizer::set_output()
+		DEPTH_NORMALS_RG16F,
+		DEPTH_MILLIMETRES,		// the depth as it is
+		DEPTH_POINTS,			// the reprojector's points, of its region and decimation
+	}
+	DepthOutput;
+
+	typedef struct Stream {
+		int width{ 0 };
+		int height{ 0 };
+		// How the pixels are laid out in the buffer, for FramePacker
+		FramePacker::Source format{ FramePacker::SOURCE_RGB888 };
+		// Carved from the listener's arena, it goes when the arena is next reset
+		uint8_t* buffer{ nullptr };
+		uint32_t arenaGeneration{ 0 };
+	}
+	Stream;
+
+	AstraFrameListener();
+
+	// 'device' is the TOP's Device parameter, either a sensor number or the option string
+	// of a SyntheticFrameSource or PlaybackFrameSource. Does nothing if that device is
+	// already connected.
+	void connectSensor(const char* device);
+	void disconnectSensor();
+	bool isSensorConnected(const char* device) const;
+
+	// Whether sensors are read with an AstraPollingFrameSource rather than an AstraFrameSource.
+	// Takes effect when the sensor is next connected, isSensorConnected() is false until then.
+	void setPolling(bool polling);
+	// True if pollSensor() waits for frames itself, see FrameSource::waitsForFrames()
+	bool sensorWaitsForFrames() const;
+	void setWaitTimeout(unsigned int milliseconds);
+
+	// Pumps the frame source, which calls on_frame_ready() when a frameset is ready.
+	// Must only be called from one thread at a time.
+	void pollSensor();
+
+    void setStreamType(AstraFrameListener::StreamType type);
+
+	int getStreamWidth();
+	int getStreamHeight();
+	// The format of the stream's buffer, which changes with the stream and the depth output
+	FramePacker::Source getStreamFormat();
+
+	// Number of framesets delivered by the sensor so far
+	uint32_t getFramesReceived() const;
+	// Smoothed time between framesets delivered by the sensor, in milliseconds.
+	// Returns 0 until at least two framesets have arrived.
+	double getFrameInterval() const;
+
+	// Records the frames of the connected source until stopRecording(), the recording is
+	// also stopped when the sensor is reconnected. Returns false if the file can't be created.
+	bool startRecording(const std::string& path, bool compressDepth);
+	void stopRecording();
+	const FrameRecorder& getRecorder() const;
+
+	// Whether the scratch buffers should be in huge pages, can be called from any thread.
+	// Takes effect with the next frame.
+	void setHugePages(bool hugePages);
+	const FrameArena& getArena() const;
+
+	// How the depth visualizer stores its normal maps, can be called from any thread.
+	// Takes effect with the next frame.
+	void setNormalFormat(LitDepthVisualizer::NormalFormat format);
+	// See LitDepthVisualizer::set_fused(), can be called from any thread
+	void setFusedShading(bool fused);
+	// Whether the lit depth view works its normals out from the depth frames directly, rather
+	// than from points made from them by the reprojector. Can be called from any thread.
+	void setDepthNormals(bool fromDepth);
+	// The region of the depth the points are made of and every how many pixels, see
+	// DepthReprojector. The lit depth view is that size when it's lit from the points. Can be
+	// called from any thread, takes effect with the next frame.
+	void setReprojection(int x, int y, int width, int height, int decimation);
+	// Whether the depth stream is the lit depth, the visualizer's normals for lighting on the
+	// GPU, or the depth or points themselves. Can be called from any thread, takes effect
+	// with the next frame.
+	void setDepthOutput(DepthOutput output);
+	// See LitDepthVisualizer::set_layout(), can be called from any thread
+	void setVisualizerLayout(LitDepthVisualizer::Layout layout);
+	// How the normals are blurred, the radius is only used by BLUR_BOX. Can be called from
+	// any thread.
+	void setNormalBlur(LitDepthVisualizer::BlurMode mode, unsigned int radius);
+	// How the normals are worked out, the window and threshold are only used by
+	// ESTIMATE_INTEGRAL. Can be called from any thread.
+	void setNormalEstimator(LitDepthVisualizer::NormalEstimator estimator, unsigned int window, float threshold);
+	// See LitDepthVisualizer::set_simd(), it also picks DepthReprojector's kernel. These can
+	// be called from any thread.
+	void setSimdShading(bool simd);
+	bool usesAvx2Shading() const;
+	// Whether the lit depth is shaded a tile at a time as it's packed, see TiledDepthRenderer.
+	// Only when it's lit from the depth with cross products, otherwise it's shaded as a
+	// whole frame as before. Can be called from any thread, takes effect with the next frame.
+	void setTiledShading(bool tiled, int tileSize);
+
+	// Shades and packs a SOURCE_DEPTH16_LIT depth stream into 'dst', with the tiles spread
+	// over 'pool'. Only valid on the thread that pumps the sensor, in between pollSensor() calls.
+	void renderDepthTiles(uint8_t* dst, FramePacker::Destination destination, WorkerPool& pool);
+
+	// Publishes the raw frames of the connected source to shared memory under 'name' until
+	// stopSharing(), carrying on across reconnects
+	void startSharing(const std::string& name, int numSlots);
+	void stopSharing();
+	const SharedFrameExporter& getExporter() const;
+
+	// These only affect a connected PlaybackFrameSource, they can be called from any thread
+	void setPlaybackOptions(bool realtime, bool loop);
+	void seekPlayback(int frame);
+
+	bool isPlayback() const;
+	// Empty unless playback is connected and its recording couldn't be opened
+	std::string getPlaybackError() const;
+	int getPlaybackFrame() const;
+	int getPlaybackFrameCount() const;
+
+	// Describes the frame most recently converted in on_frame_ready. Only valid on the
+	// thread that pumps the sensor, in between pollSensor() calls.
+	const FrameMetadata& getFrameMetadata() const;
+
+    virtual void on_frame_ready(const FrameSet& frames) override;
+protected:
+    virtual void updateDepth(const FrameSet& frames);
+	virtual void updateColor(const FrameSet& frames);
+	virtual void updateIR_16(const FrameSet& frames);
+	virtual void updateIR_RGB(const FrameSet& frames);
+
+	virtual void prepareStream(int width, int height, Stream& stream, FramePacker::Source format);
+	void setFrameMetadata(int32_t frameIndex, int width, int height, astra_pixel_format_t pixelFormat);
+	virtual void clearStream(Stream& stream);
+	// Hands the visualizer settings over, true if they changed its buffers
+	bool applyVisualizerSettings();
+
+    StreamType streamType{COLOR};
+
+	std::string deviceName;
+
+	bool connected{ false };
+
+	bool polling{ false };
+	bool sourcePolling{ false };
+	std::atomic<unsigned int> waitTimeout{ 0 };
+
+	std::atomic<uint32_t> framesReceived{ 0 };
+	std::atomic<double> frameInterval{ 0.0 };
+	std::chrono::steady_clock::time_point lastFrameTime;
+
+	// Its frameId is the pipeline sequence number of the frameset being handled in
+	// on_frame_ready, the same as getFramesReceived() once it's done
+	FrameMetadata frameMetadata;
+
+	PipelineStats pipelineStats;
+
+	FrameRecorder recorder;
+	SharedFrameExporter exporter;
+
+	std::unique_ptr<FrameSource> source;
+	// The source, when it's a recording
+	PlaybackFrameSource* playback{ nullptr };
+
+	// Holds the streams' buffers and the visualizer's scratch buffers, laid out for the current mode
+	FrameArena arena;
+
+	Stream depthStream;
+	Stream colorStream;
+
+	LitDepthVisualizer visualizer;
+	std::atomic<LitDepthVisualizer::NormalFormat> normalFormat{ LitDepthVisualizer::NORMAL_FLOAT };
+	std::atomic<bool> fusedShading{ false };
+	std::atomic<bool> depthNormals{ true };
+	std::atomic<DepthOutput> depthOutput{ DEPTH_SHADED };
+	// The one the buffers are laid out for, only used by the thread pumping the sensor
+	DepthOutput appliedDepthOutput{ DEPTH_SHADED };
+
+	DepthReprojector reprojector;
+	std::atomic<int> regionX{ 0 };
+	std::atomic<int> regionY{ 0 };
+	std::atomic<int> regionWidth{ 0 };
+	std::atomic<int> regionHeight{ 0 };
+	std::atomic<int> reprojectDecimation{ 1 };
+	std::atomic<LitDepthVisualizer::Layout> visualizerLayout{ LitDepthVisualizer::LAYOUT_AOS };
+	std::atomic<LitDepthVisualizer::BlurMode> blurMode{ LitDepthVisualizer::BLUR_FAST };
+	std::atomic<unsigned int> blurRadius{ 1 };
+	std::atomic<LitDepthVisualizer::NormalEstimator> normalEstimator{ LitDepthVisualizer::ESTIMATE_CROSS };
+	std::atomic<unsigned int> integralWindow{ 9 };
+	std::atomic<float> depthChangeThreshold{ 0.02f };
+	std::atomic<bool> simdShading{ true };
+
+	TiledDepthRenderer tileRenderer;
+	std::atomic<bool> tiledShading{ false };
+	std::atomic<int> tileSize{ 128 };
+	// Whether the depth is lit by the tile renderer, and the field of view of the depth it
+	// has to light, only used by the thread pumping the sensor
+	bool appliedTiled{ false };
+	float tiledHFov{ 0.0f };
+	float tiledVFov{ 0.0f };
+};
+
+#endif // ASTRAFRAMELISTENER_H
@@ -1,135 +1,275 @@
-#include "astraframepoller.h"
-
-AstraFramePoller::AstraFramePoller()
-{
-
-}
-
-void AstraFramePoller::connectSensor(std::string device)
-{
-	if (connected)
-		return;
-
-    astra_streamset_open(device.c_str(), &sensor);
-
-    astra_reader_create(sensor, &reader);
-
-    switch (frameType)
-    {
-    case FrameType::DEPTH:
-        connectDepthStream();
-        break;
-    case FrameType::COLOR:
-        connectColorStream();
-        break;
-    default:
-        break;
-    }
-
-	connected = true;
-}
-
-void AstraFramePoller::disconnectSensor()
-{
-	connected = false;
-}
-
-void AstraFramePoller::setFrameType(AstraFramePoller::FrameType type)
-{
-    frameType = type;
-}
-
-void AstraFramePoller::pollFrame(unsigned int timeout)
-{
-    astra_reader_frame_t frame;
-    astra_status_t rc = astra_reader_open_frame(reader, timeout, &frame);
-
-    if (rc != ASTRA_STATUS_SUCCESS)
-        return;
-
-    switch (frameType)
-    {
-    case FrameType::DEPTH:
-        fillDepthFrame(frame);
-        break;
-    case FrameType::COLOR:
-        fillColorFrame(frame);
-        break;
-    default:
-        break;
-    }
-
-    astra_reader_close_frame(&frame);
-}
-
-const std::vector<astra_rgb_pixel_t> AstraFramePoller::getColorFrame()
-{
-    return colorBuffer;
-}
-
-const std::vector<int16_t> &AstraFramePoller::getDepthFrame()
-{
-    return depthBuffer;
-}
-
-unsigned int AstraFramePoller::getWidth()
-{
-	return width;
-}
-
-unsigned int AstraFramePoller::getHeight()
-{
-	return height;
-}
-
-void AstraFramePoller::connectColorStream()
-{
-    astra_reader_get_colorstream(reader, &colorStream);
-
-    astra_stream_start(colorStream);
-}
-
-void AstraFramePoller::connectDepthStream()
-{
-    astra_reader_get_depthstream(reader, &depthStream);
-
-    astra_stream_start(depthStream);
-}
-
-void AstraFramePoller::fillColorFrame(const astra_reader_frame_t& frame)
-{
-	astra_colorframe_t colorFrame;
-	astra_rgb_pixel_t* colorFrame_rgb = colorBuffer.data();
-    astra_image_metadata_t metadata;
-
-    astra_frame_get_colorframe(frame, &colorFrame);
-    astra_colorframe_get_metadata(colorFrame, &metadata);
-
-    width = metadata.width;
-    height = metadata.height;
-
-    uint32_t length;
-	
-    astra_colorframe_get_data_rgb_ptr(colorFrame, &colorFrame_rgb, &length);
-	
-    colorBuffer.resize(length);
-}
-
-void AstraFramePoller::fillDepthFrame(const astra_reader_frame_t& frame)
-{
-	astra_depthframe_t depthFrame;
-    astra_image_metadata_t metadata;
-
-    astra_frame_get_depthframe(frame, &depthFrame);
-    astra_depthframe_get_metadata(depthFrame, &metadata);
-
-    width = metadata.width;
-    height = metadata.height;
-
-    uint32_t length;
-
-    astra_depthframe_get_data_byte_length(depthFrame, &length);
-
-    depthBuffer.resize(length);
-    astra_depthframe_copy_data(depthFrame, depthBuffer.data());
-}
+#include "astraframepoller.h"
+
+#include <utility>
+
+static const uint32_t InfraredStreams = FrameSource::STREAM_IR_16 | FrameSource::STREAM_IR_RGB;
+
+// The same modes AstraFrameSource configures
+static void setMode(astra_streamconnection_t stream, astra_pixel_format_t pixelFormat)
+{
+	astra_imagestream_mode_t mode;
+	mode.id = 0;
+	mode.width = 640;
+	mode.height = 480;
+	mode.pixelFormat = pixelFormat;
+	mode.fps = 30;
+
+	astra_imagestream_set_mode(stream, &mode);
+}
+
+AstraFramePoller::FrameLease::FrameLease()
+{
+}
+
+AstraFramePoller::FrameLease::~FrameLease()
+{
+	release();
+}
+
+AstraFramePoller::FrameLease::FrameLease(FrameLease&& other)
+{
+	*this = std::move(other);
+}
+
+AstraFramePoller::FrameLease& AstraFramePoller::FrameLease::operator=(FrameLease&& other)
+{
+	if (this != &other){
+		release();
+
+		poller = other.poller;
+		frame = other.frame;
+		frames = other.frames;
+
+		other.poller = nullptr;
+		other.frame = nullptr;
+		other.frames = FrameSet();
+	}
+	return *this;
+}
+
+void AstraFramePoller::FrameLease::release()
+{
+	if (poller)
+		poller->closeLease(*this);
+}
+
+AstraFramePoller::AstraFramePoller()
+{
+}
+
+AstraFramePoller::~AstraFramePoller()
+{
+	disconnectSensor();
+}
+
+void AstraFramePoller::connectSensor(std::string device)
+{
+	if (connected)
+		return;
+
+	name = device;
+
+	astra_streamset_open(name.c_str(), &sensor);
+	astra_reader_create(sensor, &reader);
+
+	astra_reader_get_depthstream(reader, &depthStream);
+	astra_reader_get_colorstream(reader, &colorStream);
+	astra_reader_get_infraredstream(reader, &infraredStream);
+
+	setMode(depthStream, ASTRA_PIXEL_FORMAT_DEPTH_MM);
+	setMode(colorStream, ASTRA_PIXEL_FORMAT_RGB888);
+
+	astra_depthstream_get_hfov(depthStream, &depthHFov);
+	astra_depthstream_get_vfov(depthStream, &depthVFov);
+
+	connected = true;
+}
+
+void AstraFramePoller::disconnectSensor()
+{
+	if (!connected)
+		return;
+
+	// Leases still out can't close their frame once the reader is gone
+	leaseOpen = false;
+
+	astra_reader_destroy(&reader);
+	astra_streamset_close(&sensor);
+
+	startedStreams = 0;
+	connected = false;
+}
+
+void AstraFramePoller::setStreams(uint32_t streams)
+{
+	if (!connected)
+		return;
+
+	if (streams & FrameSource::STREAM_IR_16)
+		streams &= ~FrameSource::STREAM_IR_RGB;
+
+	const uint32_t all[] = { FrameSource::STREAM_DEPTH, FrameSource::STREAM_COLOR, FrameSource::STREAM_IR_16,
+							 FrameSource::STREAM_IR_RGB };
+
+	// Stops first, so the infrared stream is stopped before it changes format
+	for (uint32_t stream : all){
+		if (!(streams & stream) && (startedStreams & stream))
+			stopStream(stream);
+	}
+
+	for (uint32_t stream : all){
+		if ((streams & stream) && !(startedStreams & stream))
+			startStream(stream);
+	}
+}
+
+void AstraFramePoller::startStream(uint32_t stream)
+{
+	switch (stream){
+	case FrameSource::STREAM_DEPTH:
+		astra_stream_start(depthStream);
+		break;
+	case FrameSource::STREAM_COLOR:
+		astra_stream_start(colorStream);
+		break;
+	case FrameSource::STREAM_IR_16:
+		setMode(infraredStream, ASTRA_PIXEL_FORMAT_GRAY16);
+		astra_stream_start(infraredStream);
+		break;
+	case FrameSource::STREAM_IR_RGB:
+		setMode(infraredStream, ASTRA_PIXEL_FORMAT_RGB888);
+		astra_stream_start(infraredStream);
+		break;
+	default:
+		return;
+	}
+
+	startedStreams |= stream;
+}
+
+void AstraFramePoller::stopStream(uint32_t stream)
+{
+	switch (stream){
+	case FrameSource::STREAM_DEPTH:
+		astra_stream_stop(depthStream);
+		break;
+	case FrameSource::STREAM_COLOR:
+		astra_stream_stop(colorStream);
+		break;
+	case FrameSource::STREAM_IR_16:
+	case FrameSource::STREAM_IR_RGB:
+		astra_stream_stop(infraredStream);
+		break;
+	default:
+		return;
+	}
+
+	startedStreams &= ~stream;
+}
+
+AstraFramePoller::FrameLease AstraFramePoller::pollFrame(unsigned int timeout)
+{
+	FrameLease lease;
+
+	if (!connected || leaseOpen)
+		return lease;
+
+	astra_update();
+
+	if (astra_reader_open_frame(reader, timeout, &lease.frame) != ASTRA_STATUS_SUCCESS){
+		lease.frame = nullptr;
+		return lease;
+	}
+
+	lease.poller = this;
+	leaseOpen = true;
+
+	leaseFrames(lease);
+
+	return lease;
+}
+
+void AstraFramePoller::getFieldOfView(float& hFov, float& vFov) const
+{
+	hFov = depthHFov;
+	vFov = depthVFov;
+}
+
+unsigned int AstraFramePoller::getWidth()
+{
+	return width;
+}
+
+unsigned int AstraFramePoller::getHeight()
+{
+	return height;
+}
+
+template<typename T>
+void AstraFramePoller::leaseImage(astra_imageframe_t imageFrame, uint8_t* data, uint32_t byteLength, FrameView<T>& view, uint32_t stream, FrameLease& lease)
+{
+	astra_image_metadata_t metadata;
+	astra_imageframe_get_metadata(imageFrame, &metadata);
+
+	if (!data || byteLength < metadata.width * metadata.height * sizeof(T))
+		return;
+
+	astra_frame_index_t frameIndex = -1;
+	astra_imageframe_get_frameindex(imageFrame, &frameIndex);
+
+	width = metadata.width;
+	height = metadata.height;
+
+	view.data = (const T*)data;
+	view.width = metadata.width;
+	view.height = metadata.height;
+	view.frameIndex = frameIndex;
+
+	lease.frames.streams |= stream;
+}
+
+void AstraFramePoller::leaseFrames(FrameLease& lease)
+{
+	FrameSet& frames = lease.frames;
+
+	astra_imageframe_t imageFrame = nullptr;
+	uint32_t byteLength = 0;
+
+	if ((startedStreams & FrameSource::STREAM_DEPTH) &&
+		astra_frame_get_depthframe(lease.frame, &imageFrame) == ASTRA_STATUS_SUCCESS && imageFrame){
+		int16_t* data = nullptr;
+		astra_depthframe_get_data_ptr(imageFrame, &data, &byteLength);
+		leaseImage(imageFrame, (uint8_t*)data, byteLength, frames.depth, FrameSource::STREAM_DEPTH, lease);
+	}
+
+	if ((startedStreams & FrameSource::STREAM_COLOR) &&
+		astra_frame_get_colorframe(lease.frame, &imageFrame) == ASTRA_STATUS_SUCCESS && imageFrame){
+		astra_rgb_pixel_t* data = nullptr;
+		astra_colorframe_get_data_rgb_ptr(imageFrame, &data, &byteLength);
+		leaseImage(imageFrame, (uint8_t*)data, byteLength, frames.color, FrameSource::STREAM_COLOR, lease);
+	}
+
+	if ((startedStreams & InfraredStreams) &&
+		astra_frame_get_infraredframe(lease.frame, &imageFrame) == ASTRA_STATUS_SUCCESS && imageFrame){
+		uint8_t* data = nullptr;
+		astra_infraredframe_get_data_ptr(imageFrame, &data, &byteLength);
+
+		// Which view it goes in depends on the format the stream was started with
+		if (startedStreams & FrameSource::STREAM_IR_16)
+			leaseImage(imageFrame, data, byteLength, frames.ir16, FrameSource::STREAM_IR_16, lease);
+		else
+			leaseImage(imageFrame, data, byteLength, frames.irRgb, FrameSource::STREAM_IR_RGB, lease);
+	}
+}
+
+void AstraFramePoller::closeLease(FrameLease& lease)
+{
+	if (leaseOpen)
+		astra_reader_close_frame(&lease.frame);
+
+	leaseOpen = false;
+
+	lease.poller = nullptr;
+	lease.frame = nullptr;
+	lease.frames = FrameSet();
+}
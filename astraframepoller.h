@@ -1,58 +1,106 @@
-#ifndef ASTRAFRAMEPOLLER_H
-#define ASTRAFRAMEPOLLER_H
-
-#include <vector>
-
-#include <astra/astra.hpp>
-
-class AstraFramePoller
-{
-public:
-    typedef enum FrameType{
-        COLOR,
-        DEPTH,
-    }
-    FrameType;
-
-    AstraFramePoller();
-
-    void connectSensor(std::string device);
-    void disconnectSensor();
-
-    void setFrameType(AstraFramePoller::FrameType type);
-
-    virtual void pollFrame(unsigned int timeout);
-
-    const std::vector<astra_rgb_pixel_t> getColorFrame();
-    const std::vector<int16_t>& getDepthFrame();
-
-	unsigned int getWidth();
-	unsigned int getHeight();
-
-protected:
-    void connectColorStream();
-    void connectDepthStream();
-
-    void fillColorFrame(const astra_reader_frame_t& frame);
-    void fillDepthFrame(const astra_reader_frame_t& frame);
-
-	std::string name{"device/default"};
-
-    FrameType frameType{DEPTH};
-
-	bool connected{ false };
-
-    std::vector<astra_rgb_pixel_t> colorBuffer;
-    std::vector<int16_t> depthBuffer;
-
-    unsigned int width{0};
-    unsigned int height{0};
-
-	astra_depthstream_t depthStream;
-	astra_colorstream_t colorStream;
-
-    astra_streamsetconnection_t sensor;
-    astra_reader_t reader;
-};
-
-#endif // ASTRAFRAMEPOLLER_H
+#ifndef ASTRAFRAMEPOLLER_H
+#define ASTRAFRAMEPOLLER_H
+
+#include <astra/astra.hpp>
+#include "FrameSource.h"
+
+#include <string>
+
+// Pulls frames from an Astra sensor with the SDK's reader API, rather than having them
+// pushed to a listener.
+//
+// pollFrame() hands out a FrameLease, which keeps the frame open in the SDK for as long as
+// it's held. Its views point straight into the SDK's memory, so a frame can be converted
+// without being copied first. The SDK only lets a reader have one frame open at a time, so
+// a lease must be released (or destroyed) before the next poll, and the poller must outlive
+// its leases.
+class AstraFramePoller
+{
+public:
+	class FrameLease
+	{
+	public:
+		FrameLease();
+		~FrameLease();
+
+		FrameLease(FrameLease&& other);
+		FrameLease& operator=(FrameLease&& other);
+
+		FrameLease(const FrameLease&) = delete;
+		FrameLease& operator=(const FrameLease&) = delete;
+
+		// False if no frame arrived in time
+		bool isValid() const { return frame != nullptr; }
+
+		// The views and streams are only valid while the lease is held. A view is invalid if
+		// its stream isn't started or wasn't in the frame.
+		const FrameSet& getFrames() const { return frames; }
+
+		// Closes the frame, the views are invalid afterwards
+		void release();
+
+	private:
+		friend class AstraFramePoller;
+
+		AstraFramePoller* poller{ nullptr };
+		astra_reader_frame_t frame{ nullptr };
+
+		FrameSet frames;
+	};
+
+	AstraFramePoller();
+	~AstraFramePoller();
+
+	// 'device' is an Astra URI such as "device/default". Does nothing if already connected.
+	void connectSensor(std::string device);
+	void disconnectSensor();
+	bool isConnected() const { return connected; }
+
+	// Starts the streams in 'streams' (FrameSource::StreamFlags) and stops the others. The
+	// infrared stream can only run in one format, IR_16 wins if both are asked for.
+	void setStreams(uint32_t streams);
+
+	// Pumps the SDK, then waits up to 'timeout' milliseconds for the next frame. The lease is
+	// invalid if none arrived, or if the last lease is still held.
+	FrameLease pollFrame(unsigned int timeout);
+
+	// Field of view of the depth camera in radians
+	void getFieldOfView(float& hFov, float& vFov) const;
+
+	// Of the last frame polled
+	unsigned int getWidth();
+	unsigned int getHeight();
+
+protected:
+	void startStream(uint32_t stream);
+	void stopStream(uint32_t stream);
+
+	template<typename T>
+	void leaseImage(astra_imageframe_t imageFrame, uint8_t* data, uint32_t byteLength, FrameView<T>& view, uint32_t stream, FrameLease& lease);
+	void leaseFrames(FrameLease& lease);
+
+	void closeLease(FrameLease& lease);
+
+	std::string name{"device/default"};
+
+	bool connected{ false };
+	bool leaseOpen{ false };
+
+	// FrameSource::StreamFlags of the streams that are running
+	uint32_t startedStreams{ 0 };
+
+	unsigned int width{0};
+	unsigned int height{0};
+
+	float depthHFov{ 0.0f };
+	float depthVFov{ 0.0f };
+
+	astra_depthstream_t depthStream{ nullptr };
+	astra_colorstream_t colorStream{ nullptr };
+	astra_infraredstream_t infraredStream{ nullptr };
+
+	astra_streamsetconnection_t sensor{ nullptr };
+	astra_reader_t reader{ nullptr };
+};
+
+#endif // ASTRAFRAMEPOLLER_H
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "TOP_CPlusPlusBase.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdlib.h>
+
+// Heap backed stand-ins for the buffers and context TouchDesigner hands the plugin,
+// so FrameQueue can be exercised outside of TouchDesigner.
+class FakeTOPBuffer : public TD::TOP_Buffer
+{
+public:
+	FakeTOPBuffer(uint64_t byteSize, TD::TOP_BufferFlags bufferFlags) :
+		myRefCount(0)
+	{
+		data = malloc(byteSize);
+		size = byteSize;
+		flags = bufferFlags;
+	}
+
+	virtual ~FakeTOPBuffer()
+	{
+		free(data);
+	}
+
+protected:
+	virtual void	acquire() override { myRefCount++; }
+	virtual void	release() override
+	{
+		if (--myRefCount == 0)
+			delete this;
+	}
+
+	virtual void	reserved0() override {}
+	virtual void	reserved1() override {}
+	virtual void	reserved2() override {}
+	virtual void	reserved3() override {}
+	virtual void	reserved4() override {}
+
+private:
+	std::atomic<int>	myRefCount;
+};
+
+class FakeTOPContext : public TD::TOP_Context
+{
+public:
+	virtual ~FakeTOPContext() {}
+
+	// Like TouchDesigner, buffers given back with returnBuffer() are handed out again
+	// instead of allocating a new one
+	virtual TD::OP_SmartRef<TD::TOP_Buffer>
+	createOutputBuffer(uint64_t size, TD::TOP_BufferFlags flags, void* reserved) override
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		for (size_t i = 0; i < myReturned.size(); i++)
+		{
+			if (myReturned[i]->size >= size && myReturned[i]->flags == flags)
+			{
+				TD::OP_SmartRef<TD::TOP_Buffer> buf = myReturned[i];
+				myReturned.erase(myReturned.begin() + i);
+				return buf;
+			}
+		}
+		return TD::OP_SmartRef<TD::TOP_Buffer>(new FakeTOPBuffer(size, flags));
+	}
+
+	virtual void
+	returnBuffer(TD::OP_SmartRef<TD::TOP_Buffer>* buf) override
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myReturned.push_back(*buf);
+		buf->release();
+	}
+
+	virtual PyObject*	createArgumentsTuple(int numOtherArgs, void* reserved1) override { return nullptr; }
+	virtual PyObject*	callPythonCallback(const char* functionName, PyObject* arguments, PyObject* keywords,
+										   void* reserved1) override { return nullptr; }
+	virtual bool		beginCUDAOperations(void* reserved1) override { return false; }
+	virtual void		endCUDAOperations(void* reserved1) override {}
+
+protected:
+	virtual void*	reservedFunc0() override { return nullptr; }
+	virtual void*	reservedFunc1() override { return nullptr; }
+	virtual void*	reservedFunc2() override { return nullptr; }
+	virtual void*	reservedFunc3() override { return nullptr; }
+	virtual void*	reservedFunc4() override { return nullptr; }
+	virtual void*	reservedFunc5() override { return nullptr; }
+	virtual void*	reservedFunc6() override { return nullptr; }
+	virtual void*	reservedFunc7() override { return nullptr; }
+	virtual void*	reservedFunc8() override { return nullptr; }
+	virtual void*	reservedFunc9() override { return nullptr; }
+	virtual void*	reservedFunc10() override { return nullptr; }
+	virtual void*	reservedFunc11() override { return nullptr; }
+	virtual void*	reservedFunc12() override { return nullptr; }
+	virtual void*	reservedFunc13() override { return nullptr; }
+	virtual void*	reservedFunc14() override { return nullptr; }
+
+	virtual void	reserved0() override {}
+	virtual void	reserved1() override {}
+	virtual void	reserved2() override {}
+	virtual void	reserved3() override {}
+	virtual void	reserved4() override {}
+	virtual void	reserved5() override {}
+	virtual void	reserved6() override {}
+	virtual void	reserved7() override {}
+	virtual void	reserved8() override {}
+	virtual void	reserved9() override {}
+
+private:
+	std::mutex			myLock;
+	std::vector<TD::OP_SmartRef<TD::TOP_Buffer>>	myReturned;
+};
@@ -0,0 +1,1568 @@
+// Micro-benchmarks for the frame conversion and shading hot paths.
+//
+// Every case runs on frames from SyntheticFrameSource at 320x240, 640x480 and 1280x960.
+// Each thread in a run works on its own instance of the case, so the thread counts show
+// how well a case scales when several frames (or TOPs) are processed at the same time.
+//
+// Builds on Linux against the stubs in benchmark/stub, without TouchDesigner, the
+// Astra SDK or a device. GCC needs -fpermissive for the TouchDesigner headers, and the
+// warnings they raise are turned off by name. GCC before 13 has no name for the one about
+// cudaArray in CPlusPlus_Common.h, so it's still printed.
+// From the repository root:
+//
+//   g++ -std=c++14 -O2 -Wall -pthread -fpermissive -Wno-invalid-offsetof -Wno-changes-meaning
+//       -Ibenchmark/stub -I. -include benchmark/stub/compat.h benchmark/PipelineBenchmark.cpp astraframelistener.cpp AstraFrameSource.cpp
+//       AstraPollingFrameSource.cpp astraframepoller.cpp SyntheticFrameSource.cpp
+//       PlaybackFrameSource.cpp MappedFile.cpp FrameRecorder.cpp DepthCodec.cpp
+//       SharedFrameExporter.cpp sharedframe/SharedMemory.cpp sharedframe/SharedFrameReader.cpp
+//       LitDepthVisualizer.cpp TiledDepthRenderer.cpp DepthReprojector.cpp FrameArena.cpp FramePacker.cpp WorkerPool.cpp
+//       FrameQueue.cpp PipelineStats.cpp PipelineTrace.cpp -o pipeline_benchmark
+//
+// Usage:
+//   pipeline_benchmark [--filter <text>] [--threads 1,2,4] [--min-time <seconds>] [--json <file>]
+//   pipeline_benchmark --acquisition [--min-time <seconds>]
+//   pipeline_benchmark --accuracy
+//
+// --filter only runs the cases whose name contains the text, --min-time is how long each
+// case is calibrated to run for on one thread (default 0.25s), and --json writes the results
+// in a machine-readable form for tracking regressions.
+//
+// --acquisition instead measures how long a frame waits between being captured and being
+// handed to the listener, with the stub simulating a 30fps sensor. The callback backend is
+// pumped the way the TOP's free running producer pumps it, the polling backend waits in
+// astra_reader_open_frame(). Each runs for 20x --min-time.
+//
+// --accuracy checks the octahedral normal maps against the float ones: the blurred normals
+// of random directions, and the shaded synthetic scene. It fails if they're further apart
+// than the encoding should allow, or if fused shading isn't exactly the same as unfused.
+// It also checks box_blur_separable() against summing every box the slow way, and the AVX2
+// shading kernel, the planes of LAYOUT_SOA and the normals from the depth against the scalar
+// loop on the float maps, and the AVX2 and decimated points of DepthReprojector against
+// its scalar loop over the whole frame. The octahedral RG16F normal output of the depth is
+// checked against the RGBA16F output of the points. DepthCodec has to give back exactly the
+// depth it was given: the synthetic scene, random values, the extremes side by side, steps
+// only the three byte token holds, all zeros and frames one and two pixels wide. Frames
+// published by SharedFrameExporter have to be read back the same by SharedFrameReader, from
+// a first ring and the bigger one a larger frame replaces it with, and nothing can be read
+// once the exporter stops.
+//
+// ms/frame is how long one frame took on a thread while all the threads of the run were
+// busy, ns/pixel and GB/s are the combined throughput of all of them.
+
+#include "astraframelistener.h"
+#include "AstraFrameSource.h"
+#include "AstraPollingFrameSource.h"
+#include "SyntheticFrameSource.h"
+#include "LitDepthVisualizer.h"
+#include "DepthReprojector.h"
+#include "FramePacker.h"
+#include "WorkerPool.h"
+#include "TiledDepthRenderer.h"
+#include "DepthCodec.h"
+#include "FrameQueue.h"
+#include "SharedFrameExporter.h"
+#include "sharedframe/SharedFrameReader.h"
+#include "FakeTOPContext.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace TD;
+
+// One instance of a case, only ever used by a single thread
+class Benchmark
+{
+public:
+	virtual ~Benchmark() {}
+
+	virtual void	setup(int width, int height) = 0;
+	virtual void	run() = 0;
+};
+
+class BenchmarkCase
+{
+public:
+	const char*		name;
+
+	// Bytes read plus bytes written per pixel by one run, 0 if that's not meaningful
+	double			bytesPerPixel;
+
+	std::function<Benchmark*()>	create;
+};
+
+class BenchmarkResult
+{
+public:
+	std::string		name;
+	int				width;
+	int				height;
+	int				threads;
+	int				iterations;
+	double			msPerFrame;
+	double			nsPerPixel;
+	double			gbPerSecond;
+	double			speedup;
+};
+
+// Generates a single frame of the synthetic scene with every stream in it
+static void
+generateFrames(SyntheticFrameSource& source, FrameSet& frames)
+{
+	source.setStreams(FrameSource::STREAM_DEPTH | FrameSource::STREAM_COLOR | FrameSource::STREAM_IR_16 |
+		FrameSource::STREAM_IR_RGB);
+
+	// Far enough in that the shapes are away from their starting positions
+	source.generate(45, frames);
+}
+
+// The points the listener lights the depth from, valid while the reprojector is
+static FrameView<astra::Vector3f>
+reprojectFrames(const SyntheticFrameSource& source, const FrameSet& frames, DepthReprojector& reprojector)
+{
+	float hFov = 0.0f;
+	float vFov = 0.0f;
+	source.getFieldOfView(hFov, vFov);
+
+	return reprojector.reproject(frames.depth, hFov, vFov);
+}
+
+static std::string
+syntheticDevice(int width, int height)
+{
+	return "synthetic:" + std::to_string(width) + "x" + std::to_string(height) + "@30";
+}
+
+// Runs one of the listener's conversions, from the same frame every time
+class ListenerBenchmark : public Benchmark
+{
+public:
+	class Listener : public AstraFrameListener
+	{
+	public:
+		using AstraFrameListener::updateDepth;
+		using AstraFrameListener::updateColor;
+		using AstraFrameListener::updateIR_16;
+		using AstraFrameListener::updateIR_RGB;
+	};
+
+	using Update = void (Listener::*)(const FrameSet&);
+
+	ListenerBenchmark(Update u) :
+		update(u)
+	{
+	}
+
+	// Lights the depth with normals from reprojected points
+	ListenerBenchmark*
+	pointNormals()
+	{
+		listener.setDepthNormals(false);
+		return this;
+	}
+
+	// Outputs the normals for the GPU to light, or the depth or points, instead
+	ListenerBenchmark*
+	depthOutput(AstraFrameListener::DepthOutput output)
+	{
+		listener.setDepthOutput(output);
+		return this;
+	}
+
+	virtual void
+	setup(int width, int height) override
+	{
+		source.reset(new SyntheticFrameSource(syntheticDevice(width, height).c_str()));
+		generateFrames(*source, frames);
+
+		// Never pumped, it's only there for the field of view
+		listener.connectSensor(syntheticDevice(width, height).c_str());
+	}
+
+	virtual void
+	run() override
+	{
+		(listener.*update)(frames);
+	}
+
+private:
+	Update			update;
+	Listener		listener;
+
+	std::unique_ptr<SyntheticFrameSource>	source;
+	FrameSet		frames;
+};
+
+class VisualizerBenchmark : public Benchmark
+{
+public:
+	enum Stage
+	{
+		UPDATE,
+		UPDATE_DEPTH,
+		CALCULATE_NORMALS,
+		BOX_BLUR_FAST,
+		BOX_BLUR_OCTAHEDRAL,
+		BOX_BLUR_SEPARABLE,
+	};
+
+	VisualizerBenchmark(Stage s, LitDepthVisualizer::NormalFormat format = LitDepthVisualizer::NORMAL_FLOAT, bool fused = false) :
+		stage(s)
+	{
+		visualizer.set_normal_format(format);
+		visualizer.set_fused(fused);
+	}
+
+	// Blurs with box_blur_separable() instead of box_blur_fast()
+	VisualizerBenchmark*
+	boxBlur(unsigned int radius)
+	{
+		visualizer.set_blur_mode(LitDepthVisualizer::BLUR_BOX);
+		visualizer.set_blur_radius(radius);
+		return this;
+	}
+
+	// Normals from integral images over a window this wide instead of cross products
+	VisualizerBenchmark*
+	integral(unsigned int window)
+	{
+		visualizer.set_normal_estimator(LitDepthVisualizer::ESTIMATE_INTEGRAL);
+		visualizer.set_integral_window(window);
+		return this;
+	}
+
+	// Outputs the normals for the GPU to light instead of shading them
+	VisualizerBenchmark*
+	normalOutput(LitDepthVisualizer::Output output)
+	{
+		visualizer.set_output(output);
+		return this;
+	}
+
+	VisualizerBenchmark*
+	planes()
+	{
+		visualizer.set_layout(LitDepthVisualizer::LAYOUT_SOA);
+		return this;
+	}
+
+	// Shades with the scalar loop even where the CPU has AVX2
+	VisualizerBenchmark*
+	scalar()
+	{
+		visualizer.set_simd(false);
+		return this;
+	}
+
+	virtual void
+	setup(int w, int h) override
+	{
+		width = w;
+		height = h;
+
+		source.reset(new SyntheticFrameSource(syntheticDevice(width, height).c_str()));
+		generateFrames(*source, frames);
+		source->getFieldOfView(hFov, vFov);
+		points = reprojectFrames(*source, frames, reprojector);
+		if (stage == UPDATE_DEPTH)
+			visualizer.set_normal_source(LitDepthVisualizer::NORMALS_DEPTH);
+
+		// Normals for the blur to work on
+		normals.resize(size_t(width) * height);
+		blurred.resize(size_t(width) * height);
+		for (size_t i = 0; i < normals.size(); i++)
+			normals[i] = astra::Vector3f::normalize(astra::Vector3f(float(i % 7) - 3.0f, float(i % 5) - 2.0f, -4.0f));
+
+		octNormals.resize(normals.size());
+		octBlurred.resize(normals.size());
+		octRows.resize(size_t(width) * 2);
+		for (size_t i = 0; i < normals.size(); i++)
+			octNormals[i] = LitDepthVisualizer::encode_normal(normals[i]);
+	}
+
+	virtual void
+	run() override
+	{
+		switch (stage)
+		{
+		case UPDATE:
+			visualizer.update(points.data, width, height);
+			break;
+		case UPDATE_DEPTH:
+			visualizer.update_depth(frames.depth.data, width, height, hFov, vFov);
+			break;
+		case CALCULATE_NORMALS:
+			visualizer.calculate_normals(points.data, width, height);
+			break;
+		case BOX_BLUR_FAST:
+			LitDepthVisualizer::box_blur_fast(normals.data(), blurred.data(), width, height);
+			break;
+		case BOX_BLUR_OCTAHEDRAL:
+			LitDepthVisualizer::box_blur_octahedral(octNormals.data(), octBlurred.data(), width, height, octRows.data());
+			break;
+		case BOX_BLUR_SEPARABLE:
+			LitDepthVisualizer::box_blur_separable(normals.data(), blurred.data(), width, height,
+				int(visualizer.get_blur_radius()), octRows.data());
+			break;
+		}
+	}
+
+private:
+	Stage			stage;
+	int				width = 0;
+	int				height = 0;
+	float			hFov = 0.0f;
+	float			vFov = 0.0f;
+
+	LitDepthVisualizer	visualizer;
+
+	std::unique_ptr<SyntheticFrameSource>	source;
+	FrameSet		frames;
+	DepthReprojector	reprojector;
+	FrameView<astra::Vector3f>	points;
+
+	std::vector<astra::Vector3f>	normals;
+	std::vector<astra::Vector3f>	blurred;
+
+	std::vector<LitDepthVisualizer::OctNormal>	octNormals;
+	std::vector<LitDepthVisualizer::OctNormal>	octBlurred;
+	std::vector<astra::Vector3f>	octRows;
+};
+
+// Making the points from the depth, in place of the SDK's PointStream
+class ReprojectorBenchmark : public Benchmark
+{
+public:
+	ReprojectorBenchmark(int step = 1, bool simd = true)
+	{
+		reprojector.setDecimation(step);
+		reprojector.setSimd(simd);
+	}
+
+	virtual void
+	setup(int width, int height) override
+	{
+		source.reset(new SyntheticFrameSource(syntheticDevice(width, height).c_str()));
+		generateFrames(*source, frames);
+		source->getFieldOfView(hFov, vFov);
+	}
+
+	virtual void
+	run() override
+	{
+		reprojector.reproject(frames.depth, hFov, vFov);
+	}
+
+private:
+	float			hFov = 0.0f;
+	float			vFov = 0.0f;
+
+	DepthReprojector	reprojector;
+
+	std::unique_ptr<SyntheticFrameSource>	source;
+	FrameSet		frames;
+};
+
+// OrbbecAstraTOP::fillBuffer() without the TOP around it, one of the kernels
+class PackBenchmark : public Benchmark
+{
+public:
+	PackBenchmark(FramePacker::Source s, FramePacker::Destination d, int packThreads = 0) :
+		source(s),
+		destination(d),
+		threads(packThreads)
+	{
+		pool.setThreads(threads);
+	}
+
+	virtual void
+	setup(int w, int h) override
+	{
+		width = w;
+		height = h;
+
+		// Points and halves made of bytes aren't anything in particular, but they're still numbers
+		src.resize(size_t(width) * height * FramePacker::sourceBytesPerPixel(source));
+		dst.resize(size_t(width) * height * FramePacker::destinationBytesPerPixel(destination));
+		for (size_t i = 0; i < src.size(); i++)
+			src[i] = uint8_t(i * 37) & 0x3f;
+	}
+
+	virtual void
+	run() override
+	{
+		if (threads > 0)
+			FramePacker::pack(source, destination, src.data(), dst.data(), width, height, pool);
+		else
+			FramePacker::pack(source, destination, src.data(), dst.data(), width, height);
+	}
+
+private:
+	FramePacker::Source			source;
+	FramePacker::Destination	destination;
+
+	// In bands over the pool when it's not 0, even for 1
+	int				threads;
+	WorkerPool		pool;
+
+	int				width = 0;
+	int				height = 0;
+
+	std::vector<uint8_t>	src;
+	std::vector<uint8_t>	dst;
+};
+
+// The lit depth from the depth frame to the uploaded pixels, as whole frame passes of
+// update_depth(), the flip and the pack, or a tile at a time with TiledDepthRenderer
+class TiledBenchmark : public Benchmark
+{
+public:
+	// A tile size of 0 is the whole frame passes, with the pack spread over the threads
+	TiledBenchmark(int size, int packThreads, FramePacker::Destination d = FramePacker::DEST_RGBA32_FLOAT) :
+		tileSize(size),
+		destination(d)
+	{
+		visualizer.set_normal_source(LitDepthVisualizer::NORMALS_DEPTH);
+		renderer.setTileSize(size);
+		pool.setThreads(packThreads);
+	}
+
+	TiledBenchmark*
+	boxBlur(unsigned int radius)
+	{
+		visualizer.set_blur_mode(LitDepthVisualizer::BLUR_BOX);
+		visualizer.set_blur_radius(radius);
+		return this;
+	}
+
+	virtual void
+	setup(int w, int h) override
+	{
+		width = w;
+		height = h;
+
+		source.reset(new SyntheticFrameSource(syntheticDevice(width, height).c_str()));
+		generateFrames(*source, frames);
+		source->getFieldOfView(hFov, vFov);
+
+		flipped.resize(size_t(width) * height);
+		dst.resize(size_t(width) * height * FramePacker::destinationBytesPerPixel(destination));
+	}
+
+	virtual void
+	run() override
+	{
+		if (tileSize > 0)
+		{
+			renderer.render(visualizer, frames.depth.data, width, height, hFov, vFov, destination, dst.data(), pool);
+			return;
+		}
+
+		visualizer.update_depth(frames.depth.data, width, height, hFov, vFov);
+		const astra::RgbPixel* lit = visualizer.get_output();
+		std::reverse_copy(lit, lit + flipped.size(), flipped.data());
+		FramePacker::pack(FramePacker::SOURCE_RGB888, destination, (const uint8_t*)flipped.data(), dst.data(), width, height, pool);
+	}
+
+private:
+	int				tileSize;
+	FramePacker::Destination	destination;
+
+	int				width = 0;
+	int				height = 0;
+	float			hFov = 0.0f;
+	float			vFov = 0.0f;
+
+	LitDepthVisualizer		visualizer;
+	TiledDepthRenderer		renderer;
+	WorkerPool				pool;
+
+	std::unique_ptr<SyntheticFrameSource>	source;
+	FrameSet		frames;
+	std::vector<astra::RgbPixel>	flipped;
+	std::vector<uint8_t>			dst;
+};
+
+// Compressing the depth the way FrameRecorder does, or decompressing it for playback
+class DepthCodecBenchmark : public Benchmark
+{
+public:
+	DepthCodecBenchmark(bool d) :
+		decode(d)
+	{
+	}
+
+	virtual void
+	setup(int w, int h) override
+	{
+		width = w;
+		height = h;
+
+		source.reset(new SyntheticFrameSource(syntheticDevice(width, height).c_str()));
+		generateFrames(*source, frames);
+
+		encoded.resize(DepthCodec::maxEncodedSize(width, height));
+		encodedSize = DepthCodec::encode(frames.depth.data, width, height, encoded.data());
+		decoded.resize(size_t(width) * height);
+	}
+
+	virtual void
+	run() override
+	{
+		if (decode)
+			DepthCodec::decode(encoded.data(), encodedSize, decoded.data(), width, height);
+		else
+			DepthCodec::encode(frames.depth.data, width, height, encoded.data());
+	}
+
+private:
+	bool			decode;
+	int				width = 0;
+	int				height = 0;
+
+	std::unique_ptr<SyntheticFrameSource>	source;
+	FrameSet		frames;
+
+	std::vector<uint8_t>	encoded;
+	size_t			encodedSize = 0;
+	std::vector<int16_t>	decoded;
+};
+
+// A buffer going through the queue the way the producer thread and execute() pass it
+class FrameQueueBenchmark : public Benchmark
+{
+public:
+	FrameQueueBenchmark() :
+		queue(&context)
+	{
+	}
+
+	virtual void
+	setup(int width, int height) override
+	{
+		byteSize = uint64_t(width) * height * 4 * sizeof(float);
+	}
+
+	virtual void
+	run() override
+	{
+		BufferInfo bufInfo;
+		bufInfo.buf = queue.getBufferToUpdate(byteSize, TOP_BufferFlags::None);
+		queue.updateComplete(bufInfo);
+
+		// Stands in for TOP_Output::uploadBuffer(), which takes the buffer back
+		BufferInfo upload = queue.getBufferToUpload();
+		context.returnBuffer(&upload.buf);
+	}
+
+private:
+	FakeTOPContext	context;
+	FrameQueue		queue;
+	uint64_t		byteSize = 0;
+};
+
+static std::vector<BenchmarkCase>
+createCases()
+{
+	using L = ListenerBenchmark::Listener;
+
+	return {
+		{ "updateDepth", 2 + 3, []() { return new ListenerBenchmark(&L::updateDepth); } },
+		{ "updateDepth (points)", 2 + 3, []() { return (new ListenerBenchmark(&L::updateDepth))->pointNormals(); } },
+		{ "updateDepth (normals rg16f)", 2 + 4, []() { return (new ListenerBenchmark(&L::updateDepth))->depthOutput(AstraFrameListener::DEPTH_NORMALS_RG16F); } },
+		{ "updateDepth (depth output)", 2 + 2, []() { return (new ListenerBenchmark(&L::updateDepth))->depthOutput(AstraFrameListener::DEPTH_MILLIMETRES); } },
+		{ "updateDepth (points output)", 2 + 12, []() { return (new ListenerBenchmark(&L::updateDepth))->depthOutput(AstraFrameListener::DEPTH_POINTS); } },
+		{ "updateColor", 3 + 3, []() { return new ListenerBenchmark(&L::updateColor); } },
+		{ "updateIR_16", 2 + 2, []() { return new ListenerBenchmark(&L::updateIR_16); } },
+		{ "updateIR_RGB", 3 + 3, []() { return new ListenerBenchmark(&L::updateIR_RGB); } },
+		{ "LitDepthVisualizer::update", 12 + 3, []() { return new VisualizerBenchmark(VisualizerBenchmark::UPDATE); } },
+		{ "LitDepthVisualizer::update_depth", 2 + 3, []() { return new VisualizerBenchmark(VisualizerBenchmark::UPDATE_DEPTH); } },
+		{ "LitDepthVisualizer::update_depth (scalar)", 2 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE_DEPTH))->scalar(); } },
+		{ "LitDepthVisualizer::update_depth (normals rgba16f)", 2 + 8, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE_DEPTH))->normalOutput(LitDepthVisualizer::OUTPUT_NORMALS_RGBA16F); } },
+		{ "LitDepthVisualizer::update_depth (normals rg16f)", 2 + 4, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE_DEPTH))->normalOutput(LitDepthVisualizer::OUTPUT_NORMALS_RG16F); } },
+		{ "LitDepthVisualizer::update (soa, normals rg16f)", 12 + 4, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->planes()->normalOutput(LitDepthVisualizer::OUTPUT_NORMALS_RG16F); } },
+		{ "LitDepthVisualizer::update (integral w=3)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->integral(3); } },
+		{ "LitDepthVisualizer::update (integral w=31)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->integral(31); } },
+		{ "LitDepthVisualizer::update_depth (integral w=9)", 2 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE_DEPTH))->integral(9); } },
+		{ "DepthReprojector::reproject", 2 + 12, []() { return new ReprojectorBenchmark(); } },
+		{ "DepthReprojector::reproject (scalar)", 2 + 12, []() { return new ReprojectorBenchmark(1, false); } },
+		{ "DepthReprojector::reproject (decimate 2)", 2 + 3, []() { return new ReprojectorBenchmark(2); } },
+		{ "LitDepthVisualizer::calculate_normals", 12 + 12, []() { return new VisualizerBenchmark(VisualizerBenchmark::CALCULATE_NORMALS); } },
+		{ "LitDepthVisualizer::box_blur_fast", 12 + 12, []() { return new VisualizerBenchmark(VisualizerBenchmark::BOX_BLUR_FAST); } },
+		{ "LitDepthVisualizer::update (fused)", 12 + 3, []() { return new VisualizerBenchmark(VisualizerBenchmark::UPDATE, LitDepthVisualizer::NORMAL_FLOAT, true); } },
+		{ "LitDepthVisualizer::update (soa)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->planes(); } },
+		{ "LitDepthVisualizer::calculate_normals (soa)", 12 + 36, []() { return (new VisualizerBenchmark(VisualizerBenchmark::CALCULATE_NORMALS))->planes(); } },
+		{ "LitDepthVisualizer::update (soa, scalar)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->planes()->scalar(); } },
+		{ "LitDepthVisualizer::update (scalar)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->scalar(); } },
+		{ "LitDepthVisualizer::update (fused, scalar)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE, LitDepthVisualizer::NORMAL_FLOAT, true))->scalar(); } },
+		{ "LitDepthVisualizer::update (oct)", 12 + 3, []() { return new VisualizerBenchmark(VisualizerBenchmark::UPDATE, LitDepthVisualizer::NORMAL_OCTAHEDRAL); } },
+		{ "LitDepthVisualizer::calculate_normals (oct)", 12 + 4, []() { return new VisualizerBenchmark(VisualizerBenchmark::CALCULATE_NORMALS, LitDepthVisualizer::NORMAL_OCTAHEDRAL); } },
+		{ "LitDepthVisualizer::box_blur_octahedral", 4 + 4, []() { return new VisualizerBenchmark(VisualizerBenchmark::BOX_BLUR_OCTAHEDRAL); } },
+		{ "LitDepthVisualizer::box_blur_separable (r=1)", 12 + 12, []() { return (new VisualizerBenchmark(VisualizerBenchmark::BOX_BLUR_SEPARABLE))->boxBlur(1); } },
+		{ "LitDepthVisualizer::box_blur_separable (r=8)", 12 + 12, []() { return (new VisualizerBenchmark(VisualizerBenchmark::BOX_BLUR_SEPARABLE))->boxBlur(8); } },
+		{ "LitDepthVisualizer::update (box r=4)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE))->boxBlur(4); } },
+		{ "LitDepthVisualizer::update (fused, box r=4)", 12 + 3, []() { return (new VisualizerBenchmark(VisualizerBenchmark::UPDATE, LitDepthVisualizer::NORMAL_FLOAT, true))->boxBlur(4); } },
+		{ "fillBuffer (rgb888 -> rgba32f)", 3 + 16, []() { return new PackBenchmark(FramePacker::SOURCE_RGB888, FramePacker::DEST_RGBA32_FLOAT); } },
+		{ "fillBuffer (rgb888 -> rgba32f, 1 pack thread)", 3 + 16, []() { return new PackBenchmark(FramePacker::SOURCE_RGB888, FramePacker::DEST_RGBA32_FLOAT, 1); } },
+		{ "fillBuffer (rgb888 -> rgba32f, 4 pack threads)", 3 + 16, []() { return new PackBenchmark(FramePacker::SOURCE_RGB888, FramePacker::DEST_RGBA32_FLOAT, 4); } },
+		{ "fillBuffer (rgb888 -> rgba32f, 8 pack threads)", 3 + 16, []() { return new PackBenchmark(FramePacker::SOURCE_RGB888, FramePacker::DEST_RGBA32_FLOAT, 8); } },
+		{ "fillBuffer (points -> rgba16f, 4 pack threads)", 12 + 8, []() { return new PackBenchmark(FramePacker::SOURCE_POINTS, FramePacker::DEST_RGBA16_FLOAT, 4); } },
+		{ "fillBuffer (rgb888 -> rgba8)", 3 + 4, []() { return new PackBenchmark(FramePacker::SOURCE_RGB888, FramePacker::DEST_RGBA8_FIXED); } },
+		{ "fillBuffer (ir16 -> rgba16f)", 2 + 8, []() { return new PackBenchmark(FramePacker::SOURCE_IR16, FramePacker::DEST_RGBA16_FLOAT); } },
+		{ "fillBuffer (depth16 -> rgba32f)", 2 + 16, []() { return new PackBenchmark(FramePacker::SOURCE_DEPTH16, FramePacker::DEST_RGBA32_FLOAT); } },
+		{ "fillBuffer (points -> rgba16f)", 12 + 8, []() { return new PackBenchmark(FramePacker::SOURCE_POINTS, FramePacker::DEST_RGBA16_FLOAT); } },
+		{ "fillBuffer (normals rg16f)", 4 + 4, []() { return new PackBenchmark(FramePacker::SOURCE_NORMALS_RG16F, FramePacker::DEST_RG16_FLOAT); } },
+		{ "update_depth + fillBuffer (rgba32f)", 2 + 16, []() { return new TiledBenchmark(0, 1); } },
+		{ "update_depth + fillBuffer (rgba32f, 4 pack threads)", 2 + 16, []() { return new TiledBenchmark(0, 4); } },
+		{ "TiledDepthRenderer (tile 32, rgba32f)", 2 + 16, []() { return new TiledBenchmark(32, 1); } },
+		{ "TiledDepthRenderer (tile 64, rgba32f)", 2 + 16, []() { return new TiledBenchmark(64, 1); } },
+		{ "TiledDepthRenderer (tile 128, rgba32f)", 2 + 16, []() { return new TiledBenchmark(128, 1); } },
+		{ "TiledDepthRenderer (tile 64, rgba32f, 4 pack threads)", 2 + 16, []() { return new TiledBenchmark(64, 4); } },
+		{ "TiledDepthRenderer (tile 64, rgba8)", 2 + 4, []() { return new TiledBenchmark(64, 1, FramePacker::DEST_RGBA8_FIXED); } },
+		{ "update_depth + fillBuffer (box r=4, rgba32f)", 2 + 16, []() { return (new TiledBenchmark(0, 1))->boxBlur(4); } },
+		{ "TiledDepthRenderer (tile 64, box r=4, rgba32f)", 2 + 16, []() { return (new TiledBenchmark(64, 1))->boxBlur(4); } },
+		{ "DepthCodec::encode", 2, []() { return new DepthCodecBenchmark(false); } },
+		{ "DepthCodec::decode", 2, []() { return new DepthCodecBenchmark(true); } },
+		{ "FrameQueue round trip", 0, []() { return new FrameQueueBenchmark(); } },
+	};
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Runs 'iterations' of the case on each of 'threads' threads at once, returns the wall time in seconds
+static double
+runThreads(const BenchmarkCase& c, int width, int height, int threads, int iterations)
+{
+	std::vector<std::unique_ptr<Benchmark>> instances;
+	for (int i = 0; i < threads; i++)
+	{
+		instances.emplace_back(c.create());
+		instances.back()->setup(width, height);
+		instances.back()->run();
+	}
+
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++)
+	{
+		Benchmark* instance = instances[i].get();
+		workers.emplace_back([instance, iterations, &ready, &go]()
+		{
+			ready++;
+			while (!go.load())
+				std::this_thread::yield();
+
+			for (int n = 0; n < iterations; n++)
+				instance->run();
+		});
+	}
+
+	while (ready.load() != threads)
+		std::this_thread::yield();
+
+	const Clock::time_point begin = Clock::now();
+	go.store(true);
+
+	for (auto& worker : workers)
+		worker.join();
+
+	return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// Number of iterations that take about 'minTime' seconds on one thread
+static int
+calibrate(const BenchmarkCase& c, int width, int height, double minTime)
+{
+	std::unique_ptr<Benchmark> instance(c.create());
+	instance->setup(width, height);
+	instance->run();
+
+	int iterations = 1;
+	for (;;)
+	{
+		const Clock::time_point begin = Clock::now();
+		for (int n = 0; n < iterations; n++)
+			instance->run();
+		const double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+		if (elapsed >= minTime / 4.0 || iterations >= (1 << 24))
+			return std::max(1, int(iterations * minTime / std::max(elapsed, 1e-9)));
+
+		iterations *= 4;
+	}
+}
+
+static std::vector<int>
+parseThreads(const char* list)
+{
+	std::vector<int> threads;
+	while (*list)
+	{
+		const int n = atoi(list);
+		if (n > 0)
+			threads.push_back(n);
+
+		const char* comma = strchr(list, ',');
+		if (!comma)
+			break;
+		list = comma + 1;
+	}
+	return threads;
+}
+
+static std::vector<int>
+defaultThreads()
+{
+	const int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+
+	std::vector<int> threads;
+	for (int n = 1; n < hardware; n *= 2)
+		threads.push_back(n);
+	threads.push_back(hardware);
+	return threads;
+}
+
+// Records how long after capture each frame reached the listener
+class AcquisitionListener : public FrameSource::Listener
+{
+public:
+	virtual void
+	on_frame_ready(const FrameSet& frames) override
+	{
+		const auto latency = Clock::now() - astra_stub::lastCaptureTime();
+		latencies.push_back(std::chrono::duration<double, std::milli>(latency).count());
+	}
+
+	std::vector<double>	latencies;
+};
+
+static void
+runAcquisition(const char* name, bool polling, double seconds)
+{
+	const double fps = 30.0;
+
+	AcquisitionListener listener;
+	std::unique_ptr<FrameSource> source;
+	if (polling)
+		source.reset(new AstraPollingFrameSource("device/sensor0"));
+	else
+		source.reset(new AstraFrameSource("device/sensor0"));
+
+	source->setListener(&listener);
+	source->setStreams(FrameSource::STREAM_DEPTH);
+	source->setWaitTimeout(50);
+
+	// The sensor starts capturing once the source is set up
+	astra_stub::setFrameRate(fps);
+
+	// The same pacing as OrbbecAstraTOP's producer loop once it knows the sensor interval
+	const long long period = std::max(1000LL, std::min(15500LL, (long long)(1e6 / fps / 4.0)));
+
+	const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+	while (Clock::now() < end)
+	{
+		const auto begin = Clock::now();
+		source->update();
+
+		if (!source->waitsForFrames())
+		{
+			const long long duration = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+			if (period > duration)
+				std::this_thread::sleep_for(std::chrono::microseconds(period - duration));
+		}
+	}
+
+	source.reset();
+	astra_stub::setFrameRate(0.0);
+
+	std::vector<double>& l = listener.latencies;
+	if (l.empty())
+	{
+		printf("%-44s %10s\n", name, "no frames");
+		return;
+	}
+
+	std::sort(l.begin(), l.end());
+	double total = 0.0;
+	for (double latency : l)
+		total += latency;
+
+	printf("%-44s %10zu %10.3f %10.3f %10.3f %10.3f\n", name, l.size(), total / l.size(),
+		l[l.size() / 2], l[std::min(l.size() - 1, l.size() * 99 / 100)], l.back());
+}
+
+static std::vector<astra::Vector3f>
+randomNormals(size_t count)
+{
+	std::vector<astra::Vector3f> normals(count);
+
+	uint32_t seed = 12345;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f;
+	};
+
+	for (astra::Vector3f& normal : normals)
+		normal = astra::Vector3f::normalize(astra::Vector3f(random(), random(), random()));
+
+	return normals;
+}
+
+// The angle in degrees between two blurred normals, atan2 keeps its precision for small
+// angles where acos of the dot product doesn't
+static double
+angleBetween(const astra::Vector3f& a, const astra::Vector3f& b)
+{
+	const astra::Vector3f cross = a.cross(b);
+	const double sine = std::sqrt(double(cross.x) * cross.x + double(cross.y) * cross.y + double(cross.z) * cross.z);
+	return std::atan2(sine, double(a.dot(b))) * 180.0 / 3.14159265358979;
+}
+
+// The largest angle in degrees between the normals box_blur_fast() and box_blur_octahedral()
+// blur random directions to, where the sum of the six is at least unit length
+static double
+blurAngleError(int width, int height)
+{
+	const size_t pixels = size_t(width) * height;
+
+	std::vector<astra::Vector3f> normals = randomNormals(pixels);
+	std::vector<LitDepthVisualizer::OctNormal> octNormals(pixels);
+
+	for (size_t i = 0; i < pixels; i++)
+		octNormals[i] = LitDepthVisualizer::encode_normal(normals[i]);
+
+	std::vector<astra::Vector3f> blurred(pixels);
+	std::vector<LitDepthVisualizer::OctNormal> octBlurred(pixels);
+	std::vector<astra::Vector3f> rows(size_t(width) * 2);
+
+	LitDepthVisualizer::box_blur_fast(normals.data(), blurred.data(), width, height);
+	LitDepthVisualizer::box_blur_octahedral(octNormals.data(), octBlurred.data(), width, height, rows.data());
+
+	double maxAngle = 0.0;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const astra::Vector3f expected = astra::Vector3f::normalize(blurred[i]);
+		const astra::Vector3f actual = LitDepthVisualizer::decode_normal(octBlurred[i]);
+
+		// Both empty, or only one of them
+		const bool expectedEmpty = expected.x == 0.0f && expected.y == 0.0f && expected.z == 0.0f;
+		const bool actualEmpty = octBlurred[i].x == LitDepthVisualizer::OctNormalNone;
+		if (expectedEmpty || actualEmpty)
+		{
+			if (expectedEmpty != actualEmpty)
+				maxAngle = 180.0;
+			continue;
+		}
+
+		// Where the directions nearly cancel out the sum's direction is meaningless, and
+		// tips over with the smallest error in its inputs
+		const astra::Vector3f& sum = blurred[i];
+		if (sum.x * sum.x + sum.y * sum.y + sum.z * sum.z < 1.0f)
+			continue;
+
+		maxAngle = std::max(maxAngle, angleBetween(expected, actual));
+	}
+
+	return maxAngle;
+}
+
+// The largest angle in degrees between the sums box_blur_separable() makes of random
+// directions and the sums of every box added up in double precision, where the sum is at
+// least unit length
+static double
+separableAngleError(int width, int height, int radius)
+{
+	const size_t pixels = size_t(width) * height;
+
+	const std::vector<astra::Vector3f> normals = randomNormals(pixels);
+	std::vector<astra::Vector3f> blurred(pixels);
+	std::vector<astra::Vector3f> rows(size_t(width) * 2);
+
+	LitDepthVisualizer::box_blur_separable(normals.data(), blurred.data(), width, height, radius, rows.data());
+
+	double maxAngle = 0.0;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			double sum[3] = { 0.0, 0.0, 0.0 };
+			for (int by = std::max(0, y - radius); by <= std::min(height - 1, y + radius); by++)
+			{
+				for (int bx = std::max(0, x - radius); bx <= std::min(width - 1, x + radius); bx++)
+				{
+					const astra::Vector3f& normal = normals[size_t(by) * width + bx];
+					sum[0] += normal.x;
+					sum[1] += normal.y;
+					sum[2] += normal.z;
+				}
+			}
+
+			if (sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2] < 1.0)
+				continue;
+
+			const astra::Vector3f expected{ float(sum[0]), float(sum[1]), float(sum[2]) };
+			maxAngle = std::max(maxAngle, angleBetween(expected, blurred[size_t(y) * width + x]));
+		}
+	}
+
+	return maxAngle;
+}
+
+static float
+halfToFloat(uint16_t half)
+{
+	const uint32_t sign = uint32_t(half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1f;
+	const uint32_t mantissa = half & 0x3ff;
+
+	float value;
+	if (exponent == 0)
+		value = std::ldexp(float(mantissa), -24);
+	else if (exponent == 31)
+		value = mantissa ? NAN : INFINITY;
+	else
+		value = std::ldexp(float(mantissa | 0x400), int(exponent) - 25);
+
+	return sign ? -value : value;
+}
+
+// The largest angle in degrees between the RG16F octahedral normals of the depth and the
+// RGBA16F normals of the points, 180 if they disagree about which pixels have normals
+static double
+normalOutputAngleError(const SyntheticFrameSource& source, const FrameSet& frames, const FrameView<astra::Vector3f>& points)
+{
+	const int width = frames.depth.width;
+	const int height = frames.depth.height;
+
+	float hFov = 0.0f;
+	float vFov = 0.0f;
+	source.getFieldOfView(hFov, vFov);
+
+	LitDepthVisualizer rgbaVisualizer;
+	LitDepthVisualizer rgVisualizer;
+	rgbaVisualizer.set_output(LitDepthVisualizer::OUTPUT_NORMALS_RGBA16F);
+	rgVisualizer.set_output(LitDepthVisualizer::OUTPUT_NORMALS_RG16F);
+	rgVisualizer.set_normal_source(LitDepthVisualizer::NORMALS_DEPTH);
+
+	rgbaVisualizer.update(points.data, width, height);
+	rgVisualizer.update_depth(frames.depth.data, width, height, hFov, vFov);
+
+	const uint16_t* rgba = rgbaVisualizer.get_normal_output();
+	const uint16_t* rg = rgVisualizer.get_normal_output();
+
+	double maxAngle = 0.0;
+	for (size_t i = 0; i < size_t(width) * height; i++)
+	{
+		const astra::Vector3f expected(halfToFloat(rgba[i * 4]), halfToFloat(rgba[i * 4 + 1]), halfToFloat(rgba[i * 4 + 2]));
+		const float x = halfToFloat(rg[i * 2]);
+		const float y = halfToFloat(rg[i * 2 + 1]);
+
+		const bool expectedEmpty = halfToFloat(rgba[i * 4 + 3]) == 0.0f;
+		const bool actualEmpty = x == LitDepthVisualizer::OctTexelNone;
+		if (expectedEmpty || actualEmpty)
+		{
+			if (expectedEmpty != actualEmpty)
+				maxAngle = 180.0;
+			continue;
+		}
+
+		// Unfolded the same as decode_normal()
+		const float z = 1.0f - std::fabs(x) - std::fabs(y);
+		const float unfoldedX = z < 0.0f ? (1.0f - std::fabs(y)) * std::copysign(1.0f, x) : x;
+		const float unfoldedY = z < 0.0f ? (1.0f - std::fabs(x)) * std::copysign(1.0f, y) : y;
+		const astra::Vector3f actual = astra::Vector3f::normalize(astra::Vector3f(unfoldedX, unfoldedY, z));
+
+		maxAngle = std::max(maxAngle, angleBetween(expected, actual));
+	}
+
+	return maxAngle;
+}
+
+// Percentage of the points of a decimated region, and of the scalar loop, that aren't the
+// same as the points of the whole frame at those pixels
+static double
+reprojectionDiffering(const SyntheticFrameSource& source, const FrameSet& frames, const FrameView<astra::Vector3f>& points)
+{
+	const int width = frames.depth.width;
+	const int height = frames.depth.height;
+
+	DepthReprojector scalarReprojector;
+	scalarReprojector.setSimd(false);
+	const FrameView<astra::Vector3f> scalarPoints = reprojectFrames(source, frames, scalarReprojector);
+
+	const int step = 3;
+	const int left = width / 5;
+	const int top = height / 7;
+	DepthReprojector regionReprojector;
+	regionReprojector.setRegion(left, top, width / 2, height / 2);
+	regionReprojector.setDecimation(step);
+	const FrameView<astra::Vector3f> regionPoints = reprojectFrames(source, frames, regionReprojector);
+
+	auto same = [](const astra::Vector3f& a, const astra::Vector3f& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	};
+
+	size_t differing = 0;
+	for (size_t i = 0; i < size_t(width) * height; i++)
+		differing += !same(points.data[i], scalarPoints.data[i]);
+
+	for (int y = 0; y < regionPoints.height; y++)
+	{
+		for (int x = 0; x < regionPoints.width; x++)
+		{
+			const size_t i = size_t(top + y * step) * width + left + x * step;
+			differing += !same(points.data[i], regionPoints.data[size_t(y) * regionPoints.width + x]);
+		}
+	}
+
+	const size_t compared = size_t(width) * height + size_t(regionPoints.width) * regionPoints.height;
+	return 100.0 * differing / compared;
+}
+
+// Pixels that don't come back bit for bit from DepthCodec, all of them if decode() turns
+// down what encode() wrote
+static size_t
+codecDiffering(const int16_t* depth, int width, int height)
+{
+	const size_t pixels = size_t(width) * height;
+
+	std::vector<uint8_t> encoded(DepthCodec::maxEncodedSize(width, height));
+	const size_t size = DepthCodec::encode(depth, width, height, encoded.data());
+
+	std::vector<int16_t> decoded(pixels);
+	if (!DepthCodec::decode(encoded.data(), size, decoded.data(), width, height))
+		return pixels;
+
+	size_t differing = 0;
+	for (size_t i = 0; i < pixels; i++)
+		differing += depth[i] != decoded[i];
+	return differing;
+}
+
+// The depth of the round trips that aren't the synthetic scene
+static bool
+runCodecAccuracy()
+{
+	std::mt19937 random(1234);
+	auto randomDepth = [&](int width, int height)
+	{
+		std::vector<int16_t> depth(size_t(width) * height);
+		for (int16_t& d : depth)
+			d = int16_t(uint16_t(random()));
+		return depth;
+	};
+
+	// The extremes side by side, whose difference wraps around to -1 in 16 bits
+	auto alternatingDepth = [](int width, int height)
+	{
+		std::vector<int16_t> depth(size_t(width) * height);
+		for (size_t i = 0; i < depth.size(); i++)
+			depth[i] = (i + i / width) % 2 ? INT16_MAX : INT16_MIN;
+		return depth;
+	};
+
+	// Every step is half the range, which only the three byte token can hold
+	auto largestStepDepth = [](int width, int height)
+	{
+		const int16_t steps[4] = { 0, INT16_MAX, 0, INT16_MIN };
+
+		std::vector<int16_t> depth(size_t(width) * height);
+		for (size_t i = 0; i < depth.size(); i++)
+			depth[i] = steps[i % 4];
+		return depth;
+	};
+
+	// One run the length of the frame, a varint of several bytes
+	auto zeroDepth = [](int width, int height)
+	{
+		return std::vector<int16_t>(size_t(width) * height, 0);
+	};
+
+	struct CodecCase
+	{
+		const char*				name;
+		int						width;
+		int						height;
+		std::vector<int16_t>	depth;
+	};
+
+	const CodecCase cases[] =
+	{
+		{ "DepthCodec (random)", 640, 480, randomDepth(640, 480) },
+		{ "DepthCodec (alternating extremes)", 640, 480, alternatingDepth(640, 480) },
+		{ "DepthCodec (largest steps)", 640, 480, largestStepDepth(640, 480) },
+		{ "DepthCodec (zeros)", 1280, 960, zeroDepth(1280, 960) },
+		{ "DepthCodec (random, width 1)", 1, 480, randomDepth(1, 480) },
+		{ "DepthCodec (random, width 2)", 2, 480, randomDepth(2, 480) },
+		{ "DepthCodec (alternating extremes, width 1)", 1, 480, alternatingDepth(1, 480) },
+		{ "DepthCodec (alternating extremes, width 2)", 2, 480, alternatingDepth(2, 480) },
+		{ "DepthCodec (largest steps, width 1)", 1, 480, largestStepDepth(1, 480) },
+		{ "DepthCodec (zeros, width 1)", 1, 480, zeroDepth(1, 480) },
+	};
+
+	bool passed = true;
+	for (const CodecCase& c : cases)
+	{
+		char sizeText[32];
+		snprintf(sizeText, sizeof(sizeText), "%dx%d", c.width, c.height);
+
+		const size_t differing = codecDiffering(c.depth.data(), c.width, c.height);
+		printf("%-44s %10s %12s %12s %12.4f\n", c.name, sizeText, "-", "-", 100.0 * differing / c.depth.size());
+
+		passed &= differing == 0;
+	}
+
+	return passed;
+}
+
+// Pixels of one of the published images that don't match what was published, all of them
+// if the reader didn't get it
+template<typename T>
+static size_t
+sharedImageDiffering(const SharedFrameReader::Frame& frame, uint32_t stream, const FrameView<T>& view)
+{
+	const size_t pixels = size_t(view.width) * view.height;
+
+	const SharedFrameReader::Image* image = frame.find(stream);
+	if (!image || image->width != uint32_t(view.width) || image->height != uint32_t(view.height) ||
+		image->bytesPerPixel != sizeof(T))
+		return pixels;
+
+	size_t differing = 0;
+	for (size_t i = 0; i < pixels; i++)
+		differing += memcmp(image->data + i * sizeof(T), &view.data[i], sizeof(T)) != 0;
+	return differing;
+}
+
+// Publishes the synthetic scene at two sizes, so the second frames outgrow the first ring,
+// and reads every frame back while the ring wraps around
+static bool
+runSharedFrameAccuracy()
+{
+	const char* name = "pipeline_benchmark_accuracy";
+	const int numSlots = 2;
+
+	SharedFrameExporter exporter;
+	exporter.start(name, numSlots);
+
+	SharedFrameReader reader;
+	bool passed = !exporter.hasError() && reader.open(name);
+
+	const int sizes[][2] = { { 320, 240 }, { 640, 480 } };
+
+	uint64_t sequence = 0;
+	for (const auto& size : sizes)
+	{
+		SyntheticFrameSource source(syntheticDevice(size[0], size[1]).c_str());
+		FrameSet frames;
+		generateFrames(source, frames);
+
+		const size_t pixels = size_t(frames.depth.width) * frames.depth.height + size_t(frames.color.width) * frames.color.height +
+							  size_t(frames.ir16.width) * frames.ir16.height + size_t(frames.irRgb.width) * frames.irRgb.height;
+
+		size_t differing = 0;
+		for (int i = 0; i <= numSlots; i++)
+		{
+			const uint64_t arrivalTime = sequence + 1;
+			exporter.publish(frames, arrivalTime);
+
+			SharedFrameReader::Frame frame;
+			if (!reader.latest(frame, sequence) || frame.sequence != sequence + 1 || frame.streams != frames.streams ||
+				frame.timestamp != frames.timestamp || frame.arrivalTime != arrivalTime)
+			{
+				differing += pixels;
+				continue;
+			}
+			sequence = frame.sequence;
+
+			differing += sharedImageDiffering(frame, SHARED_FRAME_DEPTH, frames.depth);
+			differing += sharedImageDiffering(frame, SHARED_FRAME_COLOR, frames.color);
+			differing += sharedImageDiffering(frame, SHARED_FRAME_IR_16, frames.ir16);
+			differing += sharedImageDiffering(frame, SHARED_FRAME_IR_RGB, frames.irRgb);
+
+			if (!frame.isValid())
+				differing += pixels;
+		}
+
+		char sizeText[32];
+		snprintf(sizeText, sizeof(sizeText), "%dx%d", size[0], size[1]);
+		printf("%-44s %10s %12s %12s %12.4f\n", "SharedFrameReader (every stream)", sizeText, "-", "-",
+			100.0 * differing / (pixels * (numSlots + 1)));
+
+		passed &= differing == 0;
+	}
+
+	exporter.stop();
+
+	SharedFrameReader::Frame frame;
+	const bool readAfterStop = reader.latest(frame);
+	printf("%-44s %10s %12s %12s %12s\n", "SharedFrameReader (after stop)", "-", "-", "-", readAfterStop ? "read" : "none");
+
+	passed &= !readAfterStop;
+	return passed;
+}
+
+static bool
+runAccuracy()
+{
+	// Blurring encoded normals is good to about 0.01 degrees, which can tip a shaded channel over by one
+	const double maxAngle = 0.05;
+	const int maxChannelDifference = 1;
+	// Running sums only lose a little precision to the order they're added up in
+	const double maxSeparableAngle = 0.01;
+	// Halves near one are 1/2048 apart
+	const double maxOutputAngle = 0.25;
+	const int boxRadius = 4;
+
+	const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+
+	printf("%-44s %10s %12s %12s %12s\n", "against the float normal maps", "size", "blur max deg", "max channel", "% differing");
+
+	bool passed = true;
+	for (const auto& size : sizes)
+	{
+		const int width = size[0];
+		const int height = size[1];
+		const size_t pixels = size_t(width) * height;
+
+		SyntheticFrameSource source(syntheticDevice(width, height).c_str());
+		FrameSet frames;
+		generateFrames(source, frames);
+
+		DepthReprojector reprojector;
+		const FrameView<astra::Vector3f> points = reprojectFrames(source, frames, reprojector);
+
+		LitDepthVisualizer floatVisualizer;
+		LitDepthVisualizer octVisualizer;
+		LitDepthVisualizer fusedVisualizer;
+		LitDepthVisualizer boxVisualizer;
+		LitDepthVisualizer fusedBoxVisualizer;
+		LitDepthVisualizer scalarVisualizer;
+		LitDepthVisualizer planesVisualizer;
+		LitDepthVisualizer scalarPlanesVisualizer;
+		LitDepthVisualizer depthVisualizer;
+		LitDepthVisualizer depthBoxVisualizer;
+		octVisualizer.set_normal_format(LitDepthVisualizer::NORMAL_OCTAHEDRAL);
+		fusedVisualizer.set_fused(true);
+		boxVisualizer.set_blur_mode(LitDepthVisualizer::BLUR_BOX);
+		boxVisualizer.set_blur_radius(boxRadius);
+		fusedBoxVisualizer.set_blur_mode(LitDepthVisualizer::BLUR_BOX);
+		fusedBoxVisualizer.set_blur_radius(boxRadius);
+		fusedBoxVisualizer.set_fused(true);
+		scalarVisualizer.set_simd(false);
+		planesVisualizer.set_layout(LitDepthVisualizer::LAYOUT_SOA);
+		scalarPlanesVisualizer.set_layout(LitDepthVisualizer::LAYOUT_SOA);
+		scalarPlanesVisualizer.set_simd(false);
+		depthVisualizer.set_normal_source(LitDepthVisualizer::NORMALS_DEPTH);
+		depthBoxVisualizer.set_normal_source(LitDepthVisualizer::NORMALS_DEPTH);
+		depthBoxVisualizer.set_blur_mode(LitDepthVisualizer::BLUR_BOX);
+		depthBoxVisualizer.set_blur_radius(boxRadius);
+
+		float hFov = 0.0f;
+		float vFov = 0.0f;
+		source.getFieldOfView(hFov, vFov);
+
+		floatVisualizer.update(points.data, width, height);
+		octVisualizer.update(points.data, width, height);
+		fusedVisualizer.update(points.data, width, height);
+		boxVisualizer.update(points.data, width, height);
+		fusedBoxVisualizer.update(points.data, width, height);
+		scalarVisualizer.update(points.data, width, height);
+		planesVisualizer.update(points.data, width, height);
+		scalarPlanesVisualizer.update(points.data, width, height);
+		depthVisualizer.update_depth(frames.depth.data, width, height, hFov, vFov);
+		depthBoxVisualizer.update_depth(frames.depth.data, width, height, hFov, vFov);
+
+		int maxDifference = 0;
+		size_t differing = 0;
+		auto compare = [&](const LitDepthVisualizer& reference, const LitDepthVisualizer& visualizer)
+		{
+			const uint8_t* expected = (const uint8_t*)reference.get_output();
+			const uint8_t* actual = (const uint8_t*)visualizer.get_output();
+
+			maxDifference = 0;
+			differing = 0;
+			for (size_t i = 0; i < pixels * 3; i++)
+			{
+				const int difference = std::abs(int(expected[i]) - int(actual[i]));
+				maxDifference = std::max(maxDifference, difference);
+				differing += difference != 0;
+			}
+		};
+
+		// The tiles are packed into the flipped frame, an odd size so they don't line up with
+		// the 8 pixels of the AVX2 loops
+		WorkerPool tilePool;
+		tilePool.setThreads(3);
+		std::vector<uint8_t> tiled(pixels * 4);
+		auto compareTiled = [&](const LitDepthVisualizer& visualizer)
+		{
+			TiledDepthRenderer renderer;
+			renderer.setTileSize(37);
+			renderer.render(visualizer, frames.depth.data, width, height, hFov, vFov, FramePacker::DEST_RGBA8_FIXED, tiled.data(), tilePool);
+
+			const uint8_t* expected = (const uint8_t*)visualizer.get_output();
+
+			maxDifference = 0;
+			differing = 0;
+			for (size_t i = 0; i < pixels; i++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					const int difference = std::abs(int(expected[i * 3 + c]) - int(tiled[(pixels - 1 - i) * 4 + c]));
+					maxDifference = std::max(maxDifference, difference);
+					differing += difference != 0;
+				}
+			}
+		};
+
+		char sizeText[32];
+		snprintf(sizeText, sizeof(sizeText), "%dx%d", width, height);
+
+		const double angle = blurAngleError(width, height);
+		compare(floatVisualizer, octVisualizer);
+		printf("%-44s %10s %12.5f %12d %12.4f\n", "LitDepthVisualizer (oct)", sizeText, angle, maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= angle <= maxAngle && maxDifference <= maxChannelDifference;
+
+		compare(floatVisualizer, fusedVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "LitDepthVisualizer (fused)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= differing == 0;
+
+		// Against the unfused box blur rather than the 3x3 one
+		compare(boxVisualizer, fusedBoxVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "LitDepthVisualizer (fused, box)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= differing == 0;
+
+		// The reciprocal square root can tip a channel over by one
+		compare(scalarVisualizer, floatVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n",
+			floatVisualizer.uses_avx2() ? "LitDepthVisualizer (AVX2)" : "LitDepthVisualizer (no AVX2)",
+			sizeText, "-", maxDifference, 100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		// The planes sum the blur in a different order
+		compare(scalarVisualizer, planesVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "LitDepthVisualizer (soa)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		compare(scalarVisualizer, scalarPlanesVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "LitDepthVisualizer (soa, scalar)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		// The points are made as they're needed, the same as the reprojector makes them
+		compare(scalarVisualizer, depthVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "LitDepthVisualizer (depth)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		// Against the whole frame update_depth() with the same settings
+		compareTiled(depthVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "TiledDepthRenderer", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		compareTiled(depthBoxVisualizer);
+		printf("%-44s %10s %12s %12d %12.4f\n", "TiledDepthRenderer (box)", sizeText, "-", maxDifference,
+			100.0 * differing / (pixels * 3));
+
+		passed &= maxDifference <= maxChannelDifference;
+
+		// The scalar loop, and a decimated region, make exactly the same points
+		const double pointDiffering = reprojectionDiffering(source, frames, points);
+		printf("%-44s %10s %12s %12s %12.4f\n", "DepthReprojector (scalar, region)", sizeText, "-", "-", pointDiffering);
+
+		passed &= pointDiffering == 0.0;
+
+		const double outputAngle = normalOutputAngleError(source, frames, points);
+		printf("%-44s %10s %12.5f %12s %12s\n", "LitDepthVisualizer (normals rg16f)", sizeText, outputAngle, "-", "-");
+
+		passed &= outputAngle <= maxOutputAngle;
+
+		const size_t codecDifferingPixels = codecDiffering(frames.depth.data, width, height);
+		printf("%-44s %10s %12s %12s %12.4f\n", "DepthCodec (synthetic)", sizeText, "-", "-", 100.0 * codecDifferingPixels / pixels);
+
+		passed &= codecDifferingPixels == 0;
+
+		// Summing every box the slow way takes a while at the larger sizes
+		if (width <= 640)
+		{
+			for (int radius : { 0, 1, 5 })
+			{
+				const double separableAngle = separableAngleError(width, height, radius);
+
+				char name[64];
+				snprintf(name, sizeof(name), "box_blur_separable (r=%d)", radius);
+				printf("%-44s %10s %12.5f %12s %12s\n", name, sizeText, separableAngle, "-", "-");
+
+				passed &= separableAngle <= maxSeparableAngle;
+			}
+		}
+	}
+
+	passed &= runCodecAccuracy();
+	passed &= runSharedFrameAccuracy();
+
+	if (!passed)
+		printf("FAILED, expected at most %.2f degrees and %d per channel, no differences when fused, in the "
+			"reprojected points, through DepthCodec or shared memory, box sums within %.3f degrees and normal outputs within %.2f degrees\n",
+			maxAngle, maxChannelDifference, maxSeparableAngle, maxOutputAngle);
+
+	return passed;
+}
+
+static bool
+writeJson(const char* path, const std::vector<BenchmarkResult>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\n  \"benchmark\": \"pipeline\",\n  \"hardwareThreads\": %u,\n  \"results\": [\n",
+		std::thread::hardware_concurrency());
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& r = results[i];
+		fprintf(file, "    {\"name\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, \"iterations\": %d, "
+			"\"msPerFrame\": %.6f, \"nsPerPixel\": %.6f, \"gbPerSecond\": %.6f, \"speedup\": %.4f}%s\n",
+			r.name.c_str(), r.width, r.height, r.threads, r.iterations,
+			r.msPerFrame, r.nsPerPixel, r.gbPerSecond, r.speedup,
+			i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n}\n");
+	return fclose(file) == 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+	const char* filter = nullptr;
+	const char* jsonPath = nullptr;
+	double minTime = 0.25;
+	std::vector<int> threadCounts = defaultThreads();
+	bool acquisition = false;
+	bool accuracy = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+			minTime = std::max(0.001, atof(argv[++i]));
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			threadCounts = parseThreads(argv[++i]);
+		else if (!strcmp(argv[i], "--acquisition"))
+			acquisition = true;
+		else if (!strcmp(argv[i], "--accuracy"))
+			accuracy = true;
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter <text>] [--threads 1,2,4] [--min-time <seconds>] [--json <file>]\n"
+				"       %s --acquisition [--min-time <seconds>]\n"
+				"       %s --accuracy\n", argv[0], argv[0], argv[0]);
+			return 2;
+		}
+	}
+
+	if (accuracy)
+		return runAccuracy() ? 0 : 1;
+
+	if (acquisition)
+	{
+		printf("%-44s %10s %10s %10s %10s %10s\n", "acquisition latency (ms)", "frames", "mean", "median", "p99", "max");
+		runAcquisition("callback (astra_update)", false, minTime * 20.0);
+		runAcquisition("poll (astra_reader_open_frame)", true, minTime * 20.0);
+		return 0;
+	}
+
+	if (threadCounts.empty())
+		threadCounts.push_back(1);
+
+	const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+
+	std::vector<BenchmarkResult> results;
+
+	printf("%-44s %10s %7s %10s %10s %10s %8s\n", "case", "size", "threads", "ms/frame", "ns/pixel", "GB/s", "speedup");
+
+	for (const BenchmarkCase& c : createCases())
+	{
+		if (filter && !strstr(c.name, filter))
+			continue;
+
+		for (const auto& size : sizes)
+		{
+			const int width = size[0];
+			const int height = size[1];
+			const double pixels = double(width) * height;
+
+			const int iterations = calibrate(c, width, height, minTime);
+
+			double singleThreadRate = 0.0;
+			for (int threads : threadCounts)
+			{
+				const double seconds = runThreads(c, width, height, threads, iterations);
+				const double pixelsDone = pixels * iterations * threads;
+
+				BenchmarkResult r;
+				r.name = c.name;
+				r.width = width;
+				r.height = height;
+				r.threads = threads;
+				r.iterations = iterations;
+				r.msPerFrame = seconds * 1000.0 / iterations;
+				r.nsPerPixel = seconds * 1e9 / pixelsDone;
+				r.gbPerSecond = c.bytesPerPixel * pixelsDone / seconds / 1e9;
+
+				// Throughput relative to the first thread count run
+				const double rate = pixelsDone / seconds;
+				if (singleThreadRate == 0.0)
+					singleThreadRate = rate / threads;
+				r.speedup = rate / singleThreadRate;
+
+				char sizeText[32];
+				snprintf(sizeText, sizeof(sizeText), "%dx%d", width, height);
+				printf("%-44s %10s %7d %10.4f %10.3f %10.2f %8.2f\n",
+					c.name, sizeText, threads, r.msPerFrame, r.nsPerPixel, r.gbPerSecond, r.speedup);
+
+				results.push_back(r);
+			}
+		}
+	}
+
+	if (jsonPath && !writeJson(jsonPath, results))
+	{
+		fprintf(stderr, "Unable to write %s\n", jsonPath);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,11 @@
+// Stand-in for the macOS OpenGL header the TouchDesigner SDK headers include
+// on non-Windows hosts. The headers only rely on it for the fixed-width
+// integer types and offsetof.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef __cdecl
+#define __cdecl
+#endif
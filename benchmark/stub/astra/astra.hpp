@@ -0,0 +1,398 @@
+// Minimal stand-in for the Orbbec Astra SDK headers.
+//
+// Only the types and calls used by this plugin are declared here, with just
+// enough behaviour for the pipeline to run on machines without the SDK or a
+// device (benchmarks, build machines). Frames handed out by the stub are
+// always invalid; use SyntheticFrameSource or PlaybackFrameSource for data.
+//
+// The stub can also simulate the timing of a device, see astra_stub below.
+#ifndef ASTRA_STUB_ASTRA_HPP
+#define ASTRA_STUB_ASTRA_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ** C API **
+
+typedef int32_t astra_status_t;
+enum
+{
+	ASTRA_STATUS_SUCCESS = 0,
+	ASTRA_STATUS_TIMEOUT = 3,
+};
+
+typedef enum astra_pixel_formats
+{
+	ASTRA_PIXEL_FORMAT_UNKNOWN = 0,
+	ASTRA_PIXEL_FORMAT_DEPTH_MM = 100,
+	ASTRA_PIXEL_FORMAT_RGB888 = 200,
+	ASTRA_PIXEL_FORMAT_YUV422 = 201,
+	ASTRA_PIXEL_FORMAT_YUYV = 202,
+	ASTRA_PIXEL_FORMAT_GRAY8 = 300,
+	ASTRA_PIXEL_FORMAT_GRAY16 = 301,
+	ASTRA_PIXEL_FORMAT_POINT = 400,
+} astra_pixel_formats;
+
+typedef uint32_t astra_pixel_format_t;
+typedef int32_t astra_frame_index_t;
+
+typedef struct _astra_rgb_pixel
+{
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+} astra_rgb_pixel_t;
+
+typedef struct _astra_vector3f
+{
+	float x;
+	float y;
+	float z;
+} astra_vector3f_t;
+
+typedef struct _astra_image_metadata
+{
+	uint32_t width;
+	uint32_t height;
+	astra_pixel_format_t pixelFormat;
+} astra_image_metadata_t;
+
+typedef struct _astra_imagestream_mode
+{
+	char id;
+	uint32_t width;
+	uint32_t height;
+	astra_pixel_format_t pixelFormat;
+	uint8_t fps;
+} astra_imagestream_mode_t;
+
+typedef struct _astra_streamsetconnection* astra_streamsetconnection_t;
+typedef struct _astra_reader* astra_reader_t;
+typedef struct _astra_reader_frame* astra_reader_frame_t;
+typedef struct _astra_streamconnection* astra_streamconnection_t;
+typedef astra_streamconnection_t astra_depthstream_t;
+typedef astra_streamconnection_t astra_colorstream_t;
+typedef astra_streamconnection_t astra_infraredstream_t;
+typedef astra_streamconnection_t astra_pointstream_t;
+typedef struct _astra_imageframe* astra_imageframe_t;
+typedef astra_imageframe_t astra_depthframe_t;
+typedef astra_imageframe_t astra_colorframe_t;
+typedef astra_imageframe_t astra_infraredframe_t;
+typedef astra_imageframe_t astra_pointframe_t;
+
+inline astra_status_t astra_initialize() { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_terminate() { return ASTRA_STATUS_SUCCESS; }
+// Defined with the simulated device at the end
+inline astra_status_t astra_update();
+
+inline astra_status_t astra_streamset_open(const char*, astra_streamsetconnection_t* s) { *s = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_streamset_close(astra_streamsetconnection_t*) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_create(astra_streamsetconnection_t, astra_reader_t* r) { *r = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_destroy(astra_reader_t*) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_open_frame(astra_reader_t, int timeout, astra_reader_frame_t* f);
+inline astra_status_t astra_reader_close_frame(astra_reader_frame_t* f) { *f = nullptr; return ASTRA_STATUS_SUCCESS; }
+
+inline astra_status_t astra_reader_get_depthstream(astra_reader_t, astra_depthstream_t* s) { *s = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_get_colorstream(astra_reader_t, astra_colorstream_t* s) { *s = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_get_infraredstream(astra_reader_t, astra_infraredstream_t* s) { *s = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_reader_get_pointstream(astra_reader_t, astra_pointstream_t* s) { *s = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_stream_start(astra_streamconnection_t) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_stream_stop(astra_streamconnection_t) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_imagestream_set_mode(astra_streamconnection_t, const astra_imagestream_mode_t*) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_depthstream_get_hfov(astra_depthstream_t, float* f) { *f = 1.022f; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_depthstream_get_vfov(astra_depthstream_t, float* f) { *f = 0.796f; return ASTRA_STATUS_SUCCESS; }
+
+inline astra_status_t astra_frame_get_depthframe(astra_reader_frame_t, astra_depthframe_t* f) { *f = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_frame_get_colorframe(astra_reader_frame_t, astra_colorframe_t* f) { *f = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_frame_get_infraredframe(astra_reader_frame_t, astra_infraredframe_t* f) { *f = nullptr; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_frame_get_pointframe(astra_reader_frame_t, astra_pointframe_t* f) { *f = nullptr; return ASTRA_STATUS_SUCCESS; }
+
+inline astra_status_t astra_imageframe_get_metadata(astra_imageframe_t, astra_image_metadata_t* m) { *m = astra_image_metadata_t{ 0, 0, 0 }; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_imageframe_get_frameindex(astra_imageframe_t, astra_frame_index_t* i) { *i = 0; return ASTRA_STATUS_SUCCESS; }
+#define astra_depthframe_get_metadata astra_imageframe_get_metadata
+#define astra_colorframe_get_metadata astra_imageframe_get_metadata
+#define astra_infraredframe_get_metadata astra_imageframe_get_metadata
+#define astra_pointframe_get_metadata astra_imageframe_get_metadata
+#define astra_depthframe_get_frameindex astra_imageframe_get_frameindex
+#define astra_colorframe_get_frameindex astra_imageframe_get_frameindex
+#define astra_infraredframe_get_frameindex astra_imageframe_get_frameindex
+#define astra_pointframe_get_frameindex astra_imageframe_get_frameindex
+
+inline astra_status_t astra_depthframe_get_data_byte_length(astra_depthframe_t, uint32_t* l) { *l = 0; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_depthframe_copy_data(astra_depthframe_t, int16_t*) { return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_depthframe_get_data_ptr(astra_depthframe_t, int16_t** d, uint32_t* l) { *d = nullptr; *l = 0; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_colorframe_get_data_rgb_ptr(astra_colorframe_t, astra_rgb_pixel_t** d, uint32_t* l) { *d = nullptr; *l = 0; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_infraredframe_get_data_ptr(astra_infraredframe_t, uint8_t** d, uint32_t* l) { *d = nullptr; *l = 0; return ASTRA_STATUS_SUCCESS; }
+inline astra_status_t astra_pointframe_get_data_ptr(astra_pointframe_t, astra_vector3f_t** d, uint32_t* l) { *d = nullptr; *l = 0; return ASTRA_STATUS_SUCCESS; }
+
+// ** C++ API **
+
+namespace astra {
+
+	using std::make_unique;
+
+	struct Vector3f : public astra_vector3f_t
+	{
+		Vector3f() { x = y = z = 0.0f; }
+		Vector3f(float x_, float y_, float z_) { x = x_; y = y_; z = z_; }
+
+		static Vector3f zero() { return Vector3f(); }
+
+		float length() const { return std::sqrt(x * x + y * y + z * z); }
+		float dot(const Vector3f& v) const { return x * v.x + y * v.y + z * v.z; }
+		Vector3f cross(const Vector3f& v) const
+		{
+			return Vector3f(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+		}
+
+		static Vector3f normalize(Vector3f v)
+		{
+			double length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+			if (length < 1e-9)
+				return Vector3f(0.0f, 0.0f, 0.0f);
+			return Vector3f(static_cast<float>(v.x / length),
+				static_cast<float>(v.y / length),
+				static_cast<float>(v.z / length));
+		}
+
+		Vector3f& operator+=(const Vector3f& v) { x += v.x; y += v.y; z += v.z; return *this; }
+		Vector3f& operator-=(const Vector3f& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+		friend Vector3f operator+(const Vector3f& a, const Vector3f& b) { return Vector3f(a.x + b.x, a.y + b.y, a.z + b.z); }
+		friend Vector3f operator-(const Vector3f& a, const Vector3f& b) { return Vector3f(a.x - b.x, a.y - b.y, a.z - b.z); }
+		friend Vector3f operator*(const Vector3f& a, float s) { return Vector3f(a.x * s, a.y * s, a.z * s); }
+	};
+
+	struct RgbPixel : public astra_rgb_pixel_t
+	{
+		RgbPixel() { r = g = b = 0; }
+		RgbPixel(uint8_t r_, uint8_t g_, uint8_t b_) { r = r_; g = g_; b = b_; }
+	};
+
+	class ImageStreamMode
+	{
+	public:
+		uint32_t width() const { return width_; }
+		uint32_t height() const { return height_; }
+		uint8_t fps() const { return fps_; }
+		astra_pixel_format_t pixel_format() const { return format_; }
+
+		void set_width(uint32_t w) { width_ = w; }
+		void set_height(uint32_t h) { height_ = h; }
+		void set_fps(uint8_t f) { fps_ = f; }
+		void set_pixel_format(astra_pixel_format_t f) { format_ = f; }
+
+	private:
+		uint32_t width_{ 0 };
+		uint32_t height_{ 0 };
+		uint8_t fps_{ 0 };
+		astra_pixel_format_t format_{ 0 };
+	};
+
+	class DataStream
+	{
+	public:
+		void start() {}
+		void stop() {}
+	};
+
+	class ImageStream : public DataStream
+	{
+	public:
+		ImageStreamMode mode() const { return mode_; }
+		void set_mode(const ImageStreamMode& mode) { mode_ = mode; }
+
+	private:
+		ImageStreamMode mode_;
+	};
+
+	class DepthStream : public ImageStream
+	{
+	public:
+		float hFov() const { return 1.022f; }
+		float vFov() const { return 0.796f; }
+	};
+
+	class ColorStream : public ImageStream {};
+	class InfraredStream : public ImageStream {};
+	class PointStream : public ImageStream {};
+
+	template<typename TDataType>
+	class ImageFrame
+	{
+	public:
+		bool is_valid() const { return false; }
+		int width() const { return 0; }
+		int height() const { return 0; }
+		astra_frame_index_t frame_index() const { return 0; }
+		size_t byte_length() const { return 0; }
+		size_t length() const { return 0; }
+		const TDataType* data() const { return nullptr; }
+	};
+
+	using DepthFrame = ImageFrame<int16_t>;
+	using ColorFrame = ImageFrame<RgbPixel>;
+	using InfraredFrame16 = ImageFrame<uint16_t>;
+	using InfraredFrameRgb = ImageFrame<RgbPixel>;
+	using PointFrame = ImageFrame<Vector3f>;
+
+	class Frame
+	{
+	public:
+		template<typename T>
+		T get() const { return T(); }
+	};
+
+	class StreamReader;
+
+	class FrameListener
+	{
+	public:
+		virtual ~FrameListener() = default;
+		virtual void on_frame_ready(StreamReader& reader, Frame& frame) = 0;
+	};
+
+	class StreamReader
+	{
+	public:
+		template<typename T>
+		T stream() { return T(); }
+
+		void add_listener(FrameListener& listener);
+		void remove_listener(FrameListener& listener);
+	};
+
+	class StreamSet
+	{
+	public:
+		StreamSet() {}
+		explicit StreamSet(const char*) {}
+
+		StreamReader create_reader() { return StreamReader(); }
+	};
+}
+
+// ** Simulated device **
+//
+// Once a frame rate is set the stub's device "captures" a frame every 1/fps seconds.
+// astra_update() hands the newest one to the readers' listeners, and astra_reader_open_frame()
+// waits for it up to its timeout. The frames still carry no data; this is only for timing how
+// quickly each way of acquiring frames picks them up. The frame rate starts at 0, when no
+// frames are ever captured.
+namespace astra_stub
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Device
+	{
+		double fps{ 0.0 };
+		Clock::time_point start;
+
+		int64_t lastDispatched{ 0 };
+		int64_t lastOpened{ 0 };
+
+		// When the frame most recently handed out was captured
+		Clock::time_point lastCaptureTime;
+
+		std::vector<std::pair<astra::StreamReader*, astra::FrameListener*>> listeners;
+	};
+
+	inline Device& device()
+	{
+		static Device d;
+		return d;
+	}
+
+	inline void setFrameRate(double fps)
+	{
+		Device& d = device();
+		d.fps = fps;
+		d.start = Clock::now();
+		d.lastDispatched = 0;
+		d.lastOpened = 0;
+	}
+
+	inline int64_t capturedFrame(Clock::time_point time)
+	{
+		const Device& d = device();
+		return int64_t(std::chrono::duration<double>(time - d.start).count() * d.fps);
+	}
+
+	inline Clock::time_point captureTime(int64_t frame)
+	{
+		const Device& d = device();
+		return d.start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frame / d.fps));
+	}
+
+	inline Clock::time_point lastCaptureTime()
+	{
+		return device().lastCaptureTime;
+	}
+}
+
+inline void astra::StreamReader::add_listener(FrameListener& listener)
+{
+	astra_stub::device().listeners.push_back(std::make_pair(this, &listener));
+}
+
+inline void astra::StreamReader::remove_listener(FrameListener& listener)
+{
+	auto& listeners = astra_stub::device().listeners;
+	listeners.erase(std::remove(listeners.begin(), listeners.end(), std::make_pair(this, &listener)), listeners.end());
+}
+
+inline astra_status_t astra_update()
+{
+	astra_stub::Device& d = astra_stub::device();
+	if (d.fps <= 0.0)
+		return ASTRA_STATUS_SUCCESS;
+
+	const int64_t frame = astra_stub::capturedFrame(astra_stub::Clock::now());
+	if (frame <= d.lastDispatched)
+		return ASTRA_STATUS_SUCCESS;
+
+	d.lastDispatched = frame;
+	d.lastCaptureTime = astra_stub::captureTime(frame);
+
+	const auto listeners = d.listeners;
+	for (const auto& listener : listeners){
+		astra::Frame f;
+		listener.second->on_frame_ready(*listener.first, f);
+	}
+
+	return ASTRA_STATUS_SUCCESS;
+}
+
+inline astra_status_t astra_reader_open_frame(astra_reader_t, int timeout, astra_reader_frame_t* f)
+{
+	astra_stub::Device& d = astra_stub::device();
+	if (d.fps <= 0.0)
+		return ASTRA_STATUS_TIMEOUT;
+
+	const auto now = astra_stub::Clock::now();
+	const int64_t frame = std::max(d.lastOpened + 1, astra_stub::capturedFrame(now));
+	const auto ready = astra_stub::captureTime(frame);
+	const auto deadline = now + std::chrono::milliseconds(timeout);
+
+	if (ready > deadline){
+		std::this_thread::sleep_until(deadline);
+		return ASTRA_STATUS_TIMEOUT;
+	}
+
+	std::this_thread::sleep_until(ready);
+
+	d.lastOpened = frame;
+	d.lastCaptureTime = ready;
+
+	static int openFrame;
+	*f = (astra_reader_frame_t)&openFrame;
+	return ASTRA_STATUS_SUCCESS;
+}
+
+#endif // ASTRA_STUB_ASTRA_HPP
@@ -0,0 +1,21 @@
+// Force-included when building on Linux (-include benchmark/stub/compat.h).
+// The non-Windows code paths follow the TouchDesigner samples and use the BSD
+// strlcpy, which glibc only gained in 2.38.
+#pragma once
+
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+static inline size_t
+strlcpy(char* dst, const char* src, size_t size)
+{
+	const size_t length = strlen(src);
+	if (size != 0)
+	{
+		const size_t n = length < size - 1 ? length : size - 1;
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return length;
+}
+#endif
@@ -0,0 +1,115 @@
+#ifndef SHAREDFRAMEFORMAT_H
+#define SHAREDFRAMEFORMAT_H
+
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared memory written by the plugin's SharedFrameExporter and read by
+// SharedFrameReader, for other processes on the same machine to use the camera's frames.
+//
+// An export called <name> is made of two named shared memory objects (shm_open names with a
+// leading '/' on macOS and Linux, file mapping names on Windows):
+//
+//   <name>                 a SharedFrameDirectory, which says which ring is current
+//   <name>_<generation>    the ring: a SharedFrameRingHeader, then numSlots slots of slotSize
+//                          bytes. Each slot is a SharedFrameSlot followed by its images.
+//
+// The ring is replaced by one with a new generation when the frames grow too big for its
+// slots, and readers move over to it when they see the directory's generation change.
+//
+// Frame 'sequence' (counting from 1) is written to slot (sequence - 1) % numSlots. Each slot
+// is guarded by a sequence lock: its 'lock' is odd while the exporter is writing the slot and
+// goes up by two for every frame written to it. Readers use the images in place, then check
+// 'lock' hasn't changed; if it has the frame was overwritten under them and must be thrown
+// away. The exporter never waits for readers, a reader that's slower than numSlots - 1 frames
+// simply misses frames.
+//
+// Values are stored in the exporter's byte order, the images are tightly packed rows.
+
+const char SharedFrameDirectoryMagic[8] = { 'A', 'S', 'T', 'R', 'S', 'H', 'M', 'D' };
+const char SharedFrameRingMagic[8] = { 'A', 'S', 'T', 'R', 'S', 'H', 'M', 'R' };
+const uint32_t SharedFrameVersion = 1;
+
+const uint32_t SharedFrameAlignment = 64;
+const int SharedFrameMaxStreams = 4;
+
+// The same values as FrameSource::StreamFlags
+enum SharedFrameStream
+{
+	SHARED_FRAME_DEPTH		= 1 << 0,		// int16_t millimetres, 0 where there's no reading
+	SHARED_FRAME_COLOR		= 1 << 1,		// RGB, 8 bits per channel
+	SHARED_FRAME_IR_16		= 1 << 2,		// uint16_t
+	SHARED_FRAME_IR_RGB		= 1 << 3,		// RGB, 8 bits per channel
+};
+
+struct SharedFrameDirectory
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved0;
+
+	// Written before 'generation'
+	uint64_t ringSize;				// Bytes in the current ring
+	// Of the current ring, 0 when nothing is being exported
+	std::atomic<uint32_t> generation;
+	uint32_t reserved1;
+
+	uint8_t reserved[32];
+};
+
+struct SharedFrameRingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;			// The first slot starts here
+
+	uint32_t numSlots;
+	uint32_t reserved0;
+	uint64_t slotSize;
+
+	// Sequence of the newest complete frame, 0 before the first
+	std::atomic<uint64_t> latestSequence;
+	// Set when the exporter stops or moves to a new ring
+	std::atomic<uint32_t> closed;
+	uint32_t reserved1;
+
+	uint8_t reserved[16];
+};
+
+struct SharedFrameImage
+{
+	uint32_t stream;				// SharedFrameStream
+	uint32_t pixelFormat;			// astra_pixel_format_t
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerPixel;
+	uint32_t reserved0;
+	uint64_t offset;				// From the start of the slot
+};
+
+struct SharedFrameSlot
+{
+	std::atomic<uint64_t> lock;
+
+	uint64_t sequence;
+	uint64_t timestamp;				// Microseconds on the device clock, 0 when unknown
+	uint64_t arrivalTime;			// Microseconds on the exporting host's steady clock
+
+	uint32_t streams;				// SharedFrameStream of the images
+	uint32_t numImages;
+	uint8_t reserved0[24];
+
+	SharedFrameImage images[SharedFrameMaxStreams];
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8 && sizeof(std::atomic<uint32_t>) == 4, "Atomics must have the size of their value");
+static_assert(sizeof(SharedFrameDirectory) == 64, "SharedFrameDirectory layout");
+static_assert(sizeof(SharedFrameRingHeader) == 64, "SharedFrameRingHeader layout");
+static_assert(sizeof(SharedFrameSlot) % SharedFrameAlignment == 0, "SharedFrameSlot must keep images aligned");
+
+inline uint64_t sharedFrameAlign(uint64_t size)
+{
+	return (size + SharedFrameAlignment - 1) & ~uint64_t(SharedFrameAlignment - 1);
+}
+
+#endif // SHAREDFRAMEFORMAT_H
@@ -0,0 +1,144 @@
+#include "SharedFrameReader.h"
+
+#include <string.h>
+
+// Retries when the exporter was part way through writing the slot
+static const int MaxReadAttempts = 4;
+
+const SharedFrameReader::Image* SharedFrameReader::Frame::find(uint32_t stream) const
+{
+	for (int i = 0; i < numImages; i++){
+		if (images[i].stream == stream)
+			return &images[i];
+	}
+	return nullptr;
+}
+
+bool SharedFrameReader::Frame::isValid() const
+{
+	if (!slot)
+		return false;
+
+	// Orders the reads of the images before the check
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot->lock.load(std::memory_order_relaxed) == lock;
+}
+
+SharedFrameReader::SharedFrameReader()
+{
+}
+
+bool SharedFrameReader::open(const std::string& n)
+{
+	close();
+
+	if (!directory.open(n, sizeof(SharedFrameDirectory)))
+		return false;
+
+	const SharedFrameDirectory* header = (const SharedFrameDirectory*)directory.data();
+	if (memcmp(header->magic, SharedFrameDirectoryMagic, sizeof(header->magic)) != 0 ||
+		header->version != SharedFrameVersion){
+		close();
+		return false;
+	}
+
+	name = n;
+	return true;
+}
+
+void SharedFrameReader::close()
+{
+	ring.close();
+	directory.close();
+	ringGeneration = 0;
+	name.clear();
+}
+
+bool SharedFrameReader::openRing()
+{
+	const SharedFrameDirectory* header = (const SharedFrameDirectory*)directory.data();
+
+	const uint32_t generation = header->generation.load(std::memory_order_acquire);
+	const uint64_t ringSize = header->ringSize;
+
+	// The ring was changed while reading its size
+	if (generation != header->generation.load(std::memory_order_acquire))
+		return false;
+
+	if (generation == ringGeneration && ring.isOpen())
+		return true;
+
+	ring.close();
+	ringGeneration = 0;
+
+	if (generation == 0 || !ring.open(name + "_" + std::to_string(generation), ringSize))
+		return false;
+
+	const SharedFrameRingHeader* ringHeader = (const SharedFrameRingHeader*)ring.data();
+	if (memcmp(ringHeader->magic, SharedFrameRingMagic, sizeof(ringHeader->magic)) != 0 ||
+		ringHeader->version != SharedFrameVersion || ringHeader->numSlots == 0 ||
+		ringHeader->headerSize + ringHeader->numSlots * ringHeader->slotSize > ringSize){
+		ring.close();
+		return false;
+	}
+
+	ringGeneration = generation;
+	return true;
+}
+
+bool SharedFrameReader::latest(Frame& frame, uint64_t after)
+{
+	if (!directory.isOpen() || !openRing())
+		return false;
+
+	const SharedFrameRingHeader* header = (const SharedFrameRingHeader*)ring.data();
+	if (header->closed.load(std::memory_order_acquire))
+		return false;
+
+	for (int attempt = 0; attempt < MaxReadAttempts; attempt++){
+		const uint64_t sequence = header->latestSequence.load(std::memory_order_acquire);
+		if (sequence == 0 || sequence <= after)
+			return false;
+
+		const uint64_t slotOffset = header->headerSize + ((sequence - 1) % header->numSlots) * header->slotSize;
+		const SharedFrameSlot* slot = (const SharedFrameSlot*)(ring.data() + slotOffset);
+
+		const uint64_t lock = slot->lock.load(std::memory_order_acquire);
+		if (lock & 1)
+			continue;
+
+		frame.sequence = slot->sequence;
+		frame.timestamp = slot->timestamp;
+		frame.arrivalTime = slot->arrivalTime;
+		frame.streams = slot->streams;
+		frame.numImages = 0;
+
+		const uint32_t numImages = slot->numImages;
+		for (uint32_t i = 0; i < numImages && i < uint32_t(SharedFrameMaxStreams); i++){
+			const SharedFrameImage& source = slot->images[i];
+
+			// Don't let a torn read point outside the slot
+			const uint64_t size = uint64_t(source.width) * source.height * source.bytesPerPixel;
+			if (source.offset > header->slotSize || size > header->slotSize - source.offset)
+				break;
+
+			Image& image = frame.images[frame.numImages++];
+			image.data = (const uint8_t*)slot + source.offset;
+			image.stream = source.stream;
+			image.pixelFormat = source.pixelFormat;
+			image.width = source.width;
+			image.height = source.height;
+			image.bytesPerPixel = source.bytesPerPixel;
+		}
+
+		frame.slot = slot;
+		frame.lock = lock;
+
+		// The slot moved on to a newer frame while it was being read
+		if (frame.sequence == sequence && frame.isValid())
+			return true;
+	}
+
+	frame.slot = nullptr;
+	return false;
+}
@@ -0,0 +1,88 @@
+#ifndef SHAREDFRAMEREADER_H
+#define SHAREDFRAMEREADER_H
+
+#include "SharedFrameFormat.h"
+#include "SharedMemory.h"
+
+#include <cstdint>
+#include <string>
+
+// Reads the frames the TouchDesigner plugin exports to shared memory, see SharedFrameFormat.h.
+// Build it into another program along with SharedMemory.cpp, nothing else is needed.
+//
+//   SharedFrameReader reader;
+//   SharedFrameReader::Frame frame;
+//
+//   if (reader.open("astra0") && reader.latest(frame)){
+//       const SharedFrameReader::Image* depth = frame.find(SHARED_FRAME_DEPTH);
+//       ... use depth->data in place ...
+//       if (!frame.isValid())
+//           ... the exporter overwrote the frame in the meantime, discard the results ...
+//   }
+//
+// The images are read straight out of the exporter's memory, which is mapped read-only. A
+// reader only ever looks at the exporter's memory, so it can be as slow as it likes without
+// holding the camera up.
+class SharedFrameReader
+{
+public:
+	struct Image
+	{
+		const uint8_t* data{ nullptr };
+		uint32_t stream{ 0 };			// SharedFrameStream
+		uint32_t pixelFormat{ 0 };		// astra_pixel_format_t
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t bytesPerPixel{ 0 };
+	};
+
+	class Frame
+	{
+	public:
+		uint64_t sequence{ 0 };
+		uint64_t timestamp{ 0 };
+		uint64_t arrivalTime{ 0 };
+
+		uint32_t streams{ 0 };
+		int numImages{ 0 };
+		Image images[SharedFrameMaxStreams];
+
+		// nullptr if the frame doesn't have that stream
+		const Image* find(uint32_t stream) const;
+
+		// False once the exporter has started to overwrite the frame. Check it after
+		// reading the images, they can't be trusted if it's false.
+		bool isValid() const;
+
+	private:
+		friend class SharedFrameReader;
+
+		const SharedFrameSlot* slot{ nullptr };
+		uint64_t lock{ 0 };
+	};
+
+	SharedFrameReader();
+
+	// Returns false if nothing is being exported under 'name' yet
+	bool open(const std::string& name);
+	void close();
+
+	bool isOpen() const { return directory.isOpen(); }
+
+	// Gets the newest frame if it's newer than sequence 'after'. Returns false if there isn't
+	// one, for example because the exporter stopped. Follows the exporter to a new ring by
+	// itself; after the exporter stops, open() has to be called again. Frames read from the
+	// ring it left behind can't be used any more, that ring is unmapped.
+	bool latest(Frame& frame, uint64_t after = 0);
+
+private:
+	bool openRing();
+
+	std::string name;
+
+	SharedMemory directory;
+	SharedMemory ring;
+	uint32_t ringGeneration{ 0 };
+};
+
+#endif // SHAREDFRAMEREADER_H
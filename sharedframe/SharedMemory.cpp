@@ -0,0 +1,163 @@
+#include "SharedMemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else // macOS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SharedMemory::SharedMemory()
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+static std::wstring wideName(const std::string& name)
+{
+	const int wideLength = MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, nullptr, 0);
+	if (wideLength <= 0)
+		return std::wstring();
+
+	std::wstring wide(wideLength, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, &wide[0], wideLength);
+	return wide;
+}
+
+bool SharedMemory::create(const std::string& name, uint64_t size, bool exclusive)
+{
+	close();
+
+	mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+								 DWORD(size >> 32), DWORD(size), wideName(name).c_str());
+	if (!mapping)
+		return false;
+
+	// An existing mapping keeps the size it was made with
+	if (GetLastError() == ERROR_ALREADY_EXISTS && exclusive){
+		close();
+		return false;
+	}
+
+	base = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+
+	MEMORY_BASIC_INFORMATION info;
+	if (!base || VirtualQuery(base, &info, sizeof(info)) == 0 || info.RegionSize < size){
+		close();
+		return false;
+	}
+
+	length = size;
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name, uint64_t size)
+{
+	close();
+
+	mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wideName(name).c_str());
+	if (!mapping)
+		return false;
+
+	base = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	MEMORY_BASIC_INFORMATION info;
+	if (!base || VirtualQuery(base, &info, sizeof(info)) == 0 || info.RegionSize < size){
+		close();
+		return false;
+	}
+
+	length = size;
+	return true;
+}
+
+void SharedMemory::close()
+{
+	// The mapping goes away with the last process that has it open
+	if (base)
+		UnmapViewOfFile(base);
+	if (mapping)
+		CloseHandle(mapping);
+
+	base = nullptr;
+	mapping = nullptr;
+	length = 0;
+}
+
+#else // macOS
+
+bool SharedMemory::create(const std::string& name, uint64_t size, bool exclusive)
+{
+	close();
+
+	const std::string path = "/" + name;
+
+	const int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | (exclusive ? O_EXCL : 0), 0644);
+	if (fd < 0)
+		return false;
+
+	// Only grows an existing block, macOS can't resize one at all once it has a size
+	struct stat info;
+	bool sized = fstat(fd, &info) == 0 && (uint64_t(info.st_size) >= size || ftruncate(fd, off_t(size)) == 0);
+
+	void* address = sized ? mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+
+	if (address == MAP_FAILED){
+		if (exclusive)
+			shm_unlink(path.c_str());
+		return false;
+	}
+
+	createdName = path;
+	base = (uint8_t*)address;
+	length = size;
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name, uint64_t size)
+{
+	close();
+
+	const std::string path = "/" + name;
+
+	const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	void* address = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && uint64_t(info.st_size) >= size)
+		address = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (address == MAP_FAILED)
+		return false;
+
+	base = (uint8_t*)address;
+	length = size;
+	return true;
+}
+
+void SharedMemory::close()
+{
+	if (base)
+		munmap(base, size_t(length));
+
+	// Processes that still have it mapped keep their memory, only the name goes
+	if (!createdName.empty())
+		shm_unlink(createdName.c_str());
+
+	base = nullptr;
+	createdName.clear();
+	length = 0;
+}
+
+#endif
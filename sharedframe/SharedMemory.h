@@ -0,0 +1,42 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <cstdint>
+#include <string>
+
+// A named block of memory shared between processes: shm_open on macOS and Linux, a file
+// mapping backed by the page file on Windows.
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	// Creates the block for writing. If 'exclusive' is set it fails when the name is already
+	// taken, otherwise an existing block of at least 'size' bytes is reused. The name is
+	// removed again by close().
+	bool create(const std::string& name, uint64_t size, bool exclusive);
+	// Maps an existing block of at least 'size' bytes read-only
+	bool open(const std::string& name, uint64_t size);
+	void close();
+
+	bool isOpen() const { return base != nullptr; }
+
+	uint8_t* data() const { return base; }
+	uint64_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+	void* mapping{ nullptr };
+#else
+	std::string createdName;
+#endif
+
+	uint8_t* base{ nullptr };
+	uint64_t length{ 0 };
+};
+
+#endif // SHAREDMEMORY_H
@@ -0,0 +1,212 @@
+"""Reads the frames the TouchDesigner plugin exports to shared memory.
+
+The Python counterpart of SharedFrameReader.h, see SharedFrameFormat.h for the layout.
+Needs Python 3.8 or later, numpy is optional:
+
+    with SharedFrameReader("astra0") as reader:
+        frame = reader.latest()
+        if frame:
+            depth = frame.images.get(SHARED_FRAME_DEPTH)
+            pixels = numpy.frombuffer(depth.data, numpy.int16).reshape(depth.height, depth.width)
+            ... use pixels ...
+            if not frame.is_valid():
+                ... the exporter overwrote the frame in the meantime, discard the results ...
+            del pixels
+
+Image data is a read-only memoryview straight into the exporter's memory, nothing is copied.
+close() releases the views of every frame the reader handed out, but not the arrays made
+from them, so those have to be dropped first. Memory an array still points into can't be
+unmapped, and Python complains about it when the process exits.
+"""
+
+import struct
+import weakref
+from multiprocessing import shared_memory
+
+SHARED_FRAME_DEPTH = 1 << 0
+SHARED_FRAME_COLOR = 1 << 1
+SHARED_FRAME_IR_16 = 1 << 2
+SHARED_FRAME_IR_RGB = 1 << 3
+
+_DIRECTORY_MAGIC = b"ASTRSHMD"
+_RING_MAGIC = b"ASTRSHMR"
+_VERSION = 1
+
+_DIRECTORY = struct.Struct("=8sIIQI")       # magic, version, reserved0, ringSize, generation
+_RING = struct.Struct("=8sIIIIQQI")         # magic, version, headerSize, numSlots, reserved0, slotSize, latestSequence, closed
+_SLOT = struct.Struct("=QQQQII")            # lock, sequence, timestamp, arrivalTime, streams, numImages
+_IMAGE = struct.Struct("=IIIIIIQ")          # stream, pixelFormat, width, height, bytesPerPixel, reserved0, offset
+
+_SLOT_IMAGES = 64
+_MAX_STREAMS = 4
+_MAX_READ_ATTEMPTS = 4
+
+
+def _attach(name):
+    memory = shared_memory.SharedMemory(name=name)
+    try:
+        # Attaching registers the memory with the resource tracker on POSIX, which would
+        # remove it from under the exporter when this process exits
+        from multiprocessing import resource_tracker
+        resource_tracker.unregister(memory._name, "shared_memory")
+    except Exception:
+        pass
+    return memory
+
+
+class Image:
+    def __init__(self, data, stream, pixel_format, width, height, bytes_per_pixel):
+        self.data = data
+        self.stream = stream
+        self.pixel_format = pixel_format
+        self.width = width
+        self.height = height
+        self.bytes_per_pixel = bytes_per_pixel
+
+
+class Frame:
+    def __init__(self, view, slot_offset, lock, sequence, timestamp, arrival_time, streams, images):
+        self._view = view
+        self._slot_offset = slot_offset
+        self._lock = lock
+        self.sequence = sequence
+        self.timestamp = timestamp
+        self.arrival_time = arrival_time
+        self.streams = streams
+        # SHARED_FRAME_* to Image
+        self.images = images
+
+    def is_valid(self):
+        """False once the exporter has started to overwrite the frame, or it was released."""
+        if self._view is None:
+            return False
+        return struct.unpack_from("=Q", self._view, self._slot_offset)[0] == self._lock
+
+    def release(self):
+        """Lets go of the image data, raises BufferError if an array made from it is still around."""
+        for image in self.images.values():
+            image.data.release()
+        self._view = None
+
+
+class SharedFrameReader:
+    def __init__(self, name):
+        """Raises FileNotFoundError if nothing is being exported under 'name' yet."""
+        self._name = name
+        self._directory = None
+        self._ring = None
+        self._ring_view = None
+        self._generation = 0
+        # Rings that frames still held by the caller point into
+        self._retired = []
+        # Every frame handed out that's still around, for close() to release
+        self._frames = weakref.WeakSet()
+
+        self._directory = _attach(name)
+
+        magic, version = _DIRECTORY.unpack_from(self._directory.buf)[:2]
+        if magic != _DIRECTORY_MAGIC or version != _VERSION:
+            self.close()
+            raise ValueError("%s isn't a shared frame export" % name)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exception):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        for frame in list(self._frames):
+            try:
+                frame.release()
+            except BufferError:
+                pass
+        self._frames = weakref.WeakSet()
+
+        self._close_ring()
+        if self._directory:
+            self._directory.close()
+            self._directory = None
+
+    def _close_ring(self):
+        if self._ring:
+            self._retired.append((self._ring, self._ring_view))
+
+        retired = []
+        for ring, view in self._retired:
+            if any(frame._view is view for frame in self._frames):
+                retired.append((ring, view))
+                continue
+            try:
+                view.release()
+                ring.close()
+            except BufferError:
+                retired.append((ring, view))
+        self._retired = retired
+
+        self._ring = None
+        self._ring_view = None
+        self._generation = 0
+
+    def _open_ring(self):
+        ring_size, generation = _DIRECTORY.unpack_from(self._directory.buf)[3:]
+        if generation == self._generation and self._ring:
+            return True
+
+        self._close_ring()
+        if generation == 0:
+            return False
+
+        try:
+            self._ring = _attach("%s_%d" % (self._name, generation))
+        except FileNotFoundError:
+            return False
+
+        self._ring_view = self._ring.buf.toreadonly()
+        magic, version = _RING.unpack_from(self._ring_view)[:2]
+        if magic != _RING_MAGIC or version != _VERSION or len(self._ring_view) < ring_size:
+            self._close_ring()
+            return False
+
+        self._generation = generation
+        return True
+
+    def latest(self, after=0):
+        """The newest frame if it's newer than sequence 'after', otherwise None."""
+        if not self._directory or not self._open_ring():
+            return None
+
+        view = self._ring_view
+        _, _, header_size, num_slots, _, slot_size, _, closed = _RING.unpack_from(view)
+        if closed or num_slots == 0:
+            return None
+
+        for _ in range(_MAX_READ_ATTEMPTS):
+            sequence = _RING.unpack_from(view)[6]
+            if sequence == 0 or sequence <= after:
+                return None
+
+            slot_offset = header_size + ((sequence - 1) % num_slots) * slot_size
+            lock, slot_sequence, timestamp, arrival_time, streams, num_images = _SLOT.unpack_from(view, slot_offset)
+            if lock & 1:
+                continue
+
+            images = {}
+            for i in range(min(num_images, _MAX_STREAMS)):
+                stream, pixel_format, width, height, bpp, _, offset = _IMAGE.unpack_from(
+                    view, slot_offset + _SLOT_IMAGES + i * _IMAGE.size)
+                size = width * height * bpp
+                if offset > slot_size or size > slot_size - offset:
+                    break
+                start = slot_offset + offset
+                images[stream] = Image(view[start:start + size], stream, pixel_format, width, height, bpp)
+
+            frame = Frame(view, slot_offset, lock, slot_sequence, timestamp, arrival_time, streams, images)
+            if slot_sequence == sequence and frame.is_valid():
+                self._frames.add(frame)
+                return frame
+
+        return None